@@ -0,0 +1,787 @@
+#include "devices/ahci.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/disk.h"
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* The code in this file is a driver for an AHCI (Serial ATA)
+   host bus adapter, such as the ICH9 controller that QEMU
+   emulates with "-device ahci".  It attempts to comply to
+   [AHCI-1.3].
+
+   Unlike the IDE driver in disk.c, which has a single command in
+   flight per channel and moves every byte through the data port,
+   the HBA fetches commands from a 32-entry command list in memory
+   and moves the data by DMA.  When the drive supports native
+   command queuing (NCQ), reads and writes are issued as READ/WRITE
+   FPDMA QUEUED, so that up to 32 of them may be outstanding on a
+   port at once and the drive is free to reorder them.  Otherwise
+   we fall back to READ/WRITE DMA EXT, one command at a time. */
+
+/* PCI configuration mechanism #1 ports. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* PCI configuration space registers. */
+#define PCI_ID 0x00             /* Vendor and device ID. */
+#define PCI_COMMAND 0x04        /* Command (low 16 bits). */
+#define PCI_CLASS 0x08          /* Class, subclass, prog-if, revision. */
+#define PCI_HEADER 0x0c         /* Header type in bits 16:23. */
+#define PCI_ABAR 0x24           /* BAR5: AHCI base address. */
+#define PCI_INTR 0x3c           /* Interrupt line in bits 0:7. */
+
+/* PCI command register bits. */
+#define PCI_CMD_MEM 0x0002      /* Memory space enable. */
+#define PCI_CMD_MASTER 0x0004   /* Bus master enable. */
+#define PCI_CMD_INTX_OFF 0x0400 /* INTx disable. */
+
+/* Mass storage, SATA, AHCI 1.0. */
+#define PCI_CLASS_AHCI 0x010601
+
+/* Generic host control registers, as offsets from ABAR. */
+#define HBA_CAP 0x00            /* Host capabilities. */
+#define HBA_GHC 0x04            /* Global host control. */
+#define HBA_IS 0x08             /* Interrupt status, one bit per port. */
+#define HBA_PI 0x0c             /* Ports implemented. */
+#define HBA_PORT(N) (0x100 + (N) * 0x80)
+#define HBA_SIZE HBA_PORT (32)
+
+#define CAP_SNCQ 0x40000000     /* Supports native command queuing. */
+#define CAP_NCS(CAP) ((((CAP) >> 8) & 0x1f) + 1)  /* Command slots. */
+
+#define GHC_IE 0x00000002       /* Interrupt enable. */
+#define GHC_AE 0x80000000       /* AHCI enable. */
+
+/* Port registers, as offsets from the port's register block. */
+#define PX_CLB 0x00             /* Command list base, low. */
+#define PX_CLBU 0x04            /* Command list base, high. */
+#define PX_FB 0x08              /* Received FIS base, low. */
+#define PX_FBU 0x0c             /* Received FIS base, high. */
+#define PX_IS 0x10              /* Interrupt status. */
+#define PX_IE 0x14              /* Interrupt enable. */
+#define PX_CMD 0x18             /* Command and status. */
+#define PX_TFD 0x20             /* Task file data. */
+#define PX_SIG 0x24             /* Signature. */
+#define PX_SSTS 0x28            /* SATA status. */
+#define PX_SERR 0x30            /* SATA error. */
+#define PX_SACT 0x34            /* SATA active (NCQ tags). */
+#define PX_CI 0x38              /* Command issue. */
+
+/* PxCMD bits. */
+#define CMD_ST 0x0001           /* Start processing the command list. */
+#define CMD_FRE 0x0010          /* FIS receive enable. */
+#define CMD_FR 0x4000           /* FIS receive running. */
+#define CMD_CR 0x8000           /* Command list running. */
+
+/* PxIS and PxIE bits. */
+#define IS_DHRS 0x00000001      /* Device to host register FIS. */
+#define IS_PSS 0x00000002       /* PIO setup FIS. */
+#define IS_DSS 0x00000004       /* DMA setup FIS. */
+#define IS_SDBS 0x00000008      /* Set device bits FIS (NCQ done). */
+#define IS_IFS 0x08000000       /* Interface fatal error. */
+#define IS_HBDS 0x10000000      /* Host bus data error. */
+#define IS_HBFS 0x20000000      /* Host bus fatal error. */
+#define IS_TFES 0x40000000      /* Task file error. */
+#define IS_ERRORS (IS_IFS | IS_HBDS | IS_HBFS | IS_TFES)
+
+/* PxTFD status bits. */
+#define TFD_ERR 0x01            /* Error. */
+#define TFD_DRQ 0x08            /* Data request. */
+#define TFD_BSY 0x80            /* Busy. */
+
+#define SSTS_DET_PRESENT 3      /* Device present, PHY up. */
+#define SIG_ATA 0x00000101      /* Signature of an ATA disk. */
+
+/* ATA commands. */
+#define ATA_IDENTIFY_DEVICE 0xec
+#define ATA_READ_DMA_EXT 0x25
+#define ATA_WRITE_DMA_EXT 0x35
+#define ATA_READ_FPDMA_QUEUED 0x60
+#define ATA_WRITE_FPDMA_QUEUED 0x61
+
+/* Register - host to device FIS, [AHCI-1.3] 10.3.4. */
+#define FIS_TYPE_REG_H2D 0x27
+#define FIS_C 0x80              /* This FIS carries a command. */
+#define FIS_DEV_LBA 0x40        /* LBA addressing. */
+
+struct fis_reg_h2d {
+	uint8_t type;               /* FIS_TYPE_REG_H2D. */
+	uint8_t flags;              /* FIS_C. */
+	uint8_t command;            /* ATA command. */
+	uint8_t featurel;           /* Features 7:0. */
+	uint8_t lba0, lba1, lba2;   /* LBA 23:0. */
+	uint8_t device;             /* Device. */
+	uint8_t lba3, lba4, lba5;   /* LBA 47:24. */
+	uint8_t featureh;           /* Features 15:8. */
+	uint8_t countl, counth;     /* Count 15:0. */
+	uint8_t icc;                /* Isochronous command completion. */
+	uint8_t control;            /* Control. */
+	uint32_t reserved;
+} __attribute__ ((packed));
+
+/* Command header, one entry of the command list, [AHCI-1.3] 4.2.2. */
+struct cmd_header {
+	uint16_t flags;             /* FIS length in dwords, CH_*. */
+	uint16_t prdtl;             /* Number of PRDT entries. */
+	volatile uint32_t prdbc;    /* Bytes transferred, set by the HBA. */
+	uint64_t ctba;              /* Physical address of command table. */
+	uint32_t reserved[4];
+} __attribute__ ((packed));
+
+#define CH_WRITE 0x0040         /* Data moves from memory to device. */
+
+/* Physical region descriptor. */
+struct prd {
+	uint64_t dba;               /* Physical address of data. */
+	uint32_t reserved;
+	uint32_t dbc;               /* Byte count minus 1, at most 4 MB. */
+} __attribute__ ((packed));
+
+#define PRD_MAX 0x400000        /* Bytes one descriptor may cover. */
+#define PRD_CNT 8               /* Descriptors per command table. */
+
+/* Command table, [AHCI-1.3] 4.2.3.  Must be 128-byte aligned;
+   with PRD_CNT descriptors it is exactly 256 bytes. */
+struct cmd_table {
+	uint8_t cfis[64];           /* Command FIS. */
+	uint8_t acmd[16];           /* ATAPI command, unused. */
+	uint8_t reserved[48];
+	struct prd prdt[PRD_CNT];   /* Scatter/gather list. */
+} __attribute__ ((packed));
+
+/* The command list takes the first 1 kB of a port's page and the
+   received FIS area the 256 bytes after it. */
+#define FIS_OFS 1024
+
+/* Largest transfer in a single command.  It is limited both by
+   the 16-bit sector count and by the scatter/gather list. */
+#define AHCI_MAX_SECTORS (PRD_CNT * PRD_MAX / DISK_SECTOR_SIZE)
+
+/* An AHCI port with an ATA disk attached. */
+struct ahci_port {
+	char name[8];               /* Name, e.g. "sd0". */
+	int port_no;                /* Port number within the HBA. */
+	volatile uint8_t *regs;     /* Port register block. */
+
+	struct cmd_header *cl;      /* Command list. */
+	struct cmd_table *ct;       /* One command table per slot. */
+	uint16_t *id;               /* IDENTIFY DEVICE data. */
+
+	bool ncq;                   /* Issue queued commands? */
+	int depth;                  /* Number of usable slots. */
+
+	struct semaphore free_slots;    /* Counts unallocated slots. */
+	struct lock exclusive;      /* Held while draining the queue. */
+	uint32_t busy;              /* Slots owned by some thread. */
+	uint32_t issued;            /* Slots handed to the HBA, not done. */
+	uint32_t failed;            /* Slots that completed with an error. */
+	struct semaphore done[AHCI_SLOT_CNT];   /* Up'd at completion. */
+};
+
+/* Base of the HBA's memory-mapped registers. */
+static volatile uint8_t *abar;
+
+/* HBA capabilities. */
+static uint32_t hba_cap;
+
+/* Ports with an ATA disk attached. */
+static struct ahci_port ports[32];
+static size_t port_cnt;
+
+static bool pci_find_ahci (int *bus, int *dev, int *func);
+static uint32_t pci_read (int bus, int dev, int func, int reg);
+static void pci_write (int bus, int dev, int func, int reg, uint32_t);
+static void *map_mmio (uint64_t pa, size_t size);
+
+static bool port_init (struct ahci_port *, int port_no);
+static bool port_stop (struct ahci_port *);
+static void port_start (struct ahci_port *);
+static bool identify_device (struct ahci_port *);
+
+static void prepare_slot (struct ahci_port *, int slot,
+		const struct fis_reg_h2d *, void *buffer, size_t size, bool write);
+static bool exec_polled (struct ahci_port *, const struct fis_reg_h2d *,
+		void *buffer, size_t size);
+static bool exec_queued (struct ahci_port *, uint64_t sec_no,
+		size_t sec_cnt, void *buffer, bool write, uint64_t *issued);
+static int alloc_slot (struct ahci_port *);
+static void free_slot (struct ahci_port *, int slot);
+static bool issue_slot (struct ahci_port *, int slot, bool queued);
+
+static void interrupt_handler (struct intr_frame *);
+
+static inline uint32_t
+hba_read (size_t reg) {
+	return *(volatile uint32_t *) (abar + reg);
+}
+
+static inline void
+hba_write (size_t reg, uint32_t value) {
+	*(volatile uint32_t *) (abar + reg) = value;
+}
+
+static inline uint32_t
+port_read (const struct ahci_port *p, size_t reg) {
+	return *(volatile uint32_t *) (p->regs + reg);
+}
+
+static inline void
+port_write (struct ahci_port *p, size_t reg, uint32_t value) {
+	*(volatile uint32_t *) (p->regs + reg) = value;
+}
+
+/* Looks for an AHCI controller on the PCI bus and initializes
+   every port that has an ATA disk attached.  Returns the number
+   of such ports, which may be 0. */
+size_t
+ahci_init (void) {
+	int bus, dev, func;
+	uint32_t cmd, abar_pa, pi;
+	uint8_t irq;
+	int port_no;
+
+	if (!pci_find_ahci (&bus, &dev, &func))
+		return 0;
+
+	irq = pci_read (bus, dev, func, PCI_INTR) & 0xff;
+	if (irq >= 16 || irq == 14 || irq == 15) {
+		/* We need a legacy PIC line of our own; 14 and 15 belong
+		   to the IDE channels. */
+		printf ("ahci: unusable interrupt line %d, ignoring controller\n",
+				irq);
+		return 0;
+	}
+
+	/* Let the HBA decode its registers and master the bus. */
+	cmd = pci_read (bus, dev, func, PCI_COMMAND);
+	cmd = (cmd | PCI_CMD_MEM | PCI_CMD_MASTER) & ~PCI_CMD_INTX_OFF;
+	pci_write (bus, dev, func, PCI_COMMAND, cmd & 0xffff);
+
+	abar_pa = pci_read (bus, dev, func, PCI_ABAR) & ~0xfu;
+	abar = map_mmio (abar_pa, HBA_SIZE);
+
+	/* Switch to AHCI mode, keeping interrupts off until the ports
+	   are set up and our handler is registered. */
+	hba_write (HBA_GHC, (hba_read (HBA_GHC) | GHC_AE) & ~GHC_IE);
+	hba_cap = hba_read (HBA_CAP);
+	pi = hba_read (HBA_PI);
+
+	for (port_no = 0; port_no < 32; port_no++)
+		if ((pi & (1u << port_no)) && port_init (&ports[port_cnt], port_no))
+			port_cnt++;
+	if (port_cnt == 0)
+		return 0;
+
+	intr_register_ext (irq + 0x20, interrupt_handler, "ahci");
+	hba_write (HBA_IS, hba_read (HBA_IS));
+	hba_write (HBA_GHC, hba_read (HBA_GHC) | GHC_IE);
+	return port_cnt;
+}
+
+/* Returns the IDX'th port found by ahci_init(). */
+struct ahci_port *
+ahci_get_port (size_t idx) {
+	ASSERT (idx < port_cnt);
+	return &ports[idx];
+}
+
+/* Returns P's name, e.g. "sd0". */
+const char *
+ahci_port_name (const struct ahci_port *p) {
+	return p->name;
+}
+
+/* Returns the number of the HBA port that P drives. */
+int
+ahci_port_no (const struct ahci_port *p) {
+	return p->port_no;
+}
+
+/* Returns the 256 words of IDENTIFY DEVICE data read from the
+   disk on port P. */
+const uint16_t *
+ahci_identify_data (const struct ahci_port *p) {
+	return p->id;
+}
+
+/* Returns the number of commands that may be outstanding on
+   port P at once: the NCQ queue depth, or 1 without NCQ. */
+int
+ahci_queue_depth (const struct ahci_port *p) {
+	return p->depth;
+}
+
+/* Reads SEC_CNT sectors starting at SEC_NO from the disk on port
+   P into BUFFER.  Blocks until the data has arrived.  Any number
+   of threads may call this at once; up to ahci_queue_depth()
+   of their requests are handed to the drive together.  Stores
+   in *ISSUED the time-stamp counter at which the command was
+   handed to the HBA, so that the caller can tell time spent
+   waiting for a slot from time spent in the drive.  Returns
+   true if successful, false on a device error. */
+bool
+ahci_read (struct ahci_port *p, uint64_t sec_no, size_t sec_cnt,
+		void *buffer, uint64_t *issued) {
+	return exec_queued (p, sec_no, sec_cnt, buffer, false, issued);
+}
+
+/* Writes SEC_CNT sectors starting at SEC_NO to the disk on port
+   P from BUFFER.  Returns after the drive has acknowledged the
+   data, with the same concurrency and timing as ahci_read(). */
+bool
+ahci_write (struct ahci_port *p, uint64_t sec_no, size_t sec_cnt,
+		const void *buffer, uint64_t *issued) {
+	return exec_queued (p, sec_no, sec_cnt, (void *) buffer, true, issued);
+}
+
+/* Executes the ATA command COMMAND, which transfers no data,
+   with FEATURE in the features register, on port P.  Used for
+   FLUSH CACHE and SET FEATURES.  Returns true if successful.
+
+   A non-queued command may not be issued while queued commands
+   are outstanding, so this first takes every slot, waiting for
+   the commands that hold them to complete. */
+bool
+ahci_nondata (struct ahci_port *p, uint8_t command, uint8_t feature) {
+	struct fis_reg_h2d fis;
+	bool ok;
+	int i, slot;
+
+	ASSERT (!intr_context ());
+
+	lock_acquire (&p->exclusive);
+	for (i = 0; i < p->depth; i++)
+		sema_down (&p->free_slots);
+	slot = alloc_slot (p);
+
+	memset (&fis, 0, sizeof fis);
+	fis.command = command;
+	fis.featurel = feature;
+	fis.device = FIS_DEV_LBA;
+	prepare_slot (p, slot, &fis, NULL, 0, false);
+	ok = issue_slot (p, slot, false);
+
+	free_slot (p, slot);
+	for (i = 0; i < p->depth; i++)
+		sema_up (&p->free_slots);
+	lock_release (&p->exclusive);
+	return ok;
+}
+
+/* PCI access. */
+
+/* Scans the PCI bus for an AHCI controller and stores its
+   location in *BUS, *DEV, *FUNC.  Returns false if none is
+   found. */
+static bool
+pci_find_ahci (int *bus, int *dev, int *func) {
+	int b, d, f;
+
+	for (b = 0; b < 256; b++)
+		for (d = 0; d < 32; d++)
+			for (f = 0; f < 8; f++) {
+				if ((pci_read (b, d, f, PCI_ID) & 0xffff) == 0xffff) {
+					if (f == 0)
+						break;
+					continue;
+				}
+				if ((pci_read (b, d, f, PCI_CLASS) >> 8) == PCI_CLASS_AHCI) {
+					*bus = b;
+					*dev = d;
+					*func = f;
+					return true;
+				}
+				if (f == 0 && !(pci_read (b, d, f, PCI_HEADER) & 0x800000))
+					break;
+			}
+	return false;
+}
+
+/* Reads the 32-bit configuration register REG of the given PCI
+   function. */
+static uint32_t
+pci_read (int bus, int dev, int func, int reg) {
+	outl (PCI_CONFIG_ADDR, 0x80000000u | bus << 16 | dev << 11 | func << 8
+			| (reg & 0xfc));
+	return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to the 32-bit configuration register REG of the
+   given PCI function. */
+static void
+pci_write (int bus, int dev, int func, int reg, uint32_t value) {
+	outl (PCI_CONFIG_ADDR, 0x80000000u | bus << 16 | dev << 11 | func << 8
+			| (reg & 0xfc));
+	outl (PCI_CONFIG_DATA, value);
+}
+
+/* Maps SIZE bytes of device memory at physical address PA at
+   its usual kernel virtual address, with caching disabled, and
+   returns that address.  The mapping goes into base_pml4, whose
+   kernel half every process page table shares. */
+static void *
+map_mmio (uint64_t pa, size_t size) {
+	uint64_t ofs;
+
+	for (ofs = pa & ~(uint64_t) PGMASK; ofs < pa + size; ofs += PGSIZE) {
+		uint64_t va = (uint64_t) ptov (ofs);
+		uint64_t *pte = pml4e_walk (base_pml4, va, 1);
+		if (pte == NULL)
+			PANIC ("ahci: out of memory mapping registers");
+		*pte = ofs | PTE_P | PTE_W | PTE_PWT | PTE_PCD;
+		invlpg (va);
+	}
+	return ptov (pa);
+}
+
+/* Port setup. */
+
+/* Initializes P for port PORT_NO, if it has an ATA disk
+   attached.  Returns true if successful, false if the port
+   should be ignored. */
+static bool
+port_init (struct ahci_port *p, int port_no) {
+	uint8_t *page;
+	size_t ct_pages;
+	int slot;
+
+	memset (p, 0, sizeof *p);
+	p->port_no = port_no;
+	p->regs = abar + HBA_PORT (port_no);
+	if ((port_read (p, PX_SSTS) & 0xf) != SSTS_DET_PRESENT
+			|| port_read (p, PX_SIG) != SIG_ATA)
+		return false;
+	snprintf (p->name, sizeof p->name, "sd%zu", port_cnt);
+
+	if (!port_stop (p)) {
+		printf ("%s: port %d does not stop, ignoring\n", p->name, port_no);
+		return false;
+	}
+
+	/* Command list, received FIS area, and command tables. */
+	ct_pages = DIV_ROUND_UP (AHCI_SLOT_CNT * sizeof *p->ct, PGSIZE);
+	page = palloc_get_page (PAL_ZERO);
+	p->ct = palloc_get_multiple (PAL_ZERO, ct_pages);
+	p->id = malloc (DISK_SECTOR_SIZE);
+	if (page == NULL || p->ct == NULL || p->id == NULL)
+		PANIC ("%s: out of memory", p->name);
+	p->cl = (struct cmd_header *) page;
+	for (slot = 0; slot < AHCI_SLOT_CNT; slot++)
+		p->cl[slot].ctba = vtop (&p->ct[slot]);
+
+	port_write (p, PX_CLB, vtop (page));
+	port_write (p, PX_CLBU, vtop (page) >> 32);
+	port_write (p, PX_FB, vtop (page + FIS_OFS));
+	port_write (p, PX_FBU, vtop (page + FIS_OFS) >> 32);
+	port_write (p, PX_SERR, port_read (p, PX_SERR));
+	port_write (p, PX_IS, port_read (p, PX_IS));
+	port_start (p);
+
+	if (!identify_device (p)) {
+		printf ("%s: IDENTIFY DEVICE failed, ignoring\n", p->name);
+		port_stop (p);
+		palloc_free_page (page);
+		palloc_free_multiple (p->ct, ct_pages);
+		free (p->id);
+		return false;
+	}
+
+	/* Use as many slots as both the HBA and the drive allow. */
+	if (p->ncq) {
+		p->depth = (p->id[75] & 0x1f) + 1;
+		if (p->depth > (int) CAP_NCS (hba_cap))
+			p->depth = CAP_NCS (hba_cap);
+	} else
+		p->depth = 1;
+	p->busy = p->depth < 32 ? ~((1u << p->depth) - 1) : 0;
+	sema_init (&p->free_slots, p->depth);
+	lock_init (&p->exclusive);
+	for (slot = 0; slot < AHCI_SLOT_CNT; slot++)
+		sema_init (&p->done[slot], 0);
+
+	port_write (p, PX_IE, IS_DHRS | IS_PSS | IS_DSS | IS_SDBS | IS_ERRORS);
+	printf ("%s: AHCI port %d, %s, queue depth %d\n", p->name, port_no,
+			p->ncq ? "NCQ" : "no NCQ", p->depth);
+	return true;
+}
+
+/* Stops P's command and FIS receive engines, waiting up to
+   500 ms for each.  Returns true if both stopped. */
+static bool
+port_stop (struct ahci_port *p) {
+	int i;
+
+	port_write (p, PX_CMD, port_read (p, PX_CMD) & ~CMD_ST);
+	for (i = 0; i < 50 && (port_read (p, PX_CMD) & CMD_CR); i++)
+		timer_msleep (10);
+
+	port_write (p, PX_CMD, port_read (p, PX_CMD) & ~CMD_FRE);
+	for (i = 0; i < 50 && (port_read (p, PX_CMD) & CMD_FR); i++)
+		timer_msleep (10);
+
+	return (port_read (p, PX_CMD) & (CMD_CR | CMD_FR)) == 0;
+}
+
+/* Starts P's FIS receive and command engines once the drive is
+   no longer busy. */
+static void
+port_start (struct ahci_port *p) {
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		if ((port_read (p, PX_TFD) & (TFD_BSY | TFD_DRQ)) == 0)
+			break;
+		timer_msleep (10);
+	}
+	port_write (p, PX_CMD, port_read (p, PX_CMD) | CMD_FRE);
+	port_write (p, PX_CMD, port_read (p, PX_CMD) | CMD_ST);
+}
+
+/* Sends IDENTIFY DEVICE to the disk on port P and stores the
+   result in P->id.  Also decides whether to use NCQ.  Returns
+   true if successful. */
+static bool
+identify_device (struct ahci_port *p) {
+	struct fis_reg_h2d fis;
+
+	memset (&fis, 0, sizeof fis);
+	fis.command = ATA_IDENTIFY_DEVICE;
+	if (!exec_polled (p, &fis, p->id, DISK_SECTOR_SIZE))
+		return false;
+
+	/* Word 76 bit 8: NCQ supported; word 83 bit 10: 48-bit
+	   addressing, which the queued commands require. */
+	p->ncq = (hba_cap & CAP_SNCQ) != 0
+		&& (p->id[76] & (1 << 8)) != 0
+		&& (p->id[83] & (1 << 10)) != 0;
+	return true;
+}
+
+/* Command execution. */
+
+/* Fills in SLOT of P's command list to execute the command in
+   FIS, transferring SIZE bytes to or from BUFFER, which must be
+   a physically contiguous kernel buffer. */
+static void
+prepare_slot (struct ahci_port *p, int slot, const struct fis_reg_h2d *fis,
+		void *buffer, size_t size, bool write) {
+	struct cmd_header *h = &p->cl[slot];
+	struct cmd_table *t = &p->ct[slot];
+	uint64_t pa = size > 0 ? vtop (buffer) : 0;
+	int prd_cnt = 0;
+
+	memcpy (t->cfis, fis, sizeof *fis);
+	t->cfis[0] = FIS_TYPE_REG_H2D;
+	t->cfis[1] = FIS_C;
+	while (size > 0) {
+		size_t chunk = size < PRD_MAX ? size : PRD_MAX;
+
+		ASSERT (prd_cnt < PRD_CNT);
+		t->prdt[prd_cnt].dba = pa;
+		t->prdt[prd_cnt].reserved = 0;
+		t->prdt[prd_cnt].dbc = chunk - 1;
+		prd_cnt++;
+		pa += chunk;
+		size -= chunk;
+	}
+
+	h->flags = sizeof *fis / 4 | (write ? CH_WRITE : 0);
+	h->prdtl = prd_cnt;
+	h->prdbc = 0;
+}
+
+/* Executes the command in FIS in slot 0 of port P, reading SIZE
+   bytes into BUFFER, and polls for its completion for up to
+   10 seconds.  Only for use before the port's interrupts are
+   enabled.  Returns true if successful. */
+static bool
+exec_polled (struct ahci_port *p, const struct fis_reg_h2d *fis,
+		void *buffer, size_t size) {
+	uint32_t is;
+	int i;
+
+	prepare_slot (p, 0, fis, buffer, size, false);
+	port_write (p, PX_CI, 1);
+	for (i = 0; i < 1000; i++) {
+		is = port_read (p, PX_IS);
+		if ((is & IS_ERRORS) || !(port_read (p, PX_CI) & 1))
+			break;
+		timer_msleep (10);
+	}
+	port_write (p, PX_IS, port_read (p, PX_IS));
+
+	return !(is & IS_ERRORS)
+		&& !(port_read (p, PX_CI) & 1)
+		&& !(port_read (p, PX_TFD) & TFD_ERR);
+}
+
+/* Issues a read (or, if WRITE, a write) of SEC_CNT sectors at
+   SEC_NO on port P and sleeps until the HBA reports completion.
+   Stores the time of issue in *ISSUED.
+
+   BUFFER is handed to the HBA directly when it is a kernel
+   address, which is always physically contiguous in Pintos.
+   Anything else goes through a bounce buffer. */
+static bool
+exec_queued (struct ahci_port *p, uint64_t sec_no, size_t sec_cnt,
+		void *buffer, bool write, uint64_t *issued) {
+	size_t size = sec_cnt * DISK_SECTOR_SIZE;
+	struct fis_reg_h2d fis;
+	void *dma = buffer;
+	bool ok;
+	int slot;
+
+	ASSERT (p != NULL);
+	ASSERT (buffer != NULL);
+	ASSERT (sec_cnt > 0 && sec_cnt <= AHCI_MAX_SECTORS);
+	ASSERT (sec_no + sec_cnt <= (1ULL << 48));
+	ASSERT (!intr_context ());
+
+	if (!is_kernel_vaddr (buffer) || (uintptr_t) buffer % 2 != 0) {
+		dma = malloc (size);
+		if (dma == NULL)
+			return false;
+		if (write)
+			memcpy (dma, buffer, size);
+	}
+
+	/* With NCQ the slot number doubles as the command's tag. */
+	sema_down (&p->free_slots);
+	slot = alloc_slot (p);
+
+	memset (&fis, 0, sizeof fis);
+	fis.device = FIS_DEV_LBA;
+	fis.lba0 = sec_no;
+	fis.lba1 = sec_no >> 8;
+	fis.lba2 = sec_no >> 16;
+	fis.lba3 = sec_no >> 24;
+	fis.lba4 = sec_no >> 32;
+	fis.lba5 = sec_no >> 40;
+	if (p->ncq) {
+		/* The sector count goes in the features field and the tag
+		   in bits 7:3 of the count field. */
+		fis.command = write ? ATA_WRITE_FPDMA_QUEUED : ATA_READ_FPDMA_QUEUED;
+		fis.featurel = sec_cnt;
+		fis.featureh = sec_cnt >> 8;
+		fis.countl = slot << 3;
+	} else {
+		fis.command = write ? ATA_WRITE_DMA_EXT : ATA_READ_DMA_EXT;
+		fis.countl = sec_cnt;
+		fis.counth = sec_cnt >> 8;
+	}
+	prepare_slot (p, slot, &fis, dma, size, write);
+	*issued = rdtsc ();
+	ok = issue_slot (p, slot, p->ncq);
+	free_slot (p, slot);
+	sema_up (&p->free_slots);
+
+	if (dma != buffer) {
+		if (ok && !write)
+			memcpy (buffer, dma, size);
+		free (dma);
+	}
+	return ok;
+}
+
+/* Claims a free slot on port P and returns its number.  The
+   caller must already have downed P->free_slots. */
+static int
+alloc_slot (struct ahci_port *p) {
+	enum intr_level old_level = intr_disable ();
+	int slot = __builtin_ctz (~p->busy);
+
+	p->busy |= 1u << slot;
+	intr_set_level (old_level);
+	return slot;
+}
+
+/* Returns SLOT on port P to the free pool.  The caller must up
+   P->free_slots afterward. */
+static void
+free_slot (struct ahci_port *p, int slot) {
+	enum intr_level old_level = intr_disable ();
+
+	p->busy &= ~(1u << slot);
+	intr_set_level (old_level);
+}
+
+/* Hands the command prepared in SLOT of port P to the HBA and
+   sleeps until it completes.  QUEUED commands must be marked
+   active in PxSACT before they are issued.  Returns true if the
+   command succeeded. */
+static bool
+issue_slot (struct ahci_port *p, int slot, bool queued) {
+	uint32_t bit = 1u << slot;
+	enum intr_level old_level;
+	bool ok;
+
+	old_level = intr_disable ();
+	p->issued |= bit;
+	if (queued)
+		port_write (p, PX_SACT, bit);
+	port_write (p, PX_CI, bit);
+	intr_set_level (old_level);
+
+	sema_down (&p->done[slot]);
+
+	old_level = intr_disable ();
+	ok = (p->failed & bit) == 0;
+	p->failed &= ~bit;
+	intr_set_level (old_level);
+	return ok;
+}
+
+/* Wakes up the threads waiting on each slot of port P in
+   DONE. */
+static void
+complete_slots (struct ahci_port *p, uint32_t done) {
+	while (done != 0) {
+		int slot = __builtin_ctz (done);
+
+		done &= done - 1;
+		p->issued &= ~(1u << slot);
+		sema_up (&p->done[slot]);
+	}
+}
+
+/* AHCI interrupt handler.  A command is complete once the HBA
+   has cleared its bits in both PxCI and PxSACT.  On an error,
+   we fail every outstanding command on the port; as with the IDE
+   driver, disk.c turns that into a kernel panic. */
+static void
+interrupt_handler (struct intr_frame *f UNUSED) {
+	uint32_t hba_is = hba_read (HBA_IS);
+	size_t i;
+
+	for (i = 0; i < port_cnt; i++) {
+		struct ahci_port *p = &ports[i];
+		uint32_t is;
+
+		if (!(hba_is & (1u << p->port_no)))
+			continue;
+
+		is = port_read (p, PX_IS);
+		port_write (p, PX_IS, is);
+		if (is & IS_ERRORS) {
+			printf ("%s: error, status %#"PRIx32", task file %#"PRIx32"\n",
+					p->name, is, port_read (p, PX_TFD));
+			p->failed |= p->issued;
+			complete_slots (p, p->issued);
+		} else
+			complete_slots (p, p->issued
+					& ~(port_read (p, PX_CI) | port_read (p, PX_SACT)));
+	}
+	hba_write (HBA_IS, hba_is);
+}
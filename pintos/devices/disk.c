@@ -2,18 +2,28 @@
 #include <ctype.h>
 #include <debug.h>
 #include <stdbool.h>
+#include <iostat.h>
 #include <stdio.h>
+#include <string.h>
+#include "devices/ahci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   Disks attached to an AHCI controller are driven by ahci.c but
+   are presented through the same interface, so the rest of the
+   kernel does not need to know which kind of disk it has. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
-#define reg_error(CHANNEL) ((CHANNEL)->reg_base + 1)    /* Error. */
+#define reg_error(CHANNEL) ((CHANNEL)->reg_base + 1)    /* Error (r/o). */
+#define reg_features(CHANNEL) reg_error (CHANNEL)       /* Features (w/o). */
 #define reg_nsect(CHANNEL) ((CHANNEL)->reg_base + 2)    /* Sector Count. */
 #define reg_lbal(CHANNEL) ((CHANNEL)->reg_base + 3)     /* LBA 0:7. */
 #define reg_lbam(CHANNEL) ((CHANNEL)->reg_base + 4)     /* LBA 15:8. */
@@ -32,6 +42,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,20 +58,71 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_SECTOR_EXT 0x24        /* READ SECTOR EXT (LBA48). */
+#define CMD_WRITE_SECTOR_EXT 0x34       /* WRITE SECTOR EXT (LBA48). */
+#define CMD_SET_FEATURES 0xef           /* SET FEATURES. */
+#define CMD_FLUSH_CACHE 0xe7            /* FLUSH CACHE. */
+#define CMD_FLUSH_CACHE_EXT 0xea        /* FLUSH CACHE EXT (LBA48). */
+
+/* SET FEATURES subcommands, written to the Features register. */
+#define SF_ENABLE_WCACHE 0x02           /* Enable volatile write cache. */
+#define SF_DISABLE_WCACHE 0x82          /* Disable volatile write cache. */
+
+/* Most sectors a single command can transfer, with 28-bit and
+   48-bit addressing respectively. */
+#define LBA28_MAX_SECTORS 256
+#define LBA48_MAX_SECTORS 65536
+
+/* Log2 histogram of time-stamp counter intervals.  Bucket I
+   counts intervals of at least 2**I cycles and fewer than
+   2**(I+1); bucket 0 also counts empty intervals. */
+#define HIST_BUCKETS 48
+struct io_hist {
+	long long cnt[HIST_BUCKETS];
+};
 
 /* An ATA device. */
 struct disk {
 	char name[8];               /* Name, e.g. "hd0:1". */
-	struct channel *channel;    /* Channel disk is on. */
+	struct channel *channel;    /* Channel disk is on, if IDE. */
+	struct ahci_port *ahci;     /* AHCI port disk is on, if SATA. */
 	int dev_no;                 /* Device 0 or 1 for master or slave. */
 
 	bool is_ata;                /* 1=This device is an ATA disk. */
+	bool lba48;                 /* 1=Supports 48-bit addressing. */
+	bool has_cache;             /* 1=Has a volatile write cache. */
+	bool write_cache;           /* 1=Write cache is enabled. */
 	disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
+	long long read_bytes;       /* Number of bytes read. */
+	long long write_bytes;      /* Number of bytes written. */
+
+	int in_flight;              /* Requests now in the driver. */
+	uint64_t busy_since;        /* TSC when in_flight became nonzero. */
+	uint64_t busy_tsc;          /* TSC cycles spent with in_flight > 0. */
+	struct io_hist queue_hist;  /* Arrival to issue, in TSC cycles. */
+	struct io_hist service_hist;    /* Issue to completion. */
 };
 
+/* Timing of one request, for the statistics above. */
+struct io_timing {
+	uint64_t start;             /* TSC when the request arrived. */
+	uint64_t issued;            /* TSC when it went to the hardware. */
+	int64_t start_ticks;        /* Timer ticks when it arrived. */
+};
+
+/* Threads that did the most disk I/O, busiest first, kept so that
+   disk_print_stats() can report on threads that have exited. */
+#define TOP_IO_CNT 8
+struct io_account {
+	char name[16];              /* Thread name. */
+	tid_t tid;                  /* Thread identifier. */
+	struct iostat st;           /* What it did. */
+};
+static struct io_account top_io[TOP_IO_CNT];
+
 /* An ATA channel (aka controller).
    Each channel can control up to two disks. */
 struct channel {
@@ -80,11 +142,38 @@ struct channel {
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* Disks found on an AHCI controller.  The disk on port N takes
+   the Nth (CHAN_NO, DEV_NO) position, in the order listed above
+   disk_get(), that has no IDE disk.  Booting from IDE with the
+   file system, scratch, and swap disks on SATA ports 0, 1, and 2
+   thus gives every disk its usual role. */
+#define AHCI_DISK_CNT 4
+static struct disk ahci_disks[AHCI_DISK_CNT];
+static struct disk *ahci_slots[CHANNEL_CNT][2];
+
+static void attach_ahci_disks (void);
+
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
-
-static void select_sector (struct disk *, disk_sector_t);
+static void describe_disk (struct disk *, const uint16_t *id);
+
+static void select_sectors (struct disk *, disk_sector_t, size_t sec_cnt);
+static void pio_read (struct disk *, disk_sector_t, size_t, void *,
+		uint64_t *issued);
+static void pio_write (struct disk *, disk_sector_t, size_t, const void *,
+		uint64_t *issued);
+
+static void io_begin (struct disk *, struct io_timing *);
+static void io_end (struct disk *, bool write, size_t sec_cnt,
+		const struct io_timing *);
+static void hist_add (struct io_hist *, uint64_t cycles);
+static void hist_print (const struct disk *, const char *what,
+		const struct io_hist *);
+static void top_io_add (struct io_account[], const struct thread *);
+static void print_thread_stats (void);
+static void find_thread_stats (struct thread *, void *aux);
+static bool exec_nondata (struct disk *, uint8_t command, uint8_t feature);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -128,9 +217,12 @@ disk_init (void) {
 			struct disk *d = &c->devices[dev_no];
 			snprintf (d->name, sizeof d->name, "%s:%d", c->name, dev_no);
 			d->channel = c;
+			d->ahci = NULL;
 			d->dev_no = dev_no;
 
 			d->is_ata = false;
+			d->lba48 = false;
+			d->has_cache = d->write_cache = false;
 			d->capacity = 0;
 
 			d->read_cnt = d->write_cnt = 0;
@@ -152,6 +244,9 @@ disk_init (void) {
 				identify_ata_device (&c->devices[dev_no]);
 	}
 
+	/* Fill the positions left empty by IDE with SATA disks. */
+	attach_ahci_disks ();
+
 	/* DO NOT MODIFY BELOW LINES. */
 	register_disk_inspect_intr ();
 }
@@ -166,11 +261,94 @@ disk_print_stats (void) {
 
 		for (dev_no = 0; dev_no < 2; dev_no++) {
 			struct disk *d = disk_get (chan_no, dev_no);
-			if (d != NULL && d->is_ata)
+			if (d != NULL && d->is_ata) {
 				printf ("%s: %lld reads, %lld writes\n",
 						d->name, d->read_cnt, d->write_cnt);
+				if (d->read_cnt + d->write_cnt == 0)
+					continue;
+				printf ("%s: %lld bytes read, %lld bytes written, "
+						"busy %"PRIu64" cycles\n",
+						d->name, d->read_bytes, d->write_bytes, d->busy_tsc);
+				hist_print (d, "queue", &d->queue_hist);
+				hist_print (d, "service", &d->service_hist);
+			}
 		}
 	}
+
+	print_thread_stats ();
+}
+
+/* Adds running thread T to the table of top I/O threads in AUX. */
+static void
+add_live_thread (struct thread *t, void *aux) {
+	top_io_add (aux, t);
+}
+
+/* Prints the threads, running or exited, that did the most disk
+   I/O. */
+static void
+print_thread_stats (void) {
+	struct io_account top[TOP_IO_CNT];
+	enum intr_level old_level;
+	int i;
+
+	old_level = intr_disable ();
+	memcpy (top, top_io, sizeof top);
+	thread_foreach (add_live_thread, top);
+	intr_set_level (old_level);
+
+	for (i = 0; i < TOP_IO_CNT; i++) {
+		struct io_account *a = &top[i];
+		if (a->st.read_bytes + a->st.write_bytes == 0)
+			break;
+		if (i == 0)
+			printf ("Disk I/O by thread:\n");
+		printf ("  %s (tid %d): %"PRIu64" bytes read, %"PRIu64" bytes written, "
+				"%"PRId64" ticks waiting\n", a->name, a->tid,
+				a->st.read_bytes, a->st.write_bytes, a->st.wait_ticks);
+	}
+}
+
+/* Records the disk I/O of thread T, which is exiting, so that
+   disk_print_stats() can still report it. */
+void
+disk_account_exit (const struct thread *t) {
+	enum intr_level old_level = intr_disable ();
+	top_io_add (top_io, t);
+	intr_set_level (old_level);
+}
+
+/* Stores the disk I/O done so far by the thread with identifier
+   TID in *ST.  Returns true if successful, false if there is no
+   such thread. */
+bool
+disk_iostat (tid_t tid, struct iostat *st) {
+	struct io_account a;
+	enum intr_level old_level;
+
+	a.tid = tid;
+	a.st.wait_ticks = -1;
+	old_level = intr_disable ();
+	thread_foreach (find_thread_stats, &a);
+	intr_set_level (old_level);
+
+	if (a.st.wait_ticks < 0)
+		return false;
+	*st = a.st;
+	return true;
+}
+
+/* If T is the thread that AUX, a struct io_account, is looking
+   for, copies T's I/O statistics into it. */
+static void
+find_thread_stats (struct thread *t, void *aux) {
+	struct io_account *a = aux;
+
+	if (t->tid == a->tid) {
+		a->st.read_bytes = t->io_read_bytes;
+		a->st.write_bytes = t->io_write_bytes;
+		a->st.wait_ticks = t->io_wait_ticks;
+	}
 }
 
 /* Returns the disk numbered DEV_NO--either 0 or 1 for master or
@@ -190,6 +368,8 @@ disk_get (int chan_no, int dev_no) {
 		struct disk *d = &channels[chan_no].devices[dev_no];
 		if (d->is_ata)
 			return d;
+		if (ahci_slots[chan_no][dev_no] != NULL)
+			return ahci_slots[chan_no][dev_no];
 	}
 	return NULL;
 }
@@ -209,21 +389,7 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
-	struct channel *c;
-
-	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
-
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
-	lock_release (&c->lock);
+	disk_read_multiple (d, sec_no, 1, buffer);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -233,26 +399,286 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
    per-disk locking is unneeded. */
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
-	struct channel *c;
+	disk_write_multiple (d, sec_no, 1, buffer);
+}
+
+/* Turns disk D's volatile write cache on if ENABLE is true, off
+   otherwise.  disk_init() turns it on for every disk that has
+   one.  With the cache on, disk_write() returns once the data is
+   in the drive's memory, which is much faster but means it may be
+   lost on power failure until disk_flush() is called.  Returns
+   true if successful, false if D has no write cache or rejected
+   the request. */
+bool
+disk_set_write_cache (struct disk *d, bool enable) {
+	ASSERT (d != NULL);
+
+	if (!d->has_cache)
+		return false;
+	if (!exec_nondata (d, CMD_SET_FEATURES,
+				enable ? SF_ENABLE_WCACHE : SF_DISABLE_WCACHE))
+		return false;
+	d->write_cache = enable;
+	return true;
+}
+
+/* Waits until every sector written to disk D so far is on
+   stable media, by telling the drive to write back its cache.
+   This is the durability point for file system updates; it
+   returns at once if D's write cache is off.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_flush (struct disk *d) {
+	ASSERT (d != NULL);
+
+	if (!d->write_cache)
+		return;
+	if (!exec_nondata (d, d->lba48 ? CMD_FLUSH_CACHE_EXT : CMD_FLUSH_CACHE, 0))
+		PANIC ("%s: disk flush failed", d->name);
+}
+
+/* Returns the number of sectors a single command can move to or
+   from disk D. */
+static size_t
+max_transfer (const struct disk *d) {
+	return d->lba48 ? LBA48_MAX_SECTORS : LBA28_MAX_SECTORS;
+}
+
+/* Reads SEC_CNT consecutive sectors starting at SEC_NO from disk
+   D into BUFFER, which must have room for SEC_CNT *
+   DISK_SECTOR_SIZE bytes.  Each command moves as many as 65536
+   sectors (256 on a disk without LBA48), so this is much cheaper
+   than as many calls to disk_read().
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, size_t sec_cnt,
+		void *buffer_) {
+	uint8_t *buffer = buffer_;
+
+	ASSERT (d != NULL);
+	ASSERT (buffer != NULL);
+	ASSERT (sec_no < d->capacity && sec_cnt <= d->capacity - sec_no);
+
+	while (sec_cnt > 0) {
+		size_t cnt = sec_cnt < max_transfer (d) ? sec_cnt : max_transfer (d);
+		struct io_timing tm;
+
+		io_begin (d, &tm);
+		if (d->ahci == NULL)
+			pio_read (d, sec_no, cnt, buffer, &tm.issued);
+		else if (!ahci_read (d->ahci, sec_no, cnt, buffer, &tm.issued))
+			PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
+		io_end (d, false, cnt, &tm);
+
+		sec_no += cnt;
+		sec_cnt -= cnt;
+		buffer += cnt * DISK_SECTOR_SIZE;
+	}
+}
+
+/* Writes SEC_CNT consecutive sectors starting at SEC_NO to disk
+   D from BUFFER, which must contain SEC_CNT * DISK_SECTOR_SIZE
+   bytes.  Returns after the disk has acknowledged receiving all
+   of the data.  Batches sectors into commands as
+   disk_read_multiple() does.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no, size_t sec_cnt,
+		const void *buffer_) {
+	const uint8_t *buffer = buffer_;
 
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
+	ASSERT (sec_no < d->capacity && sec_cnt <= d->capacity - sec_no);
+
+	while (sec_cnt > 0) {
+		size_t cnt = sec_cnt < max_transfer (d) ? sec_cnt : max_transfer (d);
+		struct io_timing tm;
+
+		io_begin (d, &tm);
+		if (d->ahci == NULL)
+			pio_write (d, sec_no, cnt, buffer, &tm.issued);
+		else if (!ahci_write (d->ahci, sec_no, cnt, buffer, &tm.issued))
+			PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
+		io_end (d, true, cnt, &tm);
+
+		sec_no += cnt;
+		sec_cnt -= cnt;
+		buffer += cnt * DISK_SECTOR_SIZE;
+	}
+}
+
+/* Reads SEC_CNT sectors starting at SEC_NO from IDE disk D into
+   BUFFER with a single PIO command.  The disk interrupts once
+   for each sector that is ready to be read.  Stores in *ISSUED
+   the time-stamp counter at which D's channel became ours. */
+static void
+pio_read (struct disk *d, disk_sector_t sec_no, size_t sec_cnt,
+		void *buffer_, uint64_t *issued) {
+	struct channel *c = d->channel;
+	uint8_t *buffer = buffer_;
+	size_t i;
+
+	lock_acquire (&c->lock);
+	*issued = rdtsc ();
+	select_sectors (d, sec_no, sec_cnt);
+	issue_pio_command (c, d->lba48 ? CMD_READ_SECTOR_EXT
+			: CMD_READ_SECTOR_RETRY);
+	for (i = 0; i < sec_cnt; i++) {
+		sema_down (&c->completion_wait);
+		if (!wait_while_busy (d))
+			PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name,
+					(disk_sector_t) (sec_no + i));
+		input_sector (c, buffer + i * DISK_SECTOR_SIZE);
+	}
+	lock_release (&c->lock);
+}
+
+/* Writes SEC_CNT sectors starting at SEC_NO to IDE disk D from
+   BUFFER with a single PIO command.  The disk interrupts once it
+   has taken each sector.  Stores the time of issue in *ISSUED,
+   as pio_read() does. */
+static void
+pio_write (struct disk *d, disk_sector_t sec_no, size_t sec_cnt,
+		const void *buffer_, uint64_t *issued) {
+	struct channel *c = d->channel;
+	const uint8_t *buffer = buffer_;
+	size_t i;
 
-	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
+	*issued = rdtsc ();
+	select_sectors (d, sec_no, sec_cnt);
+	issue_pio_command (c, d->lba48 ? CMD_WRITE_SECTOR_EXT
+			: CMD_WRITE_SECTOR_RETRY);
+	for (i = 0; i < sec_cnt; i++) {
+		if (!wait_while_busy (d))
+			PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name,
+					(disk_sector_t) (sec_no + i));
+		output_sector (c, buffer + i * DISK_SECTOR_SIZE);
+		sema_down (&c->completion_wait);
+	}
+	lock_release (&c->lock);
+}
+
+/* Executes COMMAND, which transfers no data, on disk D with
+   FEATURE in the Features register, and waits for it to
+   complete.  Returns true if the disk reports success. */
+static bool
+exec_nondata (struct disk *d, uint8_t command, uint8_t feature) {
+	struct channel *c = d->channel;
+	bool ok;
+
+	if (d->ahci != NULL)
+		return ahci_nondata (d->ahci, command, feature);
+
+	lock_acquire (&c->lock);
+	select_device_wait (d);
+	outb (reg_features (c), feature);
+	issue_pio_command (c, command);
 	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	wait_while_busy (d);
+	ok = (inb (reg_alt_status (c)) & STA_ERR) == 0;
 	lock_release (&c->lock);
+	return ok;
 }
-
+
+/* I/O accounting.  AHCI requests do not hold a channel lock, so
+   the statistics are updated with interrupts disabled. */
+
+/* Notes the arrival of a request on disk D in TM. */
+static void
+io_begin (struct disk *d, struct io_timing *tm) {
+	enum intr_level old_level;
+
+	tm->start_ticks = timer_ticks ();
+	old_level = intr_disable ();
+	tm->start = tm->issued = rdtsc ();
+	if (d->in_flight++ == 0)
+		d->busy_since = tm->start;
+	intr_set_level (old_level);
+}
+
+/* Accounts for the completion of a request for SEC_CNT sectors
+   on disk D, a write if WRITE, timed by TM, to D and to the
+   current thread. */
+static void
+io_end (struct disk *d, bool write, size_t sec_cnt,
+		const struct io_timing *tm) {
+	struct thread *t = thread_current ();
+	int64_t wait_ticks = timer_elapsed (tm->start_ticks);
+	long long bytes = (long long) sec_cnt * DISK_SECTOR_SIZE;
+	enum intr_level old_level;
+	uint64_t now;
+
+	old_level = intr_disable ();
+	now = rdtsc ();
+	if (write) {
+		d->write_cnt += sec_cnt;
+		d->write_bytes += bytes;
+		t->io_write_bytes += bytes;
+	} else {
+		d->read_cnt += sec_cnt;
+		d->read_bytes += bytes;
+		t->io_read_bytes += bytes;
+	}
+	t->io_wait_ticks += wait_ticks;
+	hist_add (&d->queue_hist, tm->issued - tm->start);
+	hist_add (&d->service_hist, now - tm->issued);
+	if (--d->in_flight == 0)
+		d->busy_tsc += now - d->busy_since;
+	intr_set_level (old_level);
+}
+
+/* Adds an interval of CYCLES to histogram H. */
+static void
+hist_add (struct io_hist *h, uint64_t cycles) {
+	int bucket = cycles != 0 ? 63 - __builtin_clzll (cycles) : 0;
+
+	if (bucket >= HIST_BUCKETS)
+		bucket = HIST_BUCKETS - 1;
+	h->cnt[bucket]++;
+}
+
+/* Prints the nonempty buckets of histogram H for disk D, labeled
+   WHAT, on one line. */
+static void
+hist_print (const struct disk *d, const char *what, const struct io_hist *h) {
+	int i;
+
+	printf ("%s: %s cycles:", d->name, what);
+	for (i = 0; i < HIST_BUCKETS; i++)
+		if (h->cnt[i] != 0)
+			printf (" 2^%d:%lld", i, h->cnt[i]);
+	printf ("\n");
+}
+
+/* Inserts thread T into TOP, a table of TOP_IO_CNT accounts
+   sorted by total bytes moved, if T has moved enough to place. */
+static void
+top_io_add (struct io_account top[], const struct thread *t) {
+	uint64_t total = t->io_read_bytes + t->io_write_bytes;
+	int i;
+
+	for (i = 0; i < TOP_IO_CNT; i++)
+		if (total > top[i].st.read_bytes + top[i].st.write_bytes)
+			break;
+	if (i == TOP_IO_CNT)
+		return;
+
+	memmove (&top[i + 1], &top[i], (TOP_IO_CNT - i - 1) * sizeof *top);
+	strlcpy (top[i].name, t->name, sizeof top[i].name);
+	top[i].tid = t->tid;
+	top[i].st.read_bytes = t->io_read_bytes;
+	top[i].st.write_bytes = t->io_write_bytes;
+	top[i].st.wait_ticks = t->io_wait_ticks;
+}
+
 /* Disk detection and identification. */
 
-static void print_ata_string (char *string, size_t size);
+static void print_ata_string (const char *string, size_t size);
 
 /* Resets an ATA channel and waits for any devices present on it
    to finish the reset. */
@@ -339,6 +765,41 @@ check_device_type (struct disk *d) {
 	}
 }
 
+/* Looks for disks on an AHCI controller and assigns each one to
+   a vacant position in ahci_slots[]. */
+static void
+attach_ahci_disks (void) {
+	struct disk **vacant[CHANNEL_CNT * 2];
+	size_t vacant_cnt = 0;
+	size_t port_cnt, i;
+	int chan_no, dev_no;
+
+	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+		for (dev_no = 0; dev_no < 2; dev_no++)
+			if (!channels[chan_no].devices[dev_no].is_ata)
+				vacant[vacant_cnt++] = &ahci_slots[chan_no][dev_no];
+
+	port_cnt = ahci_init ();
+	for (i = 0; i < port_cnt && i < AHCI_DISK_CNT; i++) {
+		struct disk *d = &ahci_disks[i];
+		int port_no;
+
+		d->ahci = ahci_get_port (i);
+		port_no = ahci_port_no (d->ahci);
+		snprintf (d->name, sizeof d->name, "%s", ahci_port_name (d->ahci));
+		d->channel = NULL;
+		d->is_ata = true;
+		d->read_cnt = d->write_cnt = 0;
+		describe_disk (d, ahci_identify_data (d->ahci));
+		disk_set_write_cache (d, true);
+		if ((size_t) port_no < vacant_cnt)
+			*vacant[port_no] = d;
+		else
+			printf ("%s: no free position for port %d, not used\n",
+					d->name, port_no);
+	}
+}
+
 /* Sends an IDENTIFY DEVICE command to disk D and reads the
    response.  Initializes D's capacity member based on the result
    and prints a message describing the disk to the console. */
@@ -360,9 +821,35 @@ identify_ata_device (struct disk *d) {
 		return;
 	}
 	input_sector (c, id);
+	describe_disk (d, id);
+	disk_set_write_cache (d, true);
+}
+
+/* Initializes D's capacity member from the IDENTIFY DEVICE data
+   in ID and prints a message describing the disk to the
+   console. */
+static void
+describe_disk (struct disk *d, const uint16_t *id) {
+	/* Calculate capacity.  A disk that supports 48-bit addressing
+	   (word 83, bit 10) reports its full size in words 100-103;
+	   words 60-61 stop at 2**28 sectors. */
+	d->lba48 = (id[83] & (1 << 10)) != 0;
+	if (d->lba48) {
+		uint64_t capacity = id[100] | ((uint64_t) id[101] << 16)
+			| ((uint64_t) id[102] << 32) | ((uint64_t) id[103] << 48);
+
+		/* disk_sector_t is 32 bits wide, which is 2 TB of sectors. */
+		if (capacity > UINT32_MAX) {
+			printf ("%s: using %'"PRDSNu" of %'"PRIu64" sectors\n",
+					d->name, (disk_sector_t) UINT32_MAX, capacity);
+			capacity = UINT32_MAX;
+		}
+		d->capacity = capacity;
+	} else
+		d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
-	/* Calculate capacity. */
-	d->capacity = id[60] | ((uint32_t) id[61] << 16);
+	/* Word 82, bit 5: volatile write cache supported. */
+	d->has_cache = (id[82] & (1 << 5)) != 0;
 
 	/* Print identification message. */
 	printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
@@ -376,9 +863,9 @@ identify_ata_device (struct disk *d) {
 	else
 		printf ("%"PRDSNu" byte", d->capacity * DISK_SECTOR_SIZE);
 	printf (") disk, model \"");
-	print_ata_string ((char *) &id[27], 40);
+	print_ata_string ((const char *) &id[27], 40);
 	printf ("\", serial \"");
-	print_ata_string ((char *) &id[10], 20);
+	print_ata_string ((const char *) &id[10], 20);
 	printf ("\"\n");
 }
 
@@ -386,7 +873,7 @@ identify_ata_device (struct disk *d) {
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
 static void
-print_ata_string (char *string, size_t size) {
+print_ata_string (const char *string, size_t size) {
 	size_t i;
 
 	/* Find the last non-white, non-null character. */
@@ -402,22 +889,40 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and SEC_CNT to the disk's sector selection and
+   count registers.  (We use LBA mode.)  With LBA48, each of these
+   registers is a two-byte FIFO that takes the high-order byte
+   first. */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sectors (struct disk *d, disk_sector_t sec_no, size_t sec_cnt) {
 	struct channel *c = d->channel;
+	uint64_t lba = sec_no;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (sec_cnt > 0 && sec_cnt <= max_transfer (d));
+	ASSERT (sec_no < d->capacity && sec_cnt <= d->capacity - sec_no);
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
-	outb (reg_lbal (c), sec_no);
-	outb (reg_lbam (c), sec_no >> 8);
-	outb (reg_lbah (c), (sec_no >> 16));
-	outb (reg_device (c),
-			DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
+	if (d->lba48) {
+		outb (reg_nsect (c), sec_cnt >> 8);
+		outb (reg_lbal (c), lba >> 24);
+		outb (reg_lbam (c), lba >> 32);
+		outb (reg_lbah (c), lba >> 40);
+		outb (reg_nsect (c), sec_cnt);
+		outb (reg_lbal (c), lba);
+		outb (reg_lbam (c), lba >> 8);
+		outb (reg_lbah (c), lba >> 16);
+		outb (reg_device (c),
+				DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0));
+	} else {
+		ASSERT (lba + sec_cnt <= (1UL << 28));
+
+		outb (reg_nsect (c), sec_cnt);
+		outb (reg_lbal (c), lba);
+		outb (reg_lbam (c), lba >> 8);
+		outb (reg_lbah (c), lba >> 16);
+		outb (reg_device (c), DEV_MBS | DEV_LBA
+				| (d->dev_no == 1 ? DEV_DEV : 0) | (lba >> 24));
+	}
 }
 
 /* Writes COMMAND to channel C and prepares for receiving a
@@ -6,10 +6,14 @@
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Woken when a key arrives. */
+static struct wait_queue readers;
+
 /* Initializes the input buffer. */
 void
 input_init (void) {
 	intq_init (&buffer);
+	wait_queue_init (&readers);
 }
 
 /* Adds a key to the input buffer.
@@ -21,6 +25,7 @@ input_putc (uint8_t key) {
 
 	intq_putc (&buffer, key);
 	serial_notify ();
+	wait_queue_wake (&readers);
 }
 
 /* Retrieves a key from the input buffer.
@@ -46,3 +51,19 @@ input_full (void) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	return intq_full (&buffer);
 }
+
+/* Returns true if a key is waiting in the input buffer.  If W is
+   nonnull, also puts it on the wait queue woken whenever a key
+   arrives. */
+bool
+input_poll (struct waiter *w) {
+	enum intr_level old_level;
+	bool ready;
+
+	old_level = intr_disable ();
+	if (w != NULL)
+		waiter_add (w, &readers);
+	ready = !intq_empty (&buffer);
+	intr_set_level (old_level);
+	return ready;
+}
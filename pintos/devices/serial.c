@@ -1,7 +1,7 @@
 #include "devices/serial.h"
 #include <debug.h>
+#include <string.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -37,6 +37,18 @@
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
 
+/* Interrupt Identification Register bits. */
+#define IIR_FIFO 0xc0           /* Both set if the FIFOs are enabled. */
+
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable transmit and receive FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Clear receive FIFO. */
+#define FCR_CLEAR_TX 0x04       /* Clear transmit FIFO. */
+#define FCR_TRIG_1 0x00         /* Receive interrupt after 1 byte. */
+
+/* Depth of the 16550A transmit FIFO. */
+#define FIFO_SIZE 16
+
 /* Line Control Register bits. */
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
@@ -51,11 +63,25 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Number of bytes the UART accepts each time THR empties:
+   FIFO_SIZE if the FIFO works, otherwise 1. */
+static int xmit_burst;
+
+/* Data to be transmitted, as a ring buffer.  TXQ_HEAD and
+   TXQ_TAIL count bytes ever added and removed, respectively, so
+   their difference is the number of bytes queued.  Only accessed
+   with interrupts off. */
+#define TXQ_SIZE 4096           /* Must be a power of 2. */
+static uint8_t txq[TXQ_SIZE];
+static size_t txq_head;
+static size_t txq_tail;
+
+/* Thread waiting for room in TXQ, if any. */
+static struct thread *txq_waiter;
 
 static void set_serial (int bps);
-static void putc_poll (uint8_t);
+static size_t put_poll (const uint8_t *, size_t);
+static void xmit_queued (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -67,10 +93,13 @@ static void
 init_poll (void) {
 	ASSERT (mode == UNINIT);
 	outb (IER_REG, 0);                    /* Turn off all interrupts. */
-	outb (FCR_REG, 0);                    /* Disable FIFO. */
+	outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX
+	      | FCR_TRIG_1);                  /* Enable and reset FIFOs. */
 	set_serial (115200);                  /* 115.2 kbps, N-8-1. */
 	outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-	intq_init (&txq);
+
+	/* An 8250 or 16450 has no FIFO and ignores FCR. */
+	xmit_burst = (inb (IIR_REG) & IIR_FIFO) == IIR_FIFO ? FIFO_SIZE : 1;
 	mode = POLL;
 }
 
@@ -95,27 +124,67 @@ serial_init_queue (void) {
 /* Sends BYTE to the serial port. */
 void
 serial_putc (uint8_t byte) {
+	serial_putbuf (&byte, 1);
+}
+
+/* Sends the SIZE bytes in BUFFER to the serial port. */
+void
+serial_putbuf (const void *buffer, size_t size) {
+	const uint8_t *buf = buffer;
 	enum intr_level old_level = intr_disable ();
 
 	if (mode != QUEUE) {
 		/* If we're not set up for interrupt-driven I/O yet,
-		   use dumb polling to transmit a byte. */
+		   use dumb polling to transmit, a FIFO-full at a time. */
 		if (mode == UNINIT)
 			init_poll ();
-		putc_poll (byte);
+		while (size > 0) {
+			size_t n = put_poll (buf, size);
+			buf += n;
+			size -= n;
+		}
 	} else {
-		/* Otherwise, queue a byte and update the interrupt enable
-		   register. */
-		if (old_level == INTR_OFF && intq_full (&txq)) {
-			/* Interrupts are off and the transmit queue is full.
-			   If we wanted to wait for the queue to empty,
-			   we'd have to reenable interrupts.
-			   That's impolite, so we'll send a character via
-			   polling instead. */
-			putc_poll (intq_getc (&txq));
+		/* Otherwise, copy as much as fits into the queue, and
+		   repeat until everything is queued. */
+		while (size > 0) {
+			size_t room = TXQ_SIZE - (txq_head - txq_tail);
+			size_t ofs = txq_head % TXQ_SIZE;
+			size_t n = size < room ? size : room;
+
+			if (n == 0) {
+				if (old_level == INTR_OFF) {
+					/* Interrupts are off and the transmit queue is
+					   full.  If we wanted to wait for the queue to
+					   empty, we'd have to reenable interrupts.
+					   That's impolite, so we'll make room by
+					   polling instead. */
+					while ((inb (LSR_REG) & LSR_THRE) == 0)
+						continue;
+					xmit_queued ();
+				} else {
+					/* Wait for the interrupt handler to drain some
+					   of the queue. */
+					ASSERT (!intr_context ());
+					ASSERT (txq_waiter == NULL);
+					write_ier ();
+					txq_waiter = thread_current ();
+					thread_block ();
+				}
+				continue;
+			}
+
+			if (n > TXQ_SIZE - ofs)
+				n = TXQ_SIZE - ofs;
+			memcpy (txq + ofs, buf, n);
+			txq_head += n;
+			buf += n;
+			size -= n;
 		}
 
-		intq_putc (&txq, byte);
+		/* Start transmitting right away if the UART is idle, rather
+		   than waiting for the transmit interrupt. */
+		if ((inb (LSR_REG) & LSR_THRE) != 0)
+			xmit_queued ();
 		write_ier ();
 	}
 
@@ -127,8 +196,11 @@ serial_putc (uint8_t byte) {
 void
 serial_flush (void) {
 	enum intr_level old_level = intr_disable ();
-	while (!intq_empty (&txq))
-		putc_poll (intq_getc (&txq));
+	while (txq_head != txq_tail) {
+		while ((inb (LSR_REG) & LSR_THRE) == 0)
+			continue;
+		xmit_queued ();
+	}
 	intr_set_level (old_level);
 }
 
@@ -171,7 +243,7 @@ write_ier (void) {
 
 	/* Enable transmit interrupt if we have any characters to
 	   transmit. */
-	if (!intq_empty (&txq))
+	if (txq_head != txq_tail)
 		ier |= IER_XMIT;
 
 	/* Enable receive interrupt if we have room to store any
@@ -182,15 +254,38 @@ write_ier (void) {
 	outb (IER_REG, ier);
 }
 
-/* Polls the serial port until it's ready,
-   and then transmits BYTE. */
-static void
-putc_poll (uint8_t byte) {
+/* Polls the serial port until it's ready, and then transmits
+   as many of the SIZE bytes in BUF as its FIFO will take.
+   Returns the number of bytes transmitted. */
+static size_t
+put_poll (const uint8_t *buf, size_t size) {
+	size_t i;
+
 	ASSERT (intr_get_level () == INTR_OFF);
 
 	while ((inb (LSR_REG) & LSR_THRE) == 0)
 		continue;
-	outb (THR_REG, byte);
+	for (i = 0; i < size && i < (size_t) xmit_burst; i++)
+		outb (THR_REG, buf[i]);
+	return i;
+}
+
+/* Moves up to a FIFO-full of bytes from the transmit queue to
+   the UART, which must be ready to accept them, and wakes up any
+   thread waiting for room in the queue. */
+static void
+xmit_queued (void) {
+	int i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (i = 0; i < xmit_burst && txq_head != txq_tail; i++)
+		outb (THR_REG, txq[txq_tail++ % TXQ_SIZE]);
+
+	if (i > 0 && txq_waiter != NULL) {
+		thread_unblock (txq_waiter);
+		txq_waiter = NULL;
+	}
 }
 
 /* Serial interrupt handler. */
@@ -205,10 +300,11 @@ serial_interrupt (struct intr_frame *f UNUSED) {
 	while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
 		input_putc (inb (RBR_REG));
 
-	/* As long as we have a byte to transmit, and the hardware is
-	   ready to accept a byte for transmission, transmit a byte. */
-	while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0)
-		outb (THR_REG, intq_getc (&txq));
+	/* If the transmitter has emptied, refill its FIFO from the
+	   queue.  THRE means the whole FIFO is empty, so it can take
+	   a full burst. */
+	if ((inb (LSR_REG) & LSR_THRE) != 0)
+		xmit_queued ();
 
 	/* Update interrupt enable register based on queue status. */
 	write_ier ();
@@ -7,6 +7,9 @@
 #include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#ifdef USERPROG
+#include "userprog/vdso.h"
+#endif
 
 #if TIMER_FREQ < 19
 #error 8254 timer requires TIMER_FREQ >= 19
@@ -21,10 +24,14 @@ static int64_t ticks;
 /* 한 타이머 틱 당 반복 루프 횟수 (timer_calibrate()에서 초기화됨) */
 static unsigned loops_per_tick;
 
+/* 울릴 시각 순으로 정렬된 알람 리스트 */
+static struct list alarm_list;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void alarm_fire (int64_t now);
 
 /* 8254 프로그래머블 인터벌 타이머(PIT)를 설정하여
    1초에 PIT_FREQ번 인터럽트를 발생시키고,
@@ -37,6 +44,7 @@ timer_init (void) {
 	outb (0x40, count & 0xff);
 	outb (0x40, count >> 8);
 
+	list_init (&alarm_list);
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -100,6 +108,42 @@ timer_sleep (int64_t ticks) {
 	thread_sleep(wake);									// wake_tick 값을 기록
 }
 
+/* 알람 정렬 기준: 먼저 울릴 알람이 앞에 온다. */
+static bool
+alarm_less (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return list_entry (a, struct timer_alarm, elem)->tick
+		< list_entry (b, struct timer_alarm, elem)->tick;
+}
+
+/* ALARM을 TICK에 울리도록 건다. 울리면 SEMA를 up한다.
+   이미 지난 TICK이면 다음 타이머 인터럽트에서 울린다.
+   알람은 울리거나 timer_alarm_cancel()로 취소되기 전까지
+   유효한 메모리에 있어야 한다. */
+void
+timer_alarm_set (struct timer_alarm *alarm, int64_t tick,
+		struct semaphore *sema) {
+	enum intr_level old_level;
+
+	alarm->tick = tick;
+	alarm->sema = sema;
+	old_level = intr_disable ();
+	alarm->armed = true;
+	list_insert_ordered (&alarm_list, &alarm->elem, alarm_less, NULL);
+	intr_set_level (old_level);
+}
+
+/* ALARM이 아직 울리지 않았으면 취소한다. */
+void
+timer_alarm_cancel (struct timer_alarm *alarm) {
+	enum intr_level old_level = intr_disable ();
+	if (alarm->armed) {
+		list_remove (&alarm->elem);
+		alarm->armed = false;
+	}
+	intr_set_level (old_level);
+}
+
 /* 대략 ms 밀리초 동안 실행을 중단한다. */
 void
 timer_msleep (int64_t ms) {
@@ -126,10 +170,29 @@ timer_print_stats (void) {
 
 /* 타이머 인터럽트 핸들러 */
 static void
-timer_interrupt (struct intr_frame *args UNUSED) {
+timer_interrupt (struct intr_frame *args) {
 	ticks++;
-	thread_tick ();
+#ifdef USERPROG
+	vdso_tick (ticks);      /* 사용자 프로그램에 새 틱 수를 알림 */
+#endif
+	thread_tick ((args->cs & 3) == 3);  /* 사용자 모드에서 걸렸는가 */
 	thread_awake(ticks);
+	alarm_fire (ticks);
+}
+
+/* NOW까지 울릴 시각이 된 알람을 모두 울린다. 인터럽트 컨텍스트에서 호출된다. */
+static void
+alarm_fire (int64_t now) {
+	while (!list_empty (&alarm_list)) {
+		struct timer_alarm *alarm =
+			list_entry (list_front (&alarm_list), struct timer_alarm, elem);
+
+		if (alarm->tick > now)
+			break;
+		list_pop_front (&alarm_list);
+		alarm->armed = false;
+		sema_up (alarm->sema);
+	}
 }
 
 /* LOOPS 반복이 한 틱 이상 걸리면 true를 반환한다. */
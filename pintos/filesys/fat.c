@@ -57,12 +57,17 @@ fat_open (void) {
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT load failed");
 
-	// Load FAT directly from the disk
+	// Load FAT directly from the disk, all whole sectors at once
 	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_read = 0;
 	off_t bytes_left = sizeof (fat_fs->fat);
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
+	unsigned whole = fat_size_in_bytes / DISK_SECTOR_SIZE;
+	if (whole > fat_fs->bs.fat_sectors)
+		whole = fat_fs->bs.fat_sectors;
+	if (whole > 0)
+		disk_read_multiple (filesys_disk, fat_fs->bs.fat_start, whole, buffer);
+	off_t bytes_read = whole * DISK_SECTOR_SIZE;
+	for (unsigned i = whole; i < fat_fs->bs.fat_sectors; i++) {
 		bytes_left = fat_size_in_bytes - bytes_read;
 		if (bytes_left >= DISK_SECTOR_SIZE) {
 			disk_read (filesys_disk, fat_fs->bs.fat_start + i,
@@ -90,12 +95,17 @@ fat_close (void) {
 	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
 	free (bounce);
 
-	// Write FAT directly to the disk
+	// Write FAT directly to the disk, all whole sectors at once
 	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
 	off_t bytes_left = sizeof (fat_fs->fat);
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
+	unsigned whole = fat_size_in_bytes / DISK_SECTOR_SIZE;
+	if (whole > fat_fs->bs.fat_sectors)
+		whole = fat_fs->bs.fat_sectors;
+	if (whole > 0)
+		disk_write_multiple (filesys_disk, fat_fs->bs.fat_start, whole, buffer);
+	off_t bytes_wrote = whole * DISK_SECTOR_SIZE;
+	for (unsigned i = whole; i < fat_fs->bs.fat_sectors; i++) {
 		bytes_left = fat_size_in_bytes - bytes_wrote;
 		if (bytes_left >= DISK_SECTOR_SIZE) {
 			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
@@ -1,13 +1,23 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include <poll.h>
 #include "filesys/inode.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 
-/* An open file. */
+/* An open file, or something else opened like one, such as an end
+ * of a pipe or a shared memory object, whose owner supplies its
+ * operations (see struct file_ops).  Only a file has an inode.
+ * Several file descriptors may refer to one struct file, each
+ * holding a reference, and the last file_close() closes it. */
 struct file {
-	struct inode *inode;        /* File's inode. */
+	struct inode *inode;        /* File's inode, or null. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	const struct file_ops *ops; /* Operations if not a file, or null. */
+	void *obj;                  /* What OPS operate on. */
+	int ref_cnt;                /* Number of references. */
+	int hold_cnt;               /* Of those, held by file_hold(). */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -20,6 +30,7 @@ file_open (struct inode *inode) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		file->ref_cnt = 1;
 		return file;
 	} else {
 		inode_close (inode);
@@ -28,10 +39,75 @@ file_open (struct inode *inode) {
 	}
 }
 
-/* Opens and returns a new file for the same inode as FILE.
- * Returns a null pointer if unsuccessful. */
+/* Opens OBJ, on which OPS operate, taking over the caller's
+ * reference to it, and returns the new file.  Returns a null
+ * pointer, and releases OBJ, if an allocation fails. */
+struct file *
+file_open_ops (const struct file_ops *ops, void *obj) {
+	struct file *file = calloc (1, sizeof *file);
+	if (file != NULL) {
+		file->ops = ops;
+		file->obj = obj;
+		file->ref_cnt = 1;
+	} else
+		ops->release (obj);
+	return file;
+}
+
+/* Adds a reference to FILE and returns FILE. */
+struct file *
+file_ref (struct file *file) {
+	enum intr_level old_level = intr_disable ();
+	file->ref_cnt++;
+	intr_set_level (old_level);
+	return file;
+}
+
+/* Adds a reference to FILE for the length of one operation on it
+ * and returns FILE.  Unlike those of file_ref(), such a reference
+ * does not make FILE shared.  It is dropped with file_unhold(). */
+struct file *
+file_hold (struct file *file) {
+	enum intr_level old_level = intr_disable ();
+	file->ref_cnt++;
+	file->hold_cnt++;
+	intr_set_level (old_level);
+	return file;
+}
+
+/* Drops a reference taken by file_hold(), closing FILE if that
+ * was the last. */
+void
+file_unhold (struct file *file) {
+	enum intr_level old_level = intr_disable ();
+	file->hold_cnt--;
+	intr_set_level (old_level);
+	file_close (file);
+}
+
+/* Returns true if FILE has a position and more than one reference
+ * apart from those of file_hold(), so that moving the position
+ * through one reference would move it for the others too. */
+bool
+file_is_shared (const struct file *file) {
+	return file->inode != NULL && file->ref_cnt - file->hold_cnt > 1;
+}
+
+/* Returns the object that FILE stands for, if OPS operate on it,
+ * or a null pointer otherwise. */
+void *
+file_get_obj (struct file *file, const struct file_ops *ops) {
+	return file->ops == ops ? file->obj : NULL;
+}
+
+/* Opens and returns a new file for the same inode as FILE, or the
+ * same object.  Returns a null pointer if unsuccessful. */
 struct file *
 file_reopen (struct file *file) {
+	if (file->ops != NULL) {
+		file->ops->ref (file->obj);
+		return file_open_ops (file->ops, file->obj);
+	}
 	return file_open (inode_reopen (file->inode));
 }
 
@@ -39,7 +115,11 @@ file_reopen (struct file *file) {
  * same inode as FILE. Returns a null pointer if unsuccessful. */
 struct file *
 file_duplicate (struct file *file) {
-	struct file *nfile = file_open (inode_reopen (file->inode));
+	struct file *nfile;
+
+	if (file->ops != NULL)
+		return file_reopen (file);
+	nfile = file_open (inode_reopen (file->inode));
 	if (nfile) {
 		nfile->pos = file->pos;
 		if (file->deny_write)
@@ -48,17 +128,31 @@ file_duplicate (struct file *file) {
 	return nfile;
 }
 
-/* Closes FILE. */
+/* Drops a reference to FILE, closing it if that was the last. */
 void
 file_close (struct file *file) {
-	if (file != NULL) {
+	enum intr_level old_level;
+	bool last;
+
+	if (file == NULL)
+		return;
+	old_level = intr_disable ();
+	last = --file->ref_cnt == 0;
+	intr_set_level (old_level);
+	if (!last)
+		return;
+
+	if (file->ops != NULL)
+		file->ops->release (file->obj);
+	else {
 		file_allow_write (file);
 		inode_close (file->inode);
-		free (file);
 	}
+	free (file);
 }
 
-/* Returns the inode encapsulated by FILE. */
+/* Returns the inode encapsulated by FILE, or a null pointer if
+ * FILE is not a file. */
 struct inode *
 file_get_inode (struct file *file) {
 	return file->inode;
@@ -68,9 +162,15 @@ file_get_inode (struct file *file) {
  * starting at the file's current position.
  * Returns the number of bytes actually read,
  * which may be less than SIZE if end of file is reached.
- * Advances FILE's position by the number of bytes read. */
+ * Advances FILE's position by the number of bytes read.
+ * From anything but a file, reads through its READ operation,
+ * which for a pipe waits for at least one byte, or reads
+ * nothing if it has none. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
+	if (file->ops != NULL)
+		return file->ops->read != NULL
+			? file->ops->read (file->obj, buffer, size) : 0;
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
 	file->pos += bytes_read;
 	return bytes_read;
@@ -80,9 +180,13 @@ file_read (struct file *file, void *buffer, off_t size) {
  * starting at offset FILE_OFS in the file.
  * Returns the number of bytes actually read,
  * which may be less than SIZE if end of file is reached.
- * The file's current position is unaffected. */
+ * The file's current position is unaffected.
+ * Only files have positions, so nothing is read from anything
+ * else. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
+	if (file->inode == NULL)
+		return 0;
 	return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
@@ -92,9 +196,15 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
  * which may be less than SIZE if end of file is reached.
  * (Normally we'd grow the file in that case, but file growth is
  * not yet implemented.)
- * Advances FILE's position by the number of bytes read. */
+ * Advances FILE's position by the number of bytes read.
+ * To anything but a file, writes through its WRITE operation,
+ * which for a pipe waits for room as needed, or writes nothing if
+ * it has none. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) {
+	if (file->ops != NULL)
+		return file->ops->write != NULL
+			? file->ops->write (file->obj, buffer, size) : 0;
 	off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
 	file->pos += bytes_written;
 	return bytes_written;
@@ -106,19 +216,44 @@ file_write (struct file *file, const void *buffer, off_t size) {
  * which may be less than SIZE if end of file is reached.
  * (Normally we'd grow the file in that case, but file growth is
  * not yet implemented.)
- * The file's current position is unaffected. */
+ * The file's current position is unaffected.
+ * Only files have positions, so nothing is written to anything
+ * else. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
 		off_t file_ofs) {
+	if (file->inode == NULL)
+		return 0;
 	return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Returns the POLL* events ready on FILE.  If W is nonnull and FILE
+ * has a POLL operation, such as a pipe's, that also puts W on the
+ * wait queue woken whenever that may change.  Anything else, files
+ * among them, never makes anyone wait, so it is always ready and
+ * has no wait queue. */
+int
+file_poll (struct file *file, struct waiter *w) {
+	ASSERT (file != NULL);
+	if (file->ops != NULL && file->ops->poll != NULL)
+		return file->ops->poll (file->obj, w);
+	return POLLIN | POLLOUT;
+}
+
+/* Waits until everything written to FILE is on stable storage. */
+void
+file_sync (struct file *file) {
+	ASSERT (file != NULL);
+	if (file->inode != NULL)
+		inode_sync (file->inode);
+}
+
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
 void
 file_deny_write (struct file *file) {
 	ASSERT (file != NULL);
-	if (!file->deny_write) {
+	if (!file->deny_write && file->inode != NULL) {
 		file->deny_write = true;
 		inode_deny_write (file->inode);
 	}
@@ -136,10 +271,13 @@ file_allow_write (struct file *file) {
 	}
 }
 
-/* Returns the size of FILE in bytes. */
+/* Returns the size of FILE in bytes, or of the object it stands
+ * for as given by its LENGTH operation, or 0 if it has none. */
 off_t
 file_length (struct file *file) {
 	ASSERT (file != NULL);
+	if (file->ops != NULL)
+		return file->ops->length != NULL ? file->ops->length (file->obj) : 0;
 	return inode_length (file->inode);
 }
 
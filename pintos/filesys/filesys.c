@@ -51,6 +51,7 @@ filesys_done (void) {
 #else
 	free_map_close ();
 #endif
+	disk_flush (filesys_disk);
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
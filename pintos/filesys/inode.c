@@ -33,6 +33,7 @@ struct inode {
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	unsigned write_cnt;                 /* Number of writes that changed data. */
 	struct inode_disk data;             /* Inode content. */
 };
 
@@ -49,6 +50,29 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 		return -1;
 }
 
+/* Returns the number of whole sectors, up to SIZE bytes' worth,
+ * that INODE stores contiguously on disk starting at byte offset
+ * POS, which must be sector-aligned.  These can be moved with a
+ * single disk_read_multiple() or disk_write_multiple(). */
+static size_t
+contiguous_sectors (const struct inode *inode, off_t pos, off_t size) {
+	disk_sector_t first = byte_to_sector (inode, pos);
+	off_t left = inode_length (inode) - pos;
+	size_t cnt = 0;
+
+	ASSERT (pos % DISK_SECTOR_SIZE == 0);
+
+	if (size > left)
+		size = left;
+	while (size >= DISK_SECTOR_SIZE
+			&& byte_to_sector (inode, pos) == first + cnt) {
+		cnt++;
+		pos += DISK_SECTOR_SIZE;
+		size -= DISK_SECTOR_SIZE;
+	}
+	return cnt;
+}
+
 /* List of open inodes, so that opening a single inode twice
  * returns the same `struct inode'. */
 static struct list open_inodes;
@@ -124,6 +148,7 @@ inode_open (disk_sector_t sector) {
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
+	inode->write_cnt = 0;
 	inode->removed = false;
 	disk_read (filesys_disk, inode->sector, &inode->data);
 	return inode;
@@ -176,6 +201,20 @@ inode_remove (struct inode *inode) {
 	inode->removed = true;
 }
 
+/* Returns true if INODE has been removed. */
+bool
+inode_is_removed (const struct inode *inode) {
+	return inode->removed;
+}
+
+/* Returns the number of writes to INODE that changed its data
+ * since it was opened.  Comparing two values tells whether INODE
+ * changed in between, as long as it stayed open. */
+unsigned
+inode_write_cnt (const struct inode *inode) {
+	return inode->write_cnt;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
  * Returns the number of bytes actually read, which may be less
  * than SIZE if an error occurs or end of file is reached. */
@@ -201,8 +240,12 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 			break;
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
+			/* Read as many full sectors as are contiguous on disk
+			 * directly into caller's buffer. */
+			size_t sec_cnt = contiguous_sectors (inode, offset, size);
+			disk_read_multiple (filesys_disk, sector_idx, sec_cnt,
+					buffer + bytes_read);
+			chunk_size = sec_cnt * DISK_SECTOR_SIZE;
 		} else {
 			/* Read sector into bounce buffer, then partially copy
 			 * into caller's buffer. */
@@ -256,8 +299,12 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 			break;
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
+			/* Write as many full sectors as are contiguous on disk
+			 * directly from caller's buffer. */
+			size_t sec_cnt = contiguous_sectors (inode, offset, size);
+			disk_write_multiple (filesys_disk, sector_idx, sec_cnt,
+					buffer + bytes_written);
+			chunk_size = sec_cnt * DISK_SECTOR_SIZE;
 		} else {
 			/* We need a bounce buffer. */
 			if (bounce == NULL) {
@@ -284,6 +331,8 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	}
 	free (bounce);
 
+	if (bytes_written > 0)
+		inode->write_cnt++;
 	return bytes_written;
 }
 
@@ -306,6 +355,15 @@ inode_allow_write (struct inode *inode) {
 	inode->deny_write_cnt--;
 }
 
+/* Makes every write to INODE so far durable.  Inode data goes
+ * straight to the disk, so all that is left is to flush the
+ * drive's write cache, which also covers the inode's metadata. */
+void
+inode_sync (struct inode *inode) {
+	ASSERT (inode != NULL);
+	disk_flush (filesys_disk);
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode) {
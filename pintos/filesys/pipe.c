@@ -0,0 +1,276 @@
+#include "filesys/pipe.h"
+#include <debug.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Pipes.
+
+   A pipe is a ring buffer in kernel memory with a read end and a
+   write end, each of which is a struct file (see file_open_ops())
+   that can be duplicated, by fork() among others, like any other.
+   Readers wait while the buffer is empty and writers while it is
+   full.  Data is moved in as large pieces as the buffer allows, so
+   that a big write wakes its reader once per buffer's worth rather
+   than once per byte.
+
+   A pipe has its own lock, and blocks, so the file system lock
+   must not be held while reading or writing one.
+
+   Besides its own readers and writers, a pipe wakes the threads
+   polling it (see pipe_poll()) whenever either end may have become
+   ready. */
+
+/* Size of a pipe's buffer. */
+#define PIPE_PAGES 4
+#define PIPE_SIZE (PIPE_PAGES * PGSIZE)
+
+struct pipe {
+	uint8_t *buf;               /* Ring buffer of PIPE_SIZE bytes. */
+	size_t head;                /* Total bytes ever read. */
+	size_t tail;                /* Total bytes ever written. */
+	int readers;                /* Open read ends. */
+	int writers;                /* Open write ends. */
+	struct lock lock;           /* Protects the members above. */
+	struct condition not_empty; /* Data arrived or writers gone. */
+	struct condition not_full;  /* Room freed or readers gone. */
+	struct wait_queue pollers;  /* Woken along with either of those. */
+};
+
+/* File operations for the ends of a pipe. */
+
+static void
+reader_ref (void *p) {
+	pipe_open (p, false);
+}
+
+static void
+reader_release (void *p) {
+	pipe_close (p, false);
+}
+
+static off_t
+reader_read (void *p, void *buffer, off_t size) {
+	return pipe_read (p, buffer, size);
+}
+
+static int
+reader_poll (void *p, struct waiter *w) {
+	return pipe_poll (p, false, w);
+}
+
+static void
+writer_ref (void *p) {
+	pipe_open (p, true);
+}
+
+static void
+writer_release (void *p) {
+	pipe_close (p, true);
+}
+
+static off_t
+writer_write (void *p, const void *buffer, off_t size) {
+	return pipe_write (p, buffer, size);
+}
+
+static int
+writer_poll (void *p, struct waiter *w) {
+	return pipe_poll (p, true, w);
+}
+
+static const struct file_ops reader_ops = {
+	.ref = reader_ref,
+	.release = reader_release,
+	.read = reader_read,
+	.poll = reader_poll,
+};
+
+static const struct file_ops writer_ops = {
+	.ref = writer_ref,
+	.release = writer_release,
+	.write = writer_write,
+	.poll = writer_poll,
+};
+
+/* Creates a pipe and opens its two ends.  Returns false if memory
+ * is exhausted. */
+bool
+pipe_create (struct file **read_end, struct file **write_end) {
+	struct pipe *p = malloc (sizeof *p);
+
+	*read_end = *write_end = NULL;
+	if (p == NULL)
+		return false;
+	p->buf = palloc_get_multiple (0, PIPE_PAGES);
+	if (p->buf == NULL) {
+		free (p);
+		return false;
+	}
+	p->head = p->tail = 0;
+	p->readers = p->writers = 1;
+	lock_init (&p->lock);
+	cond_init (&p->not_empty);
+	cond_init (&p->not_full);
+	wait_queue_init (&p->pollers);
+
+	/* Each end takes over one of the references counted above, and
+	 * closes it if it cannot be opened.  Closing the last frees the
+	 * pipe. */
+	*read_end = file_open_ops (&reader_ops, p);
+	*write_end = file_open_ops (&writer_ops, p);
+	if (*read_end != NULL && *write_end != NULL)
+		return true;
+
+	file_close (*read_end);
+	file_close (*write_end);
+	*read_end = *write_end = NULL;
+	return false;
+}
+
+/* Returns true if FILE is an end of a pipe. */
+bool
+pipe_is_end (struct file *file) {
+	return (file_get_obj (file, &reader_ops) != NULL
+			|| file_get_obj (file, &writer_ops) != NULL);
+}
+
+/* Adds an open end to pipe P: a write end if WRITER is true, or a
+ * read end otherwise. */
+void
+pipe_open (struct pipe *p, bool writer) {
+	lock_acquire (&p->lock);
+	if (writer)
+		p->writers++;
+	else
+		p->readers++;
+	lock_release (&p->lock);
+}
+
+/* Closes an end of pipe P opened with pipe_open(), and frees P if
+ * it was the last.  Closing the last write end lets readers see
+ * the end of the data; closing the last read end makes writes
+ * fail. */
+void
+pipe_close (struct pipe *p, bool writer) {
+	bool last;
+
+	lock_acquire (&p->lock);
+	if (writer) {
+		ASSERT (p->writers > 0);
+		if (--p->writers == 0) {
+			cond_broadcast (&p->not_empty, &p->lock);
+			wait_queue_wake (&p->pollers);
+		}
+	} else {
+		ASSERT (p->readers > 0);
+		if (--p->readers == 0) {
+			cond_broadcast (&p->not_full, &p->lock);
+			wait_queue_wake (&p->pollers);
+		}
+	}
+	last = p->readers == 0 && p->writers == 0;
+	lock_release (&p->lock);
+
+	if (last) {
+		/* Threads still polling P, through descriptors closed
+		 * under them, must not be left on its wait queue. */
+		wait_queue_destroy (&p->pollers);
+		palloc_free_multiple (p->buf, PIPE_PAGES);
+		free (p);
+	}
+}
+
+/* Reads up to SIZE bytes from pipe P into BUFFER, waiting until
+ * there is at least one to read.  Returns the number of bytes
+ * read, which is 0 only if SIZE is 0 or every write end is closed
+ * and the pipe is empty. */
+off_t
+pipe_read (struct pipe *p, void *buffer_, off_t size) {
+	uint8_t *buffer = buffer_;
+	size_t n, ofs, first;
+
+	if (size <= 0)
+		return 0;
+
+	lock_acquire (&p->lock);
+	while (p->head == p->tail && p->writers > 0)
+		cond_wait (&p->not_empty, &p->lock);
+
+	n = p->tail - p->head;
+	if (n > (size_t) size)
+		n = size;
+	ofs = p->head % PIPE_SIZE;
+	first = n < PIPE_SIZE - ofs ? n : PIPE_SIZE - ofs;
+	memcpy (buffer, p->buf + ofs, first);
+	memcpy (buffer + first, p->buf, n - first);
+	p->head += n;
+	if (n > 0) {
+		cond_broadcast (&p->not_full, &p->lock);
+		wait_queue_wake (&p->pollers);
+	}
+	lock_release (&p->lock);
+	return n;
+}
+
+/* Writes SIZE bytes from BUFFER into pipe P, waiting for room as
+ * needed.  Returns the number of bytes written, which is less than
+ * SIZE only if every read end is closed. */
+off_t
+pipe_write (struct pipe *p, const void *buffer_, off_t size) {
+	const uint8_t *buffer = buffer_;
+	off_t done = 0;
+
+	lock_acquire (&p->lock);
+	while (done < size && p->readers > 0) {
+		size_t n, ofs, first;
+
+		n = PIPE_SIZE - (p->tail - p->head);
+		if (n == 0) {
+			cond_wait (&p->not_full, &p->lock);
+			continue;
+		}
+		if (n > (size_t) (size - done))
+			n = size - done;
+		ofs = p->tail % PIPE_SIZE;
+		first = n < PIPE_SIZE - ofs ? n : PIPE_SIZE - ofs;
+		memcpy (p->buf + ofs, buffer + done, first);
+		memcpy (p->buf, buffer + done + first, n - first);
+		p->tail += n;
+		done += n;
+		cond_broadcast (&p->not_empty, &p->lock);
+		wait_queue_wake (&p->pollers);
+	}
+	lock_release (&p->lock);
+	return done;
+}
+
+/* Returns the POLL* events ready on an end of pipe P: its write end
+ * if WRITER is true, or its read end otherwise.  If W is nonnull,
+ * also puts it on the wait queue woken whenever that may change. */
+int
+pipe_poll (struct pipe *p, bool writer, struct waiter *w) {
+	int events = 0;
+
+	lock_acquire (&p->lock);
+	if (w != NULL)
+		waiter_add (w, &p->pollers);
+	if (writer) {
+		if (p->readers == 0)
+			events |= POLLERR;
+		else if (p->tail - p->head < PIPE_SIZE)
+			events |= POLLOUT;
+	} else {
+		if (p->head != p->tail)
+			events |= POLLIN;
+		if (p->writers == 0)
+			events |= POLLHUP;
+	}
+	lock_release (&p->lock);
+	return events;
+}
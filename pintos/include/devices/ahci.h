@@ -0,0 +1,27 @@
+#ifndef DEVICES_AHCI_H
+#define DEVICES_AHCI_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Maximum number of commands that may be outstanding on one
+   AHCI port at a time.  This is also the NCQ tag space. */
+#define AHCI_SLOT_CNT 32
+
+struct ahci_port;
+
+size_t ahci_init (void);
+struct ahci_port *ahci_get_port (size_t idx);
+const char *ahci_port_name (const struct ahci_port *);
+int ahci_port_no (const struct ahci_port *);
+const uint16_t *ahci_identify_data (const struct ahci_port *);
+int ahci_queue_depth (const struct ahci_port *);
+
+bool ahci_read (struct ahci_port *, uint64_t sec_no, size_t sec_cnt,
+		void *buffer, uint64_t *issued);
+bool ahci_write (struct ahci_port *, uint64_t sec_no, size_t sec_cnt,
+		const void *buffer, uint64_t *issued);
+bool ahci_nondata (struct ahci_port *, uint8_t command, uint8_t feature);
+
+#endif /* devices/ahci.h */
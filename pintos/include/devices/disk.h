@@ -2,7 +2,12 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threads/thread.h"
+
+struct iostat;
 
 /* Size of a disk sector in bytes. */
 #define DISK_SECTOR_SIZE 512
@@ -22,6 +27,14 @@ struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_multiple (struct disk *, disk_sector_t, size_t, void *);
+void disk_write_multiple (struct disk *, disk_sector_t, size_t,
+		const void *);
+void disk_flush (struct disk *);
+bool disk_set_write_cache (struct disk *, bool enable);
+
+void disk_account_exit (const struct thread *);
+bool disk_iostat (tid_t, struct iostat *);
 
 void 	register_disk_inspect_intr ();
 #endif /* devices/disk.h */
@@ -9,4 +9,7 @@ void input_putc (uint8_t);
 uint8_t input_getc (void);
 bool input_full (void);
 
+struct waiter;
+bool input_poll (struct waiter *);
+
 #endif /* devices/input.h */
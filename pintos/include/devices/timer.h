@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -18,6 +20,19 @@ void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+struct semaphore;
+
+/* An alarm, which ups a semaphore once a given tick comes. */
+struct timer_alarm {
+	int64_t tick;               /* When to go off. */
+	struct semaphore *sema;     /* Upped when it goes off. */
+	bool armed;                 /* Not gone off or cancelled yet? */
+	struct list_elem elem;      /* Element in the alarm list. */
+};
+
+void timer_alarm_set (struct timer_alarm *, int64_t tick, struct semaphore *);
+void timer_alarm_cancel (struct timer_alarm *);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
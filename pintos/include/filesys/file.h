@@ -1,22 +1,46 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
 #include "filesys/off_t.h"
 
 struct inode;
+struct waiter;
+
+/* Operations on a file that stands for something other than an
+ * inode, such as an end of a pipe or a shared memory object.  Each
+ * is passed the object the file stands for.  REF and RELEASE are
+ * required; a null READ or WRITE transfers nothing, a null POLL
+ * means always ready, and a null LENGTH means 0. */
+struct file_ops {
+	void (*ref) (void *obj);    /* Adds a reference, for a new file. */
+	void (*release) (void *obj); /* Drops a closed file's reference. */
+	off_t (*read) (void *obj, void *, off_t size);
+	off_t (*write) (void *obj, const void *, off_t size);
+	int (*poll) (void *obj, struct waiter *);
+	off_t (*length) (void *obj);
+};
 
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
+struct file *file_open_ops (const struct file_ops *, void *obj);
 struct file *file_reopen (struct file *);
 struct file *file_duplicate (struct file *file);
+struct file *file_ref (struct file *);
+struct file *file_hold (struct file *);
+void file_unhold (struct file *);
+bool file_is_shared (const struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
+void *file_get_obj (struct file *, const struct file_ops *);
 
 /* Reading and writing. */
 off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+void file_sync (struct file *);
+int file_poll (struct file *, struct waiter *);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
@@ -0,0 +1,19 @@
+#ifndef FILESYS_PIPE_H
+#define FILESYS_PIPE_H
+
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct pipe;
+struct waiter;
+
+bool pipe_create (struct file **read_end, struct file **write_end);
+bool pipe_is_end (struct file *);
+void pipe_open (struct pipe *, bool writer);
+void pipe_close (struct pipe *, bool writer);
+off_t pipe_read (struct pipe *, void *, off_t size);
+off_t pipe_write (struct pipe *, const void *, off_t size);
+int pipe_poll (struct pipe *, bool writer, struct waiter *);
+
+#endif /* filesys/pipe.h */
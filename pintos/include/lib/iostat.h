@@ -0,0 +1,13 @@
+#ifndef __LIB_IOSTAT_H
+#define __LIB_IOSTAT_H
+
+#include <stdint.h>
+
+/* Disk I/O done by one process, as reported by iostat(). */
+struct iostat {
+	uint64_t read_bytes;        /* Bytes read from disk. */
+	uint64_t write_bytes;       /* Bytes written to disk. */
+	int64_t wait_ticks;         /* Timer ticks spent waiting for I/O. */
+};
+
+#endif /* lib/iostat.h */
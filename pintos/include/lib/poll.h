@@ -0,0 +1,34 @@
+#ifndef __LIB_POLL_H
+#define __LIB_POLL_H
+
+#include <stdint.h>
+
+/* Readiness events, for poll() and the epoll calls. */
+#define POLLIN   0x001          /* Can read without waiting. */
+#define POLLOUT  0x004          /* Can write without waiting. */
+#define POLLERR  0x008          /* Writing fails: no readers. */
+#define POLLHUP  0x010          /* No writers: reading hits the end. */
+#define POLLNVAL 0x020          /* Not an open file descriptor. */
+
+/* One file descriptor for poll(). */
+struct pollfd {
+	int fd;                     /* Descriptor, ignored if negative. */
+	short events;               /* Events of interest. */
+	short revents;              /* Events found, plus ERR/HUP/NVAL. */
+};
+
+/* Operations for epoll_ctl(). */
+enum epoll_op {
+	EPOLL_CTL_ADD,              /* Add a descriptor to the set. */
+	EPOLL_CTL_DEL,              /* Remove a descriptor from the set. */
+	EPOLL_CTL_MOD,              /* Change a descriptor's events. */
+};
+
+/* A descriptor's interest in epoll_ctl(), and an event reported
+   by epoll_wait(). */
+struct epoll_event {
+	uint32_t events;            /* POLL* events. */
+	uint64_t data;              /* Passed back as is. */
+};
+
+#endif /* lib/poll.h */
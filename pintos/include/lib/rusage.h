@@ -0,0 +1,24 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stdint.h>
+
+/* Whose resource usage getrusage() reports. */
+#define RUSAGE_SELF 0           /* The calling process. */
+#define RUSAGE_CHILDREN (-1)    /* Its children that it has waited for. */
+
+/* Resources used by a process, as reported by getrusage(). */
+struct rusage {
+	int64_t user_ticks;             /* Timer ticks spent in user mode. */
+	int64_t kernel_ticks;           /* Timer ticks spent in the kernel. */
+	uint64_t voluntary_switches;    /* Gave up the CPU to wait. */
+	uint64_t involuntary_switches;  /* Had the CPU taken away. */
+	uint64_t nonpresent_faults;     /* Page faults on unmapped pages. */
+	uint64_t protection_faults;     /* Page faults on protected pages. */
+	uint64_t max_rss;               /* Most user pages mapped at once. */
+	uint64_t bytes_read;            /* Bytes returned by read(). */
+	uint64_t bytes_written;         /* Bytes accepted by write(). */
+	uint64_t syscalls;              /* System calls made. */
+};
+
+#endif /* lib/rusage.h */
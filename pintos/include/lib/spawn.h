@@ -0,0 +1,26 @@
+#ifndef __LIB_SPAWN_H
+#define __LIB_SPAWN_H
+
+/* File actions for spawn().  They are carried out in order in the
+   new process, on the file descriptors it inherits from its
+   parent, before its program starts running.  FD may be 0 or 1,
+   to give the child a file or pipe in place of the console; a
+   console descriptor cannot be closed, only replaced. */
+enum spawn_op {
+	SPAWN_END,                  /* Ends the array of actions. */
+	SPAWN_OPEN,                 /* Open PATH as FD, closing FD first. */
+	SPAWN_CLOSE,                /* Close FD. */
+	SPAWN_DUP2,                 /* Make FD refer to OLDFD, like dup2(). */
+};
+
+struct spawn_action {
+	int op;                     /* One of SPAWN_*. */
+	int fd;                     /* File descriptor acted on. */
+	const char *path;           /* File to open, for SPAWN_OPEN. */
+	int oldfd;                  /* Descriptor copied, for SPAWN_DUP2. */
+};
+
+/* Maximum number of actions in one spawn(). */
+#define SPAWN_ACTION_MAX 16
+
+#endif /* lib/spawn.h */
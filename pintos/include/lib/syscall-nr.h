@@ -36,6 +36,32 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extensions. */
+	SYS_IOSTAT,                 /* Report a process's disk I/O. */
+	SYS_NULL,                   /* Do nothing, for benchmarking. */
+	SYS_GET_TICKS,              /* Obtain the timer tick count. */
+	SYS_GETPID,                 /* Obtain the caller's pid. */
+	SYS_URING_SETUP,            /* Create a submission/completion ring. */
+	SYS_URING_ENTER,            /* Submit and wait for ring operations. */
+	SYS_VFORK,                  /* Start a child in this address space. */
+	SYS_SPAWN,                  /* Start a child running a program. */
+	SYS_TEMPLATE_MARK,          /* Make a template of this process. */
+	SYS_SPAWN_TEMPLATE,         /* Start a child from a template. */
+	SYS_PIPE,                   /* Create a pipe. */
+	SYS_SHM_CREATE,             /* Create a shared memory object. */
+	SYS_SHM_MAP,                /* Map a shared memory object. */
+	SYS_SHM_UNMAP,              /* Remove a shared memory mapping. */
+	SYS_POLL,                   /* Wait for file descriptors. */
+	SYS_EPOLL_CTL,              /* Change the interest set. */
+	SYS_EPOLL_WAIT,             /* Wait for the interest set. */
+	SYS_FUTEX_WAIT,             /* Wait on a futex. */
+	SYS_FUTEX_WAKE,             /* Wake futex waiters. */
+	SYS_THREAD_SPAWN,           /* Start a thread in this process. */
+	SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+	SYS_SET_TLS,                /* Set the thread-local storage pointer. */
+	SYS_GETRUSAGE,              /* Report resource usage. */
+	SYS_SBRK,                   /* Move the heap's break. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,59 @@
+#ifndef __LIB_URING_H
+#define __LIB_URING_H
+
+#include <stdint.h>
+
+/* User virtual address of a process's submission and completion
+   ring, once uring_setup() has created it.  It sits just below the
+   shared kernel data page (see lib/vdso.h). */
+#define URING_ADDR 0x3fe000
+
+#define URING_SQ_ENTRIES 32     /* Submission queue slots. */
+#define URING_CQ_ENTRIES 64     /* Completion queue slots. */
+
+/* Operations that may be submitted. */
+enum uring_op {
+	URING_OP_NOP,               /* Do nothing. */
+	URING_OP_READ,              /* Read LEN bytes at OFF from FD to ADDR. */
+	URING_OP_WRITE,             /* Write LEN bytes from ADDR to FD at OFF. */
+	URING_OP_FSYNC,             /* Make writes to FD durable. */
+	URING_OP_OPEN,              /* Open file named by string ADDR. */
+	URING_OP_CLOSE,             /* Close FD. */
+};
+
+/* Submission queue entry. */
+struct uring_sqe {
+	uint8_t opcode;             /* One of URING_OP_*. */
+	uint8_t pad[3];
+	int32_t fd;                 /* File descriptor. */
+	uint64_t addr;              /* User buffer or file name. */
+	uint32_t len;               /* Buffer size in bytes. */
+	uint32_t off;               /* File offset. */
+	uint64_t user_data;         /* Copied into the completion. */
+};
+
+/* Completion queue entry. */
+struct uring_cqe {
+	uint64_t user_data;         /* From the submission. */
+	int32_t res;                /* Bytes transferred, new fd, 0, or -1. */
+	uint32_t pad;
+};
+
+/* The ring page shared between a process and the kernel.
+
+   Each queue's head and tail count entries since setup and wrap
+   around freely; slot I of a queue is entry I modulo its size.
+   The process fills SQES[] and advances SQ_TAIL, and the kernel
+   advances SQ_HEAD as it takes them.  The kernel fills CQES[] and
+   advances CQ_TAIL, and the process advances CQ_HEAD as it
+   consumes them. */
+struct uring {
+	uint32_t sq_head;           /* Next entry the kernel takes. */
+	uint32_t sq_tail;           /* Next entry the process fills. */
+	uint32_t cq_head;           /* Next entry the process consumes. */
+	uint32_t cq_tail;           /* Next entry the kernel fills. */
+	struct uring_sqe sqes[URING_SQ_ENTRIES];
+	struct uring_cqe cqes[URING_CQ_ENTRIES];
+};
+
+#endif /* lib/uring.h */
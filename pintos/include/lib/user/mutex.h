@@ -0,0 +1,19 @@
+#ifndef __LIB_USER_MUTEX_H
+#define __LIB_USER_MUTEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A mutex built on a futex.  It may live in shared memory, to
+   be shared between processes.  Zeroed memory is an unlocked
+   mutex. */
+struct mutex {
+	uint32_t state;             /* One of MUTEX_* in mutex.c. */
+};
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+#endif /* lib/user/mutex.h */
@@ -4,4 +4,35 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* A buffered stream, defined in lib/user/stream.c. */
+typedef struct FILE FILE;
+
+/* Buffering modes for setvbuf(). */
+#define _IOFBF 0                /* Write when the buffer fills. */
+#define _IOLBF 1                /* ...and at the end of each line. */
+#define _IONBF 2                /* ...and at the end of each call. */
+
+/* Default size of a stream's buffer. */
+#define BUFSIZ 4096
+
+/* Returned on end of file or error. */
+#define EOF (-1)
+
+extern FILE *stdin;
+extern FILE *stdout;
+
+FILE *fopen (const char *name, const char *mode);
+FILE *fdopen (int fd, const char *mode);
+int fclose (FILE *);
+int setvbuf (FILE *, char *buf, int mode, size_t size);
+int fflush (FILE *);
+size_t fread (void *, size_t size, size_t cnt, FILE *);
+size_t fwrite (const void *, size_t size, size_t cnt, FILE *);
+int fgetc (FILE *);
+int fputc (int, FILE *);
+int fputs (const char *, FILE *);
+int fprintf (FILE *, const char *, ...) PRINTF_FORMAT (2, 3);
+int vfprintf (FILE *, const char *, va_list) PRINTF_FORMAT (2, 0);
+int fileno (FILE *);
+
 #endif /* lib/user/stdio.h */
@@ -4,6 +4,12 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <iostat.h>
+#include <poll.h>
+#include <rusage.h>
+#include <spawn.h>
+#include <uring.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -50,6 +56,40 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Extensions. */
+bool iostat (pid_t, struct iostat *);
+void null_syscall (void);
+int64_t get_ticks (void);
+pid_t getpid (void);
+struct uring *uring_setup (void);
+int uring_enter (unsigned to_submit, unsigned min_complete);
+pid_t vfork (const char *thread_name);
+pid_t spawn (const char *path, char *const argv[],
+             const struct spawn_action *actions);
+int template_mark (int (*main) (int argc, char *argv[]));
+pid_t spawn_from_template (pid_t, char *const argv[]);
+int pipe (int fds[2]);
+int shm_create (size_t size);
+void *shm_map (int fd, void *addr);
+bool shm_unmap (void *addr);
+int poll (struct pollfd *, size_t cnt, int64_t timeout);
+int epoll_ctl (int op, int fd, struct epoll_event *);
+int epoll_wait (struct epoll_event *, int max, int64_t timeout);
+int futex_wait (uint32_t *addr, uint32_t expected, int64_t timeout);
+int futex_wake (uint32_t *addr, int cnt);
+pid_t thread_spawn (int (*func) (void *), void *arg, void *stack);
+int thread_join (pid_t);
+int set_tls (void *);
+void *get_tls (void);
+int getrusage (int who, struct rusage *);
+void *sbrk (intptr_t increment);
+
+/* Read from the kernel's shared data page, without a system
+   call. */
+int64_t vdso_ticks (void);
+uint64_t vdso_time_ns (void);
+pid_t vdso_getpid (void);
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
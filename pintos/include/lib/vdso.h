@@ -0,0 +1,27 @@
+#ifndef __LIB_VDSO_H
+#define __LIB_VDSO_H
+
+#include <stdint.h>
+
+/* User virtual address of the kernel's shared data page, which
+   every user process may read but not write.  It sits just below
+   the address that user programs are linked at (see
+   lib/user/user.lds). */
+#define VDSO_ADDR 0x3ff000
+
+/* Contents of the shared data page. */
+struct vdso_data {
+	/* Updated by the timer interrupt.  SEQ is odd while the members
+	   below are being changed; readers retry until they see the same
+	   even SEQ before and after reading them. */
+	uint32_t seq;
+	uint32_t timer_freq;        /* Timer ticks per second. */
+	int64_t ticks;              /* Timer ticks since boot. */
+	uint64_t tick_tsc;          /* Time stamp counter at last tick. */
+	uint64_t tsc_per_tick;      /* TSC cycles per tick, averaged. */
+
+	/* Updated on every context switch. */
+	int32_t tid;                /* Running thread's id. */
+};
+
+#endif /* lib/vdso.h */
@@ -38,6 +38,32 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Wait queue.  Something a thread may wait for, such as data
+   arriving, keeps a wait queue, and wakes it when that happens.
+   A thread waits for any of several such things at once by putting
+   a waiter on each of their queues, all upping the same
+   semaphore. */
+struct wait_queue {
+	struct list waiters;        /* List of struct waiter. */
+};
+
+/* A thread's place on a wait queue. */
+struct waiter {
+	struct semaphore *sema;     /* Upped whenever woken. */
+	struct list *ready;         /* If nonnull, woken waiters join it. */
+	bool woken;                 /* On READY? */
+	struct wait_queue *queue;   /* Queue waited on, or null. */
+	struct list_elem elem;      /* Element in QUEUE. */
+	struct list_elem ready_elem; /* Element in READY. */
+};
+
+void wait_queue_init (struct wait_queue *);
+void wait_queue_wake (struct wait_queue *);
+void wait_queue_destroy (struct wait_queue *);
+void waiter_init (struct waiter *, struct semaphore *, struct list *ready);
+void waiter_add (struct waiter *, struct wait_queue *);
+void waiter_remove (struct waiter *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -3,8 +3,12 @@
 
 #include <debug.h>
 #include <list.h>
+#include <rusage.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
+#ifdef USERPROG
+#include "userprog/mman.h"
+#endif
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -91,6 +95,15 @@ struct thread {
 	char name[16];                      /* 이름(디버깅용). */
 	int priority;                       /* 우선순위. */
 	int64_t wakeup_tick;				// 이 스레드가 깨워져야 할 시간(tick 단위)
+	struct list_elem allelem;           /* 모든 스레드 리스트의 원소. */
+
+	/* devices/disk.c에서 소유. */
+	uint64_t io_read_bytes;             /* 디스크에서 읽은 바이트 수. */
+	uint64_t io_write_bytes;            /* 디스크에 쓴 바이트 수. */
+	int64_t io_wait_ticks;              /* 디스크 I/O를 기다린 틱 수. */
+
+	/* 여러 곳에서 갱신. */
+	struct rusage usage;                /* getrusage()로 보고할 자원 사용량. */
 
 	/* thread.c와 synch.c 사이에서 공유. */
 	struct list_elem elem;              /* 리스트 원소. */
@@ -98,6 +111,25 @@ struct thread {
 #ifdef USERPROG
 	/* userprog/process.c에서 소유. */
 	uint64_t *pml4;                     /* 4단계 페이지 맵 (PML4). */
+	int exit_status;                    /* exit()으로 넘겨받은 종료 상태. */
+	struct child *child;                /* 부모와 공유하는 자신의 종료 기록. */
+	struct list children;               /* 자식들의 종료 기록 리스트. */
+	struct fd_table *fd_table;          /* 파일 디스크립터 테이블. */
+	struct file *exec_file;             /* 실행 중인 실행 파일. */
+	struct uring_ctx *uring;            /* 제출/완료 링, 없으면 NULL (메인 스레드만). */
+	struct semaphore *vfork_done;       /* 빌린 주소 공간을 돌려줄 때 up. */
+	struct image *image;                /* 실행 파일의 캐시된 이미지. */
+	struct template *template;          /* 자신이 만든 템플릿, 없으면 NULL. */
+	struct list shm_maps;               /* 공유 메모리 매핑 리스트. */
+	struct mman mman;                   /* 힙과 익명 매핑. */
+	struct poll_set *poll_set;          /* epoll 관심 집합, 없으면 NULL (메인 스레드만). */
+	struct thread *leader;              /* 프로세스의 메인 스레드, 자신이면 NULL. */
+	struct list threads;                /* 보조 스레드들의 종료 기록 리스트. */
+	int thread_cnt;                     /* 살아 있는 보조 스레드 수. */
+	struct semaphore *threads_done;     /* 보조 스레드가 모두 끝나면 up. */
+	uint64_t fs_base;                   /* TLS 포인터 (FS base). */
+	struct rusage child_usage;          /* 기다려 준 자식들의 자원 사용량. */
+	uint64_t rss;                       /* 지금 매핑한 사용자 페이지 수. */
 #endif
 #ifdef VM
 	/* 스레드가 소유한 전체 가상 메모리 테이블. */
@@ -117,12 +149,16 @@ extern bool thread_mlfqs;
 void thread_init (void);
 void thread_start (void);
 
-void thread_tick (void);
+void thread_tick (bool user);
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
+/* 각 스레드에 대해 수행할 함수. */
+typedef void thread_action_func (struct thread *t, void *aux);
+void thread_foreach (thread_action_func *, void *);
+
 void thread_block (void);
 void thread_unblock (struct thread *);
 
@@ -152,4 +188,4 @@ void thread_awake (int64_t now_tick);
 bool thread_prio_cmp (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 void max_priority();
 
-#endif /* threads/thread.h */
\ No newline at end of file
+#endif /* threads/thread.h */
\ No newline at end of file
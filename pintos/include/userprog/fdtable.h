@@ -0,0 +1,24 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+
+/* Number of file descriptors a process may have, counting 0 and
+ * 1, which stand for the console. */
+#define FD_MAX 32768
+
+struct file;
+
+struct fd_table *fdt_create (void);
+struct fd_table *fdt_clone (struct fd_table *);
+void fdt_destroy (struct fd_table *);
+int fdt_add (struct fd_table *, struct file *);
+bool fdt_install (struct fd_table *, int fd, struct file *,
+		struct file **old);
+bool fdt_replace (struct fd_table *, int fd, struct file *old,
+		struct file *new);
+struct file *fdt_get (struct fd_table *, int fd);
+struct file *fdt_remove (struct fd_table *, int fd);
+int fdt_next (struct fd_table *, int fd);
+
+#endif /* userprog/fdtable.h */
@@ -0,0 +1,42 @@
+#ifndef USERPROG_IMAGE_H
+#define USERPROG_IMAGE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+/* A loadable segment of an executable. */
+struct image_seg {
+	off_t file_page;            /* File offset of its first page. */
+	uint64_t mem_page;          /* User address of its first page. */
+	uint32_t read_bytes;        /* Bytes read from the file... */
+	uint32_t zero_bytes;        /* ...followed by this many zeros. */
+	bool writable;              /* Writable by the process? */
+	size_t page_cnt;            /* Pages spanned. */
+	void **pages;               /* Initial contents of each page, or a
+	                               null pointer for a page of zeros. */
+};
+
+/* A parsed executable, with the contents of its pages. */
+struct image {
+	struct inode *inode;        /* The file, held open. */
+	unsigned write_cnt;         /* inode_write_cnt() when read. */
+	uint64_t entry;             /* Entry point. */
+	size_t seg_cnt;             /* Number of segments. */
+	struct image_seg *segs;     /* Loadable segments. */
+	int ref_cnt;                /* Processes using it, plus the cache. */
+	bool cached;                /* In the cache? */
+	struct list_elem elem;      /* Element in the cache. */
+};
+
+void image_init (void);
+struct image *image_open (const char *name);
+struct image *image_ref (struct image *);
+void image_release (struct image *);
+void image_purge (void);
+bool image_is_shared (const struct image *, const void *upage,
+		const void *kpage);
+void image_unmap (const struct image *, uint64_t *pml4);
+
+#endif /* userprog/image.h */
@@ -0,0 +1,25 @@
+#ifndef USERPROG_MMAN_H
+#define USERPROG_MMAN_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A process's heap and anonymous mappings. */
+struct mman {
+	uintptr_t heap_start;       /* Bottom of the heap, or 0 if none. */
+	uintptr_t brk;              /* Current break. */
+	struct list maps;           /* struct mman_map, highest first. */
+};
+
+void mman_init (void);
+void mman_create (struct mman *);
+void mman_destroy (struct mman *);
+bool mman_copy (struct mman *dst, struct mman *src);
+void mman_set_heap (struct mman *, uintptr_t heap_start);
+void *mman_sbrk (intptr_t increment);
+void *mman_map (void *addr, size_t length, bool writable);
+bool mman_unmap (void *addr);
+
+#endif /* userprog/mman.h */
@@ -0,0 +1,15 @@
+#ifndef USERPROG_POLL_H
+#define USERPROG_POLL_H
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+int poll_fds (struct pollfd *, size_t cnt, int64_t timeout);
+bool poll_ctl (int op, int fd, const struct epoll_event *);
+int poll_wait (struct epoll_event *, int max, int64_t timeout);
+void poll_forget (int fd);
+void poll_destroy (void);
+
+#endif /* userprog/poll.h */
@@ -3,11 +3,34 @@
 
 #include "threads/thread.h"
 
+struct file;
+struct spawn_action;
+
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
+tid_t process_vfork (const char *name, struct intr_frame *if_);
+tid_t process_spawn (const char *path, char *cmd_line,
+		const struct spawn_action *, size_t action_cnt);
+void process_template_init (void);
+bool process_template_mark (uint64_t entry, uint64_t arg);
+tid_t process_spawn_template (tid_t, char *cmd_line);
 int process_exec (void *f_name);
 int process_wait (tid_t);
+tid_t process_thread_spawn (uint64_t entry, uint64_t stack, uint64_t arg0,
+		uint64_t arg1);
+int process_join (tid_t);
+bool process_set_tls (uint64_t base);
+struct thread *process_leader (struct thread *);
+void process_add_rss (int64_t pages);
+bool process_getrusage (int who, struct rusage *);
 void process_exit (void);
 void process_activate (struct thread *next);
 
+int process_add_file (struct file *);
+struct file *process_get_file (int fd);
+struct file *process_get_own_file (int fd);
+void process_put_file (struct file *);
+void process_close_file (int fd);
+int process_dup2 (int oldfd, int newfd);
+
 #endif /* userprog/process.h */
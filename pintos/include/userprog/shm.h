@@ -0,0 +1,24 @@
+#ifndef USERPROG_SHM_H
+#define USERPROG_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/thread.h"
+
+struct file;
+struct shm;
+
+struct shm *shm_create (size_t size);
+struct file *shm_open_file (struct shm *);
+struct shm *shm_from_file (struct file *);
+void shm_ref (struct shm *);
+void shm_release (struct shm *);
+size_t shm_size (const struct shm *);
+void *shm_map (struct shm *, void *addr);
+bool shm_unmap (void *addr);
+bool shm_contains (struct thread *, const void *upage);
+bool shm_fork (struct thread *parent);
+void shm_unmap_all (uint64_t *pml4);
+
+#endif /* userprog/shm.h */
@@ -1,6 +1,15 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include "threads/synch.h"
+
+extern struct lock filesys_lock;
+
+/* Size of the kernel buffer that file names are copied into,
+   including the null terminator.  Longer names are rejected. */
+#define NAME_BUF_SIZE 128
+
 void syscall_init (void);
+void syscall_print_stats (void);
 
 #endif /* userprog/syscall.h */
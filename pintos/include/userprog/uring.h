@@ -0,0 +1,13 @@
+#ifndef USERPROG_URING_H
+#define USERPROG_URING_H
+
+#include <uring.h>
+
+void uring_init (void);
+void *uring_setup (void);
+int uring_enter (unsigned to_submit, unsigned min_complete);
+void uring_pause (void);
+void uring_resume (void);
+void uring_destroy (void);
+
+#endif /* userprog/uring.h */
@@ -3,6 +3,8 @@
 #include <random.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 /* Converts a string representation of a signed decimal integer
    in S into an `int', which is returned. */
@@ -52,7 +54,7 @@ compare_thunk (const void *a, const void *b, void *aux)
    using COMPARE.  When COMPARE is passed a pair of elements A
    and B, respectively, it must return a strcmp()-type result,
    i.e. less than zero if A < B, zero if A == B, greater than
-   zero if A > B.  Runs in O(n lg n) time and O(1) space in
+   zero if A > B.  Runs in O(n lg n) time and O(lg n) space in
    CNT. */
 void
 qsort (void *array, size_t cnt, size_t size,
@@ -61,21 +63,47 @@ qsort (void *array, size_t cnt, size_t size,
   sort (array, cnt, size, compare_thunk, &compare);
 }
 
+/* Sorting.
+
+   sort() is an introsort.  It quicksorts, taking the median of the
+   first, middle, and last elements of each part as its pivot, and
+   leaves parts of up to INSERTION_MAX elements to insertion sort.
+   A part still unsorted after 2 lg CNT levels of partitioning is
+   heapsorted instead, so the worst case stays O(n lg n).  Only
+   the smaller part of each partition is sorted recursively, which
+   keeps the stack O(lg n) deep.  Elements are swapped 8 bytes at
+   a time. */
+
+/* Longest part left to insertion sort. */
+#define INSERTION_MAX 16
+
+/* A 64-bit word that may be unaligned and may alias anything. */
+typedef uint64_t word_t __attribute__ ((may_alias, aligned (1)));
+
+/* Swaps the elements of SIZE bytes at A and B. */
+static inline void
+swap (unsigned char *a, unsigned char *b, size_t size)
+{
+  for (; size >= 8; size -= 8, a += 8, b += 8)
+    {
+      uint64_t t = *(word_t *) a;
+      *(word_t *) a = *(word_t *) b;
+      *(word_t *) b = t;
+    }
+  for (; size > 0; size--, a++, b++)
+    {
+      unsigned char t = *a;
+      *a = *b;
+      *b = t;
+    }
+}
+
 /* Swaps elements with 1-based indexes A_IDX and B_IDX in ARRAY
    with elements of SIZE bytes each. */
 static void
 do_swap (unsigned char *array, size_t a_idx, size_t b_idx, size_t size)
 {
-  unsigned char *a = array + (a_idx - 1) * size;
-  unsigned char *b = array + (b_idx - 1) * size;
-  size_t i;
-
-  for (i = 0; i < size; i++)
-    {
-      unsigned char t = a[i];
-      a[i] = b[i];
-      b[i] = t;
-    }
+  swap (array + (a_idx - 1) * size, array + (b_idx - 1) * size, size);
 }
 
 /* Compares elements with 1-based indexes A_IDX and B_IDX in
@@ -122,33 +150,210 @@ heapify (unsigned char *array, size_t i, size_t cnt, size_t size,
     }
 }
 
+/* Sorts ARRAY, which contains CNT elements of SIZE bytes each,
+   using COMPARE and AUX as for sort(), by heapsort. */
+static void
+heap_sort (unsigned char *array, size_t cnt, size_t size,
+           int (*compare) (const void *, const void *, void *aux),
+           void *aux) 
+{
+  size_t i;
+
+  /* Build a heap. */
+  for (i = cnt / 2; i > 0; i--)
+    heapify (array, i, cnt, size, compare, aux);
+
+  /* Sort the heap. */
+  for (i = cnt; i > 1; i--) 
+    {
+      do_swap (array, 1, i, size);
+      heapify (array, 1, i - 1, size, compare, aux); 
+    }
+}
+
+/* Sorts ARRAY, which contains CNT elements of SIZE bytes each,
+   using COMPARE and AUX as for sort(), by insertion sort. */
+static void
+insertion_sort (unsigned char *array, size_t cnt, size_t size,
+                int (*compare) (const void *, const void *, void *aux),
+                void *aux) 
+{
+  unsigned char *end = array + cnt * size;
+  unsigned char *p, *q;
+
+  for (p = array + size; p < end; p += size)
+    for (q = p; q > array && compare (q - size, q, aux) > 0; q -= size)
+      swap (q - size, q, size);
+}
+
+/* Sorts ARRAY, which contains CNT elements of SIZE bytes each,
+   using COMPARE and AUX as for sort(), by quicksort, falling back
+   to heapsort after DEPTH more levels of partitioning. */
+static void
+introsort (unsigned char *array, size_t cnt, size_t size,
+           int (*compare) (const void *, const void *, void *aux),
+           void *aux, int depth) 
+{
+  while (cnt > INSERTION_MAX)
+    {
+      unsigned char *pivot = array + size;
+      unsigned char *last = array + (cnt - 1) * size;
+      unsigned char *lo, *hi;
+      size_t left_cnt, right_cnt;
+
+      if (depth-- == 0)
+        {
+          heap_sort (array, cnt, size, compare, aux);
+          return;
+        }
+
+      /* Put the first, middle, and last elements in order, with
+         the middle one, the pivot, in the second position.  The
+         other two then stop the scans below from running off
+         either end. */
+      swap (pivot, array + cnt / 2 * size, size);
+      if (compare (pivot, array, aux) < 0)
+        swap (pivot, array, size);
+      if (compare (last, pivot, aux) < 0)
+        {
+          swap (last, pivot, size);
+          if (compare (pivot, array, aux) < 0)
+            swap (pivot, array, size);
+        }
+
+      /* Partition the rest around the pivot.  Both scans stop at
+         elements equal to it, which keeps the parts balanced when
+         there are many duplicates. */
+      lo = pivot;
+      hi = last;
+      for (;;)
+        {
+          do
+            lo += size;
+          while (compare (lo, pivot, aux) < 0);
+          do
+            hi -= size;
+          while (compare (hi, pivot, aux) > 0);
+          if (lo >= hi)
+            break;
+          swap (lo, hi, size);
+        }
+      swap (pivot, hi, size);
+
+      /* Sort the smaller part, then loop on the larger. */
+      left_cnt = (hi - array) / size;
+      right_cnt = cnt - left_cnt - 1;
+      if (left_cnt < right_cnt)
+        {
+          introsort (array, left_cnt, size, compare, aux, depth);
+          array = hi + size;
+          cnt = right_cnt;
+        }
+      else
+        {
+          introsort (hi + size, right_cnt, size, compare, aux, depth);
+          cnt = left_cnt;
+        }
+    }
+  insertion_sort (array, cnt, size, compare, aux);
+}
+
 /* Sorts ARRAY, which contains CNT elements of SIZE bytes each,
    using COMPARE to compare elements, passing AUX as auxiliary
    data.  When COMPARE is passed a pair of elements A and B,
    respectively, it must return a strcmp()-type result, i.e. less
    than zero if A < B, zero if A == B, greater than zero if A >
-   B.  Runs in O(n lg n) time and O(1) space in CNT. */
+   B.  Runs in O(n lg n) time and O(lg n) space in CNT. */
 void
 sort (void *array, size_t cnt, size_t size,
       int (*compare) (const void *, const void *, void *aux),
       void *aux) 
 {
+  int depth = 0;
   size_t i;
 
   ASSERT (array != NULL || cnt == 0);
   ASSERT (compare != NULL);
   ASSERT (size > 0);
 
-  /* Build a heap. */
-  for (i = cnt / 2; i > 0; i--)
-    heapify (array, i, cnt, size, compare, aux);
+  for (i = cnt; i > 1; i /= 2)
+    depth += 2;
+  introsort (array, cnt, size, compare, aux, depth);
+}
 
-  /* Sort the heap. */
-  for (i = cnt; i > 1; i--) 
+/* Copies the SIZE-byte integer at SRC to DST. */
+static inline void
+copy_key (void *dst, const void *src, size_t size) 
+{
+  switch (size)
     {
-      do_swap (array, 1, i, size);
-      heapify (array, 1, i - 1, size, compare, aux); 
+    case 1:
+      *(uint8_t *) dst = *(const uint8_t *) src;
+      break;
+    case 2:
+      *(uint16_t *) dst = *(const uint16_t *) src;
+      break;
+    case 4:
+      *(uint32_t *) dst = *(const uint32_t *) src;
+      break;
+    default:
+      *(uint64_t *) dst = *(const uint64_t *) src;
+      break;
+    }
+}
+
+/* Sorts ARRAY, which contains CNT unsigned integers of SIZE bytes
+   each, where SIZE is 1, 2, 4, or 8, into ascending order.  TMP
+   must point to CNT * SIZE bytes of scratch space, aligned like
+   ARRAY, whose contents are lost.
+
+   This is a least significant digit radix sort, which never
+   compares keys: it makes one stable pass over the array for
+   each byte of the keys, lowest first, skipping any byte that is
+   the same in every key.  Runs in O(n) time. */
+void
+radix_sort (void *array, void *tmp, size_t cnt, size_t size) 
+{
+  unsigned char *src = array;
+  unsigned char *dst = tmp;
+  size_t digit, i;
+
+  ASSERT (size == 1 || size == 2 || size == 4 || size == 8);
+  ASSERT ((array != NULL && tmp != NULL) || cnt == 0);
+  ASSERT (cnt <= UINT32_MAX);
+
+  /* The keys are little-endian, so byte DIGIT of each is its
+     DIGIT'th digit in base 256. */
+  for (digit = 0; digit < size && cnt > 0; digit++)
+    {
+      uint32_t count[256];
+      uint32_t pos = 0;
+      unsigned char *t;
+
+      memset (count, 0, sizeof count);
+      for (i = 0; i < cnt; i++)
+        count[src[i * size + digit]]++;
+      if (count[src[digit]] == cnt)
+        continue;
+
+      /* Turn each count into the index where that digit's keys
+         start. */
+      for (i = 0; i < 256; i++)
+        {
+          uint32_t c = count[i];
+          count[i] = pos;
+          pos += c;
+        }
+      for (i = 0; i < cnt; i++)
+        copy_key (dst + (size_t) count[src[i * size + digit]]++ * size,
+                  src + i * size, size);
+
+      t = src;
+      src = dst;
+      dst = t;
     }
+  if (src != array)
+    memcpy (array, src, cnt * size);
 }
 
 /* Searches ARRAY, which contains CNT elements of SIZE bytes
@@ -1,5 +1,91 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* Copying and filling.
+
+   memcpy(), memmove() and memset() move 8 bytes at a time.  For
+   blocks of at least REP_MIN bytes they use the string
+   instructions, rep movsq and rep stosq, which the CPU runs faster
+   than any loop we could write without SSE, but which take a while
+   to get going.  They first move single bytes up to an 8-byte
+   boundary in DST, since the string instructions are slow on
+   misaligned destinations.
+
+   Both the kernel and user programs run with the direction flag
+   clear, as the ABI requires: the kernel clears it on every entry
+   from user mode.  memmove() sets it only for the duration of one
+   instruction. */
+
+/* Smallest block worth the string instructions' start-up cost. */
+#define REP_MIN 128
+
+/* A 64-bit word that may be unaligned and may alias anything. */
+typedef uint64_t word_t __attribute__ ((may_alias, aligned (1)));
+
+/* Copies SIZE bytes from SRC to DST, lowest address first.
+   Returns DST. */
+static inline void *
+copy_up (void *dst_, const void *src_, size_t size) {
+	unsigned char *dst = dst_;
+	const unsigned char *src = src_;
+
+	if (size >= REP_MIN) {
+		size_t head = -(uintptr_t) dst & 7;
+		size_t words;
+
+		size -= head;
+		words = size / 8;
+		size %= 8;
+		asm volatile ("rep movsb"
+				: "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+		asm volatile ("rep movsq"
+				: "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+	}
+	for (; size >= 8; size -= 8, dst += 8, src += 8)
+		*(word_t *) dst = *(const word_t *) src;
+	while (size-- > 0)
+		*dst++ = *src++;
+
+	return dst_;
+}
+
+/* Copies SIZE bytes from SRC to DST, highest address first, so
+   that DST may overlap the end of SRC.  Returns DST. */
+static inline void *
+copy_down (void *dst_, const void *src_, size_t size) {
+	unsigned char *dst = (unsigned char *) dst_ + size;
+	const unsigned char *src = (const unsigned char *) src_ + size;
+
+	if (size >= REP_MIN) {
+		size_t head = (uintptr_t) dst & 7;
+		size_t words;
+
+		size -= head;
+		while (head-- > 0)
+			*--dst = *--src;
+
+		/* With the direction flag set, rep movsq starts at the
+		   last word and works down. */
+		words = size / 8;
+		size %= 8;
+		dst -= 8;
+		src -= 8;
+		asm volatile ("std; rep movsq; cld"
+				: "+D" (dst), "+S" (src), "+c" (words) : : "memory", "cc");
+		dst += 8;
+		src += 8;
+	}
+	for (; size >= 8; size -= 8) {
+		dst -= 8;
+		src -= 8;
+		*(word_t *) dst = *(const word_t *) src;
+	}
+	while (size-- > 0)
+		*--dst = *--src;
+
+	return dst_;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -11,10 +97,7 @@ memcpy (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	while (size-- > 0)
-		*dst++ = *src++;
-
-	return dst_;
+	return copy_up (dst, src, size);
 }
 
 /* Copies SIZE bytes from SRC to DST, which are allowed to
@@ -27,17 +110,59 @@ memmove (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	if (dst < src) {
-		while (size-- > 0)
-			*dst++ = *src++;
-	} else {
-		dst += size;
-		src += size;
-		while (size-- > 0)
-			*--dst = *--src;
-	}
+	/* Copying upward is safe unless DST starts inside SRC.  Each
+	   word is read in full before it is written, so blocks less than
+	   a word apart are safe too. */
+	if ((uintptr_t) dst - (uintptr_t) src >= size)
+		return copy_up (dst, src, size);
+	return copy_down (dst, src, size);
+}
+
+/* Scanning.
+
+   memcmp(), strcmp(), memchr(), strchr(), strlen() and strnlen()
+   also look at 8 bytes per step.  To find a zero byte in a word W,
+   they compute zero_bytes(W), which is nonzero if and only if some
+   byte of W is zero, and whose lowest set bit is in the first such
+   byte.  Bits above that may be set spuriously, so only the lowest
+   one counts.  To find byte C instead, they look for a zero byte in
+   W ^ (C * ONES).
+
+   Functions that scan for a terminator do not know where their
+   block ends.  So they read only aligned words, which never cross
+   into the next page, and may read beyond the terminator only
+   within the word that holds it.  The first such word may start
+   before the block.  Its leading bytes are set to 0xff, so they
+   are never mistaken for zeros.  strcmp() can align only one of its
+   strings, so it compares the other a byte at a time wherever a
+   word from it would cross a page. */
+
+/* Every byte 0x01, or 0x80. */
+#define ONES 0x0101010101010101ull
+#define HIGHS 0x8080808080808080ull
+
+/* Smallest size of a page on any machine we run on. */
+#define MIN_PAGE_SIZE 4096
+
+/* Returns a word whose lowest set bit is in the first zero byte
+   of W, or 0 if W has no zero byte. */
+static inline uint64_t
+zero_bytes (uint64_t w) {
+	return (w - ONES) & ~w & HIGHS;
+}
+
+/* Returns the index within a word of the byte holding the lowest
+   set bit of MASK, which must be nonzero. */
+static inline size_t
+first_byte (uint64_t mask) {
+	return __builtin_ctzll (mask) / 8;
+}
 
-	return dst;
+/* Returns a word with its first CNT bytes, fewer than 8, set to
+   0xff and the rest 0. */
+static inline uint64_t
+leading_bytes (size_t cnt) {
+	return (1ull << (cnt * 8)) - 1;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -52,6 +177,14 @@ memcmp (const void *a_, const void *b_, size_t size) {
 	ASSERT (a != NULL || size == 0);
 	ASSERT (b != NULL || size == 0);
 
+	for (; size >= 8; size -= 8, a += 8, b += 8) {
+		uint64_t diff = *(const word_t *) a ^ *(const word_t *) b;
+
+		if (diff != 0) {
+			size_t i = first_byte (diff);
+			return a[i] > b[i] ? +1 : -1;
+		}
+	}
 	for (; size-- > 0; a++, b++)
 		if (*a != *b)
 			return *a > *b ? +1 : -1;
@@ -71,6 +204,35 @@ strcmp (const char *a_, const char *b_) {
 	ASSERT (a != NULL);
 	ASSERT (b != NULL);
 
+	/* Align A, then compare words until they differ or hold A's
+	   terminator. */
+	while (((uintptr_t) a & 7) != 0 && *a != '\0' && *a == *b) {
+		a++;
+		b++;
+	}
+	if (((uintptr_t) a & 7) == 0)
+		for (;;) {
+			uint64_t wa;
+
+			if (((uintptr_t) b & (MIN_PAGE_SIZE - 1)) > MIN_PAGE_SIZE - 8) {
+				int i;
+
+				for (i = 0; i < 8 && *a != '\0' && *a == *b; i++) {
+					a++;
+					b++;
+				}
+				if (i < 8)
+					break;
+				continue;
+			}
+			wa = *(const word_t *) a;
+			if (wa != *(const word_t *) b || zero_bytes (wa) != 0)
+				break;
+			a += 8;
+			b += 8;
+		}
+
+	/* Find the difference or the end within the last word. */
 	while (*a != '\0' && *a == *b) {
 		a++;
 		b++;
@@ -85,15 +247,25 @@ strcmp (const char *a_, const char *b_) {
 void *
 memchr (const void *block_, int ch_, size_t size) {
 	const unsigned char *block = block_;
-	unsigned char ch = ch_;
+	uint64_t pattern = (unsigned char) ch_ * ONES;
+	size_t ofs = (uintptr_t) block & 7;
+	const word_t *w = (const word_t *) (block - ofs);
+	const unsigned char *p;
+	uint64_t z;
 
 	ASSERT (block != NULL || size == 0);
 
-	for (; size-- > 0; block++)
-		if (*block == ch)
-			return (void *) block;
-
-	return NULL;
+	if (size == 0)
+		return NULL;
+	z = zero_bytes ((*w ^ pattern) | leading_bytes (ofs));
+	while (z == 0) {
+		if ((size_t) ((const unsigned char *) (w + 1) - block) >= size)
+			return NULL;
+		w++;
+		z = zero_bytes (*w ^ pattern);
+	}
+	p = (const unsigned char *) w + first_byte (z);
+	return p < block + size ? (void *) p : NULL;
 }
 
 /* Finds and returns the first occurrence of C in STRING, or a
@@ -103,16 +275,23 @@ memchr (const void *block_, int ch_, size_t size) {
 char *
 strchr (const char *string, int c_) {
 	char c = c_;
+	uint64_t pattern = (unsigned char) c * ONES;
+	size_t ofs = (uintptr_t) string & 7;
+	const word_t *w = (const word_t *) (string - ofs);
+	const char *p;
+	uint64_t z;
 
 	ASSERT (string);
 
-	for (;;)
-		if (*string == c)
-			return (char *) string;
-		else if (*string == '\0')
-			return NULL;
-		else
-			string++;
+	/* Stop at the first byte that is C or the terminator. */
+	z = zero_bytes (*w | leading_bytes (ofs))
+		| zero_bytes ((*w ^ pattern) | leading_bytes (ofs));
+	while (z == 0) {
+		w++;
+		z = zero_bytes (*w) | zero_bytes (*w ^ pattern);
+	}
+	p = (const char *) w + first_byte (z);
+	return *p == c ? (char *) p : NULL;
 }
 
 /* Returns the length of the initial substring of STRING that
@@ -257,9 +436,24 @@ strtok_r (char *s, const char *delimiters, char **save_ptr) {
 void *
 memset (void *dst_, int value, size_t size) {
 	unsigned char *dst = dst_;
+	uint64_t word = (unsigned char) value * 0x0101010101010101ull;
 
 	ASSERT (dst != NULL || size == 0);
 
+	if (size >= REP_MIN) {
+		size_t head = -(uintptr_t) dst & 7;
+		size_t words;
+
+		size -= head;
+		words = size / 8;
+		size %= 8;
+		asm volatile ("rep stosb"
+				: "+D" (dst), "+c" (head) : "a" (word) : "memory");
+		asm volatile ("rep stosq"
+				: "+D" (dst), "+c" (words) : "a" (word) : "memory");
+	}
+	for (; size >= 8; size -= 8, dst += 8)
+		*(word_t *) dst = word;
 	while (size-- > 0)
 		*dst++ = value;
 
@@ -269,24 +463,38 @@ memset (void *dst_, int value, size_t size) {
 /* Returns the length of STRING. */
 size_t
 strlen (const char *string) {
-	const char *p;
+	size_t ofs = (uintptr_t) string & 7;
+	const word_t *w = (const word_t *) (string - ofs);
+	uint64_t z;
 
 	ASSERT (string);
 
-	for (p = string; *p != '\0'; p++)
-		continue;
-	return p - string;
+	z = zero_bytes (*w | leading_bytes (ofs));
+	while (z == 0)
+		z = zero_bytes (*++w);
+	return (const char *) w + first_byte (z) - string;
 }
 
 /* If STRING is less than MAXLEN characters in length, returns
-   its actual length.  Otherwise, returns MAXLEN. */
+   its actual length.  Otherwise, returns MAXLEN.  Looks at no
+   more of STRING than it must. */
 size_t
 strnlen (const char *string, size_t maxlen) {
+	size_t ofs = (uintptr_t) string & 7;
+	const word_t *w = (const word_t *) (string - ofs);
 	size_t length;
-
-	for (length = 0; string[length] != '\0' && length < maxlen; length++)
-		continue;
-	return length;
+	uint64_t z;
+
+	if (maxlen == 0)
+		return 0;
+	z = zero_bytes (*w | leading_bytes (ofs));
+	while (z == 0) {
+		if ((size_t) ((const char *) (w + 1) - string) >= maxlen)
+			return maxlen;
+		z = zero_bytes (*++w);
+	}
+	length = (const char *) w + first_byte (z) - string;
+	return length < maxlen ? length : maxlen;
 }
 
 /* Copies string SRC to DST.  If SRC is longer than SIZE - 1
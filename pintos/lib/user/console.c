@@ -4,10 +4,11 @@
 #include <syscall-nr.h>
 
 /* The standard vprintf() function,
-   which is like printf() but uses a va_list. */
+   which is like printf() but uses a va_list.  Goes through stdout,
+   which is line-buffered. */
 int
 vprintf (const char *format, va_list args) {
-	return vhprintf (STDOUT_FILENO, format, args);
+	return vfprintf (stdout, format, args);
 }
 
 /* Like printf(), but writes output to the given HANDLE. */
@@ -23,22 +24,18 @@ hprintf (int handle, const char *format, ...) {
 	return retval;
 }
 
-/* Writes string S to the console, followed by a new-line
-   character. */
+/* Writes string S to stdout, followed by a new-line character. */
 int
 puts (const char *s) {
-	write (STDOUT_FILENO, s, strlen (s));
-	putchar ('\n');
-
-	return 0;
+	if (fputs (s, stdout) == EOF)
+		return EOF;
+	return fputc ('\n', stdout) == EOF ? EOF : 0;
 }
 
-/* Writes C to the console. */
+/* Writes C to stdout. */
 int
 putchar (int c) {
-	char c2 = c;
-	write (STDOUT_FILENO, &c2, 1);
-	return c;
+	return fputc (c, stdout);
 }
 
 /* Auxiliary data for vhprintf_helper(). */
@@ -54,10 +51,14 @@ static void flush (struct vhprintf_aux *);
 
 /* Formats the printf() format specification FORMAT with
    arguments given in ARGS and writes the output to the given
-   HANDLE. */
+   HANDLE.  Output to STDOUT_FILENO goes through stdout, to keep it
+   in order with what is buffered there. */
 int
 vhprintf (int handle, const char *format, va_list args) {
 	struct vhprintf_aux aux;
+
+	if (handle == STDOUT_FILENO)
+		return vfprintf (stdout, format, args);
 	aux.p = aux.buf;
 	aux.char_cnt = 0;
 	aux.handle = handle;
@@ -0,0 +1,265 @@
+#include <malloc.h>
+#include <debug.h>
+#include <mutex.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A memory allocator for user programs.
+
+   Requests of up to SMALL_MAX bytes are rounded up to one of a
+   handful of size classes.  Each class keeps a list of its freed
+   blocks, which malloc() hands out again first; otherwise it
+   carves a new block off the current arena by bumping a pointer.
+   Arenas come from sbrk() ARENA_SIZE bytes at a time, so that most
+   allocations never enter the kernel.  Freed small blocks stay on
+   their lists rather than going back to the kernel.
+
+   Larger requests get mappings of their own from mmap().  free()
+   keeps up to CACHE_MAX bytes of these to hand out again to
+   requests they fit, and unmaps the whole cache in one batch when
+   it overflows, instead of entering the kernel for every block.
+
+   Every block starts with a header that gives its size.  A
+   process's threads share the allocator, so a mutex guards it. */
+
+/* Largest request served from a size class. */
+#define SMALL_MAX 2048
+
+/* Bytes obtained from sbrk() for each arena. */
+#define ARENA_SIZE (64 * 1024)
+
+/* Most bytes of large blocks kept for reuse. */
+#define CACHE_MAX (1024 * 1024)
+
+/* Size of a page, the unit of mmap(). */
+#define PAGE_SIZE 4096
+
+/* Header in front of every block, which keeps the block 16-byte
+   aligned. */
+struct header {
+	size_t size;                /* Usable bytes after the header. */
+	size_t magic;               /* BLOCK_MAGIC or FREE_MAGIC. */
+};
+
+/* Values of struct header's magic, to catch bad calls to free(). */
+#define BLOCK_MAGIC 0x6b636f6c62u   /* Allocated. */
+#define FREE_MAGIC 0x65657266u      /* Freed. */
+
+/* A freed block, on its class's list or in the cache. */
+struct free_block {
+	struct header header;
+	struct free_block *next;    /* Next block on the same list. */
+};
+
+/* Usable bytes in the blocks of each size class. */
+static const size_t class_size[] = {
+	16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048,
+};
+#define CLASS_CNT (sizeof class_size / sizeof *class_size)
+
+static struct mutex lock;                       /* Guards what follows. */
+static struct free_block *free_list[CLASS_CNT]; /* Freed small blocks. */
+static uint8_t *arena_next, *arena_end;         /* Unused part of arena. */
+static struct free_block *cache;                /* Freed large blocks. */
+static size_t cache_bytes;                      /* Bytes in CACHE. */
+
+static void *malloc_large (size_t);
+static void free_large (struct free_block *);
+static struct header *bump (size_t);
+
+/* Returns the index of the smallest size class that holds SIZE
+   bytes, which must be at most SMALL_MAX. */
+static inline size_t
+size_class (size_t size) {
+	size_t i = 0;
+
+	while (class_size[i] < size)
+		i++;
+	return i;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes, or a null
+   pointer if memory is exhausted. */
+void *
+malloc (size_t size) {
+	struct free_block *b;
+	struct header *h;
+	size_t i;
+
+	if (size > SMALL_MAX)
+		return malloc_large (size);
+
+	i = size_class (size);
+	mutex_lock (&lock);
+	b = free_list[i];
+	if (b != NULL) {
+		free_list[i] = b->next;
+		h = &b->header;
+	} else
+		h = bump (class_size[i]);
+	mutex_unlock (&lock);
+
+	if (h == NULL)
+		return NULL;
+	h->magic = BLOCK_MAGIC;
+	return h + 1;
+}
+
+/* Allocates and returns a zeroed block of A * B bytes, or a null
+   pointer if memory is exhausted or A * B overflows. */
+void *
+calloc (size_t a, size_t b) {
+	void *p;
+
+	if (b != 0 && a > SIZE_MAX / b)
+		return NULL;
+	p = malloc (a * b);
+	if (p != NULL)
+		memset (p, 0, a * b);
+	return p;
+}
+
+/* Changes the size of block OLD to NEW_SIZE bytes, which may move
+   it, and returns the block.  If OLD is null, allocates a new
+   block; if NEW_SIZE is 0, frees OLD and returns a null pointer.
+   On failure returns a null pointer and leaves OLD alone. */
+void *
+realloc (void *old, size_t new_size) {
+	struct header *h;
+	void *new;
+
+	if (old == NULL)
+		return malloc (new_size);
+	if (new_size == 0) {
+		free (old);
+		return NULL;
+	}
+
+	h = (struct header *) old - 1;
+	ASSERT (h->magic == BLOCK_MAGIC);
+	if (new_size <= h->size)
+		return old;
+	new = malloc (new_size);
+	if (new != NULL) {
+		memcpy (new, old, h->size);
+		free (old);
+	}
+	return new;
+}
+
+/* Frees block P, which must have come from malloc(), calloc(), or
+   realloc() and not been freed since.  Does nothing if P is
+   null. */
+void
+free (void *p) {
+	struct free_block *b;
+	size_t i;
+
+	if (p == NULL)
+		return;
+
+	b = (struct free_block *) ((struct header *) p - 1);
+	ASSERT (b->header.magic == BLOCK_MAGIC);
+	b->header.magic = FREE_MAGIC;
+	if (b->header.size > SMALL_MAX) {
+		free_large (b);
+		return;
+	}
+
+	i = size_class (b->header.size);
+	mutex_lock (&lock);
+	b->next = free_list[i];
+	free_list[i] = b;
+	mutex_unlock (&lock);
+}
+
+/* Obtains a block of SIZE bytes, more than SMALL_MAX, from the
+   cache or a new mapping. */
+static void *
+malloc_large (size_t size) {
+	struct free_block **bp, *b = NULL;
+	struct header *h;
+	size_t length;
+
+	if (size > SIZE_MAX - sizeof *h - PAGE_SIZE)
+		return NULL;
+	length = ROUND_UP (size + sizeof *h, PAGE_SIZE);
+
+	/* Reuse a cached mapping big enough, but not more than twice
+	   the size, so as not to waste much of it. */
+	mutex_lock (&lock);
+	for (bp = &cache; *bp != NULL; bp = &(*bp)->next) {
+		size_t cached = (*bp)->header.size + sizeof *h;
+
+		if (cached >= length && cached / 2 <= length) {
+			b = *bp;
+			*bp = b->next;
+			cache_bytes -= cached;
+			break;
+		}
+	}
+	mutex_unlock (&lock);
+
+	if (b != NULL)
+		h = &b->header;
+	else {
+		h = mmap (NULL, length, true, -1, 0);
+		if (h == MAP_FAILED)
+			return NULL;
+		h->size = length - sizeof *h;
+	}
+	h->magic = BLOCK_MAGIC;
+	return h + 1;
+}
+
+/* Puts large block B in the cache, unmapping every block there if
+   that takes the cache over CACHE_MAX bytes. */
+static void
+free_large (struct free_block *b) {
+	struct free_block *batch = NULL;
+
+	mutex_lock (&lock);
+	b->next = cache;
+	cache = b;
+	cache_bytes += b->header.size + sizeof b->header;
+	if (cache_bytes > CACHE_MAX) {
+		batch = cache;
+		cache = NULL;
+		cache_bytes = 0;
+	}
+	mutex_unlock (&lock);
+
+	while (batch != NULL) {
+		struct free_block *next = batch->next;
+
+		munmap (batch);
+		batch = next;
+	}
+}
+
+/* Carves a block of SIZE bytes off the current arena, starting a
+   new one if it is too small.  Returns the block's header, with its
+   size filled in, or a null pointer if memory is exhausted.  The
+   caller must hold LOCK. */
+static struct header *
+bump (size_t size) {
+	struct header *h;
+
+	if ((size_t) (arena_end - arena_next) < sizeof *h + size) {
+		uint8_t *arena = sbrk (ARENA_SIZE);
+
+		if (arena == (void *) -1)
+			return NULL;
+		/* Keep what is left of the old arena if the new one
+		   continues it. */
+		if (arena != arena_end)
+			arena_next = arena;
+		arena_end = arena + ARENA_SIZE;
+	}
+	h = (struct header *) arena_next;
+	h->size = size;
+	arena_next += sizeof *h + size;
+	return h;
+}
@@ -0,0 +1,55 @@
+#include <mutex.h>
+#include <syscall.h>
+
+/* Mutex states.  A mutex only enters the kernel once some thread
+   has had to wait for it: locking an unlocked mutex and unlocking
+   one that nobody waits for are a single atomic instruction each. */
+enum {
+	MUTEX_UNLOCKED,             /* Free. */
+	MUTEX_LOCKED,               /* Held, nobody waiting. */
+	MUTEX_CONTENDED,            /* Held, maybe with waiters. */
+};
+
+/* Initializes M as unlocked. */
+void
+mutex_init (struct mutex *m) {
+	__atomic_store_n (&m->state, MUTEX_UNLOCKED, __ATOMIC_RELEASE);
+}
+
+/* Locks M, waiting for it in the kernel if it is held. */
+void
+mutex_lock (struct mutex *m) {
+	uint32_t c = MUTEX_UNLOCKED;
+
+	if (__atomic_compare_exchange_n (&m->state, &c, MUTEX_LOCKED, false,
+				__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	/* Mark M contended, so that its holder wakes us, and sleep
+	   until it is free.  Once we have waited we cannot tell
+	   whether others are still waiting, so we take M contended. */
+	if (c != MUTEX_CONTENDED)
+		c = __atomic_exchange_n (&m->state, MUTEX_CONTENDED, __ATOMIC_ACQUIRE);
+	while (c != MUTEX_UNLOCKED) {
+		futex_wait (&m->state, MUTEX_CONTENDED, -1);
+		c = __atomic_exchange_n (&m->state, MUTEX_CONTENDED, __ATOMIC_ACQUIRE);
+	}
+}
+
+/* Locks M if it is free.  Returns true if it did so. */
+bool
+mutex_trylock (struct mutex *m) {
+	uint32_t c = MUTEX_UNLOCKED;
+
+	return __atomic_compare_exchange_n (&m->state, &c, MUTEX_LOCKED, false,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Unlocks M, which the caller must hold, waking a waiter if
+   there may be one. */
+void
+mutex_unlock (struct mutex *m) {
+	if (__atomic_exchange_n (&m->state, MUTEX_UNLOCKED, __ATOMIC_RELEASE)
+			== MUTEX_CONTENDED)
+		futex_wake (&m->state, 1);
+}
@@ -0,0 +1,432 @@
+#include <stdio.h>
+#include <malloc.h>
+#include <mutex.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Buffered streams.
+
+   A stream collects what is written to it in a buffer and hands it
+   to write() only when the buffer fills, when fflush() is called,
+   or, for a line-buffered stream, at the end of each line; reads
+   fill the buffer a whole buffer at a time.  Each stream's buffer
+   size can be set with setvbuf() before it is first used.
+
+   stdout is line-buffered, so that each line reaches the console in
+   one write() but never later than the line is finished.  stdin is
+   unbuffered, since reading the console blocks until every byte
+   asked for has been typed.  exit() flushes every stream. */
+
+/* A buffered stream. */
+struct FILE {
+	int fd;                     /* File descriptor. */
+	int mode;                   /* _IOFBF, _IOLBF, or _IONBF. */
+	char *buf;                  /* Buffer, or null until first used. */
+	size_t size;                /* Size of BUF. */
+	size_t pos;                 /* Bytes of BUF written or read. */
+	size_t len;                 /* Bytes of BUF holding read-ahead. */
+	bool reading;               /* Does BUF hold read-ahead? */
+	bool own_buf;               /* Did we allocate BUF? */
+	bool allocated;             /* Did fdopen() allocate the stream? */
+	bool eof;                   /* Has a read hit end of file? */
+	bool error;                 /* Has a read or write failed? */
+	struct mutex lock;          /* Guards the members above. */
+	FILE *next;                 /* Next in the list of open streams. */
+};
+
+/* Auxiliary data for put_char(). */
+struct printf_aux {
+	FILE *s;                    /* Stream written to. */
+	int char_cnt;               /* Total characters written so far. */
+};
+
+static char stdout_buf[BUFSIZ];
+
+static FILE stdin_stream = {
+	.fd = STDIN_FILENO, .mode = _IONBF, .size = BUFSIZ,
+};
+static FILE stdout_stream = {
+	.fd = STDOUT_FILENO, .mode = _IOLBF, .buf = stdout_buf,
+	.size = sizeof stdout_buf, .next = &stdin_stream,
+};
+
+FILE *stdin = &stdin_stream;
+FILE *stdout = &stdout_stream;
+
+/* Open streams, linked through their NEXT members. */
+static FILE *streams = &stdout_stream;
+static struct mutex streams_lock;
+
+static bool start_writing (FILE *);
+static int flush (FILE *);
+static size_t put (FILE *, const void *, size_t);
+static size_t get (FILE *, void *, size_t);
+static void put_char (char, void *);
+
+/* Opens the file named NAME and returns a fully buffered stream
+   for it, or a null pointer on failure.  MODE is "r" to start at
+   the beginning, "w" to do so after creating the file if it does
+   not exist yet, or "a" to start at the end.  The file system
+   cannot shrink files, so "w" does not empty an existing file. */
+FILE *
+fopen (const char *name, const char *mode) {
+	int fd;
+
+	if (mode[0] == 'w')
+		create (name, 0);
+	else if (mode[0] != 'r' && mode[0] != 'a')
+		return NULL;
+	fd = open (name);
+	if (fd < 0)
+		return NULL;
+	if (mode[0] == 'a')
+		seek (fd, filesize (fd));
+	return fdopen (fd, mode);
+}
+
+/* Returns a fully buffered stream for file descriptor FD, which
+   fclose() will close, or a null pointer and closes FD if memory
+   is exhausted.  MODE is ignored. */
+FILE *
+fdopen (int fd, const char *mode UNUSED) {
+	FILE *s = calloc (1, sizeof *s);
+
+	if (s == NULL) {
+		close (fd);
+		return NULL;
+	}
+	s->fd = fd;
+	s->mode = _IOFBF;
+	s->size = BUFSIZ;
+	s->allocated = true;
+
+	mutex_lock (&streams_lock);
+	s->next = streams;
+	streams = s;
+	mutex_unlock (&streams_lock);
+	return s;
+}
+
+/* Flushes S, closes its file descriptor and frees it.  Returns 0,
+   or EOF if the flush failed. */
+int
+fclose (FILE *s) {
+	FILE **sp;
+	int result;
+
+	mutex_lock (&s->lock);
+	result = flush (s);
+	mutex_unlock (&s->lock);
+	close (s->fd);
+
+	mutex_lock (&streams_lock);
+	for (sp = &streams; *sp != NULL; sp = &(*sp)->next)
+		if (*sp == s) {
+			*sp = s->next;
+			break;
+		}
+	mutex_unlock (&streams_lock);
+
+	if (s->own_buf)
+		free (s->buf);
+	if (s->allocated)
+		free (s);
+	return result;
+}
+
+/* Sets S's buffering to MODE, which is _IOFBF to write only when
+   the buffer is full, _IOLBF to also write at the end of each line,
+   or _IONBF to also write at the end of each call.  S uses the SIZE
+   bytes at BUF as its buffer, or allocates SIZE bytes if BUF is
+   null, or BUFSIZ if SIZE is 0 too.  Call this before S is first
+   read or written.  Returns 0, or EOF if MODE is not valid. */
+int
+setvbuf (FILE *s, char *buf, int mode, size_t size) {
+	if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF)
+		return EOF;
+
+	mutex_lock (&s->lock);
+	flush (s);
+	if (s->own_buf)
+		free (s->buf);
+	s->mode = mode;
+	s->buf = size > 0 ? buf : NULL;
+	s->size = size > 0 ? size : BUFSIZ;
+	s->own_buf = false;
+	mutex_unlock (&s->lock);
+	return 0;
+}
+
+/* Writes everything buffered for S, or for every open stream if S
+   is null.  Returns 0, or EOF if a write failed. */
+int
+fflush (FILE *s) {
+	int result = 0;
+
+	if (s == NULL) {
+		mutex_lock (&streams_lock);
+		for (s = streams; s != NULL; s = s->next)
+			if (fflush (s) == EOF)
+				result = EOF;
+		mutex_unlock (&streams_lock);
+		return result;
+	}
+
+	mutex_lock (&s->lock);
+	result = flush (s);
+	mutex_unlock (&s->lock);
+	return result;
+}
+
+/* Reads up to CNT elements of SIZE bytes each from S into BUF.
+   Returns the number of whole elements read, which is less than
+   CNT only at end of file or on error. */
+size_t
+fread (void *buf, size_t size, size_t cnt, FILE *s) {
+	size_t n;
+
+	if (size == 0 || cnt == 0)
+		return 0;
+	mutex_lock (&s->lock);
+	n = get (s, buf, size * cnt);
+	mutex_unlock (&s->lock);
+	return n / size;
+}
+
+/* Writes CNT elements of SIZE bytes each from BUF to S.  Returns
+   the number of whole elements written, which is less than CNT only
+   on error. */
+size_t
+fwrite (const void *buf, size_t size, size_t cnt, FILE *s) {
+	size_t n;
+
+	if (size == 0 || cnt == 0)
+		return 0;
+	mutex_lock (&s->lock);
+	n = put (s, buf, size * cnt);
+	if (s->mode == _IONBF)
+		flush (s);
+	mutex_unlock (&s->lock);
+	return n / size;
+}
+
+/* Reads a byte from S and returns it, or EOF at end of file or on
+   error. */
+int
+fgetc (FILE *s) {
+	unsigned char c;
+
+	return fread (&c, 1, 1, s) == 1 ? c : EOF;
+}
+
+/* Writes C to S.  Returns C, or EOF on error. */
+int
+fputc (int c, FILE *s) {
+	char c2 = c;
+
+	return fwrite (&c2, 1, 1, s) == 1 ? (unsigned char) c : EOF;
+}
+
+/* Writes string STR to S.  Returns 0, or EOF on error. */
+int
+fputs (const char *str, FILE *s) {
+	size_t len = strlen (str);
+
+	return fwrite (str, 1, len, s) == len ? 0 : EOF;
+}
+
+/* Like printf(), but writes to S. */
+int
+fprintf (FILE *s, const char *format, ...) {
+	va_list args;
+	int retval;
+
+	va_start (args, format);
+	retval = vfprintf (s, format, args);
+	va_end (args);
+
+	return retval;
+}
+
+/* Like vprintf(), but writes to S.  Returns the number of
+   characters written, or EOF on error. */
+int
+vfprintf (FILE *s, const char *format, va_list args) {
+	struct printf_aux aux = {s, 0};
+	bool error;
+
+	mutex_lock (&s->lock);
+	if (start_writing (s)) {
+		__vprintf (format, args, put_char, &aux);
+		if (s->mode == _IONBF)
+			flush (s);
+	}
+	error = s->error;
+	mutex_unlock (&s->lock);
+
+	return error ? EOF : aux.char_cnt;
+}
+
+/* Returns the file descriptor of S. */
+int
+fileno (FILE *s) {
+	return s->fd;
+}
+
+/* Adds C to the buffer of the stream in AUX, for vfprintf(), which
+   has made sure there is one.  The caller holds the stream's
+   lock. */
+static void
+put_char (char c, void *aux_) {
+	struct printf_aux *aux = aux_;
+	FILE *s = aux->s;
+
+	if (s->pos >= s->size)
+		flush (s);
+	s->buf[s->pos++] = c;
+	if (c == '\n' && s->mode == _IOLBF)
+		flush (s);
+	aux->char_cnt++;
+}
+
+/* Readies S for writing: drops its read-ahead, if any, and gives it
+   a buffer if it has none yet.  Returns false if memory is
+   exhausted.  The caller holds S's lock. */
+static bool
+start_writing (FILE *s) {
+	if (s->reading)
+		flush (s);
+	if (s->buf == NULL) {
+		s->buf = malloc (s->size);
+		if (s->buf == NULL) {
+			s->error = true;
+			return false;
+		}
+		s->own_buf = true;
+	}
+	return true;
+}
+
+/* Writes out what S has buffered, or, if S has been reading, moves
+   its file position back over the read-ahead it drops.  Returns 0,
+   or EOF if a write failed, in which case the output is lost.  The
+   caller holds S's lock. */
+static int
+flush (FILE *s) {
+	size_t done = 0;
+
+	if (s->reading) {
+		if (s->len > s->pos)
+			seek (s->fd, tell (s->fd) - (s->len - s->pos));
+		s->pos = s->len = 0;
+		s->reading = false;
+		return 0;
+	}
+
+	while (done < s->pos) {
+		int n = write (s->fd, s->buf + done, s->pos - done);
+
+		if (n <= 0) {
+			s->error = true;
+			break;
+		}
+		done += n;
+	}
+	if (done < s->pos) {
+		s->pos = 0;
+		return EOF;
+	}
+	s->pos = 0;
+	return 0;
+}
+
+/* Writes the SIZE bytes at BUF to S, through its buffer unless
+   there are enough to fill it.  Returns the number of bytes
+   written.  The caller holds S's lock. */
+static size_t
+put (FILE *s, const void *buf, size_t size) {
+	const char *p = buf;
+	size_t done = 0;
+
+	if (!start_writing (s))
+		return 0;
+
+	if (size > s->size - s->pos) {
+		if (flush (s) == EOF)
+			return 0;
+		if (size >= s->size) {
+			while (done < size) {
+				int n = write (s->fd, p + done, size - done);
+
+				if (n <= 0) {
+					s->error = true;
+					break;
+				}
+				done += n;
+			}
+			return done;
+		}
+	}
+	memcpy (s->buf + s->pos, p, size);
+	s->pos += size;
+	if (s->mode == _IOLBF && memchr (p, '\n', size) != NULL)
+		flush (s);
+	return size;
+}
+
+/* Reads up to SIZE bytes from S into BUF, refilling S's buffer as
+   needed unless S is unbuffered or the rest would fill it anyway.
+   Returns the number of bytes read, which is less than SIZE only at
+   end of file or on error.  The caller holds S's lock. */
+static size_t
+get (FILE *s, void *buf, size_t size) {
+	char *p = buf;
+	size_t done = 0;
+
+	if (!s->reading) {
+		if (flush (s) == EOF)
+			return 0;
+		s->reading = true;
+	}
+	if (s == stdin)
+		fflush (stdout);
+
+	while (done < size) {
+		size_t avail = s->len - s->pos;
+		int n;
+
+		if (avail > 0) {
+			if (avail > size - done)
+				avail = size - done;
+			memcpy (p + done, s->buf + s->pos, avail);
+			s->pos += avail;
+			done += avail;
+			continue;
+		}
+		if (s->eof || s->error)
+			break;
+
+		if (s->mode == _IONBF || size - done >= s->size) {
+			n = read (s->fd, p + done, size - done);
+			if (n > 0)
+				done += n;
+		} else {
+			if (s->buf == NULL) {
+				s->buf = malloc (s->size);
+				if (s->buf == NULL) {
+					s->error = true;
+					break;
+				}
+				s->own_buf = true;
+			}
+			n = read (s->fd, s->buf, s->size);
+			s->pos = 0;
+			s->len = n > 0 ? n : 0;
+		}
+		if (n == 0)
+			s->eof = true;
+		else if (n < 0)
+			s->error = true;
+	}
+	return done;
+}
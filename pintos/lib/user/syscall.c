@@ -1,31 +1,29 @@
 #include <syscall.h>
 #include <stdint.h>
+#include <stdio.h>
 #include "../syscall-nr.h"
 
+/* Invokes system call NUM_ with arguments A1_ through A6_.  The
+   kernel preserves only the callee-saved registers: the
+   `syscall' instruction itself overwrites rcx and r11, and the
+   kernel clears the argument registers on return. */
 __attribute__((always_inline))
 static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 		uint64_t a3_, uint64_t a4_, uint64_t a5_, uint64_t a6_) {
-	int64_t ret;
-	register uint64_t *num asm ("rax") = (uint64_t *) num_;
-	register uint64_t *a1 asm ("rdi") = (uint64_t *) a1_;
-	register uint64_t *a2 asm ("rsi") = (uint64_t *) a2_;
-	register uint64_t *a3 asm ("rdx") = (uint64_t *) a3_;
-	register uint64_t *a4 asm ("r10") = (uint64_t *) a4_;
-	register uint64_t *a5 asm ("r8") = (uint64_t *) a5_;
-	register uint64_t *a6 asm ("r9") = (uint64_t *) a6_;
+	register uint64_t ret asm ("rax") = num_;
+	register uint64_t a1 asm ("rdi") = a1_;
+	register uint64_t a2 asm ("rsi") = a2_;
+	register uint64_t a3 asm ("rdx") = a3_;
+	register uint64_t a4 asm ("r10") = a4_;
+	register uint64_t a5 asm ("r8") = a5_;
+	register uint64_t a6 asm ("r9") = a6_;
 
 	__asm __volatile(
-			"mov %1, %%rax\n"
-			"mov %2, %%rdi\n"
-			"mov %3, %%rsi\n"
-			"mov %4, %%rdx\n"
-			"mov %5, %%r10\n"
-			"mov %6, %%r8\n"
-			"mov %7, %%r9\n"
 			"syscall\n"
-			: "=a" (ret)
-			: "g" (num), "g" (a1), "g" (a2), "g" (a3), "g" (a4), "g" (a5), "g" (a6)
-			: "cc", "memory");
+			: "+r" (ret), "+r" (a1), "+r" (a2), "+r" (a3), "+r" (a4), "+r" (a5),
+			  "+r" (a6)
+			:
+			: "rcx", "r11", "cc", "memory");
 	return ret;
 }
 
@@ -54,7 +52,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3) ( \
-		syscall(((uint64_t *) NUMBER), \
+		syscall(((uint64_t) NUMBER), \
 			((uint64_t) ARG0), \
 			((uint64_t) ARG1), \
 			((uint64_t) ARG2), \
@@ -74,8 +72,10 @@ halt (void) {
 	NOT_REACHED ();
 }
 
+/* Flushes every stream, then ends the process. */
 void
 exit (int status) {
+	fflush (NULL);
 	syscall1 (SYS_EXIT, status);
 	NOT_REACHED ();
 }
@@ -194,3 +194,164 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+bool
+iostat (pid_t pid, struct iostat *st) {
+	return syscall2 (SYS_IOSTAT, pid, st);
+}
+
+void
+null_syscall (void) {
+	syscall0 (SYS_NULL);
+}
+
+int64_t
+get_ticks (void) {
+	return syscall0 (SYS_GET_TICKS);
+}
+
+pid_t
+getpid (void) {
+	return (pid_t) syscall0 (SYS_GETPID);
+}
+
+struct uring *
+uring_setup (void) {
+	return (struct uring *) syscall0 (SYS_URING_SETUP);
+}
+
+int
+uring_enter (unsigned to_submit, unsigned min_complete) {
+	return syscall2 (SYS_URING_ENTER, to_submit, min_complete);
+}
+
+/* The child runs on our stack until it calls exec() or exit(), and
+   its calls overwrite whatever lies below our stack pointer, such
+   as the return address of an ordinary function.  So take the
+   return address off the stack first, into rdx, which the kernel
+   restores for both parent and child since vfork saves a full
+   register frame, and return through it. */
+__attribute__((naked)) pid_t
+vfork (const char *thread_name UNUSED) {
+	__asm __volatile (
+			"popq %%rdx\n"
+			"movq %0, %%rax\n"
+			"syscall\n"
+			"jmp *%%rdx\n"
+			: : "i" (SYS_VFORK));
+}
+
+pid_t
+spawn (const char *path, char *const argv[],
+       const struct spawn_action *actions) {
+	return (pid_t) syscall3 (SYS_SPAWN, path, argv, actions);
+}
+
+/* Where processes started from a template begin, like _start(),
+   with the function passed to template_mark() in MAIN. */
+static void
+template_start (int argc, char *argv[], int (*main) (int, char *[])) {
+	exit (main (argc, argv));
+}
+
+int
+template_mark (int (*main) (int argc, char *argv[])) {
+	return syscall2 (SYS_TEMPLATE_MARK, template_start, main);
+}
+
+pid_t
+spawn_from_template (pid_t pid, char *const argv[]) {
+	return (pid_t) syscall2 (SYS_SPAWN_TEMPLATE, pid, argv);
+}
+
+int
+pipe (int fds[2]) {
+	return syscall1 (SYS_PIPE, fds);
+}
+
+int
+shm_create (size_t size) {
+	return syscall1 (SYS_SHM_CREATE, size);
+}
+
+void *
+shm_map (int fd, void *addr) {
+	return (void *) syscall2 (SYS_SHM_MAP, fd, addr);
+}
+
+bool
+shm_unmap (void *addr) {
+	return syscall1 (SYS_SHM_UNMAP, addr);
+}
+
+int
+poll (struct pollfd *fds, size_t cnt, int64_t timeout) {
+	return syscall3 (SYS_POLL, fds, cnt, timeout);
+}
+
+int
+epoll_ctl (int op, int fd, struct epoll_event *ev) {
+	return syscall3 (SYS_EPOLL_CTL, op, fd, ev);
+}
+
+int
+epoll_wait (struct epoll_event *events, int max, int64_t timeout) {
+	return syscall3 (SYS_EPOLL_WAIT, events, max, timeout);
+}
+
+int
+futex_wait (uint32_t *addr, uint32_t expected, int64_t timeout) {
+	return syscall3 (SYS_FUTEX_WAIT, addr, expected, timeout);
+}
+
+int
+futex_wake (uint32_t *addr, int cnt) {
+	return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+/* Where thread_spawn()'s threads begin: runs FUNC and ends the
+   thread with its return value. */
+static void
+thread_start (int (*func) (void *), void *arg) {
+	exit (func (arg));
+}
+
+/* Starts a thread running FUNC (ARG) on the stack whose top is
+   STACK.  Returns its id, for thread_join(), or PID_ERROR. */
+pid_t
+thread_spawn (int (*func) (void *), void *arg, void *stack) {
+	/* Align as if thread_start had been called. */
+	uintptr_t sp = ((uintptr_t) stack & ~(uintptr_t) 15) - 8;
+
+	return (pid_t) syscall4 (SYS_THREAD_SPAWN, thread_start, sp, func, arg);
+}
+
+int
+thread_join (pid_t tid) {
+	return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+/* Makes %fs refer to the thread-local block at P, whose first
+   word must point to P itself for get_tls(). */
+int
+set_tls (void *p) {
+	return syscall1 (SYS_SET_TLS, p);
+}
+
+void *
+get_tls (void) {
+	void *p;
+
+	asm ("movq %%fs:0, %0" : "=r" (p));
+	return p;
+}
+
+int
+getrusage (int who, struct rusage *ru) {
+	return syscall2 (SYS_GETRUSAGE, who, ru);
+}
+
+void *
+sbrk (intptr_t increment) {
+	return (void *) syscall1 (SYS_SBRK, increment);
+}
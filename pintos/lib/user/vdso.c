@@ -0,0 +1,51 @@
+#include <syscall.h>
+#include <vdso.h>
+
+/* The kernel's shared data page.  The kernel changes it behind
+   our back, so every access must really read memory. */
+static const volatile struct vdso_data *const vdso =
+	(const volatile struct vdso_data *) VDSO_ADDR;
+
+static inline uint64_t
+rdtsc (void) {
+	uint32_t lo, hi;
+	asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+/* Returns the number of timer ticks since boot. */
+int64_t
+vdso_ticks (void) {
+	return vdso->ticks;
+}
+
+/* Returns the time since boot in nanoseconds, interpolating
+   between timer ticks with the time stamp counter. */
+uint64_t
+vdso_time_ns (void) {
+	uint64_t ns_per_tick, ticks, tick_tsc, tsc_per_tick, delta;
+	uint32_t seq;
+
+	/* Retry if a timer interrupt updated the page while we were
+	   reading it. */
+	do {
+		seq = vdso->seq;
+		ns_per_tick = 1000000000 / vdso->timer_freq;
+		ticks = vdso->ticks;
+		tick_tsc = vdso->tick_tsc;
+		tsc_per_tick = vdso->tsc_per_tick;
+	} while ((seq & 1) != 0 || seq != vdso->seq);
+
+	if (tsc_per_tick == 0)
+		return ticks * ns_per_tick;
+	delta = rdtsc () - tick_tsc;
+	if (delta >= tsc_per_tick)
+		delta = tsc_per_tick - 1;
+	return ticks * ns_per_tick + delta * ns_per_tick / tsc_per_tick;
+}
+
+/* Returns the pid of the calling process. */
+pid_t
+vdso_getpid (void) {
+	return vdso->tid;
+}
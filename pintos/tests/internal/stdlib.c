@@ -1,7 +1,9 @@
 /* Test program for sorting and searching in lib/stdlib.c.
 
    Attempts to test the sorting and searching functionality that
-   is not sufficiently tested elsewhere in Pintos.
+   is not sufficiently tested elsewhere in Pintos, including
+   sort() on elements of sizes that are not a multiple of a word
+   and on arrays full of duplicates, and radix_sort().
 
    This is not a test we will run on your submitted projects.
    It is here for completeness.
@@ -11,8 +13,10 @@
 #include <debug.h>
 #include <limits.h>
 #include <random.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/test.h"
 
 /* Maximum number of elements in an array that we will test. */
@@ -22,6 +26,8 @@ static void shuffle (int[], size_t);
 static int compare_ints (const void *, const void *);
 static void verify_order (const int[], size_t);
 static void verify_bsearch (const int[], size_t);
+static void test_sizes (void);
+static void test_radix (void);
 
 /* Test sorting and searching implementations. */
 void
@@ -51,11 +57,99 @@ test (void)
           verify_bsearch (values, cnt);
         }
     }
-  
   printf (" done\n");
+
+  test_sizes ();
+  test_radix ();
   printf ("stdlib: PASS\n");
 }
 
+/* Size of the elements that compare_elems() compares. */
+static size_t elem_size;
+
+/* Compares the ELEM_SIZE-byte elements at A and B like
+   memcmp(). */
+static int
+compare_elems (const void *a, const void *b, void *aux UNUSED) 
+{
+  return memcmp (a, b, elem_size);
+}
+
+/* Sorts arrays of random elements of various sizes, with many
+   duplicates, and checks that each comes out in order and holds
+   the same elements as before. */
+static void
+test_sizes (void) 
+{
+  static unsigned char array[MAX_CNT * 4];
+  static size_t histogram[4];
+  size_t cnt;
+
+  printf ("testing various size elements:");
+  for (elem_size = 1; elem_size <= 40; elem_size += elem_size < 9 ? 1 : 7)
+    {
+      printf (" %zu", elem_size);
+      for (cnt = 0; cnt * elem_size <= sizeof array; cnt = cnt * 3 / 2 + 1)
+        {
+          size_t i;
+
+          /* Bytes from 0 to 3 give plenty of equal elements. */
+          memset (histogram, 0, sizeof histogram);
+          for (i = 0; i < cnt * elem_size; i++)
+            histogram[array[i] = random_ulong () % 4]++;
+
+          sort (array, cnt, elem_size, compare_elems, NULL);
+          for (i = 1; i < cnt; i++)
+            ASSERT (compare_elems (array + (i - 1) * elem_size,
+                                   array + i * elem_size, NULL) <= 0);
+          for (i = 0; i < cnt * elem_size; i++)
+            histogram[array[i]]--;
+          for (i = 0; i < 4; i++)
+            ASSERT (histogram[i] == 0);
+        }
+    }
+  printf (" done\n");
+}
+
+/* Sorts arrays of random unsigned integers of every size that
+   radix_sort() handles, some with keys that share bytes, and
+   checks that each comes out in order. */
+static void
+test_radix (void) 
+{
+  static uint64_t array[MAX_CNT], tmp[MAX_CNT];
+  size_t size;
+
+  printf ("testing radix sort:");
+  for (size = 1; size <= 8; size *= 2)
+    {
+      size_t cnt;
+
+      printf (" %zu", size);
+      for (cnt = 0; cnt <= MAX_CNT; cnt = cnt * 2 + 1)
+        {
+          unsigned char *bytes = (unsigned char *) array;
+          uint64_t prev = 0;
+          size_t i;
+
+          /* Leave the high bytes of the larger keys 0, so that
+             radix_sort() has passes to skip. */
+          for (i = 0; i < cnt * size; i++)
+            bytes[i] = size < 4 || i % size < 2 ? random_ulong () : 0;
+          radix_sort (array, tmp, cnt, size);
+          for (i = 0; i < cnt; i++)
+            {
+              uint64_t key = 0;
+
+              memcpy (&key, bytes + i * size, size);
+              ASSERT (key >= prev);
+              prev = key;
+            }
+        }
+    }
+  printf (" done\n");
+}
+
 /* Shuffles the CNT elements in ARRAY into random order. */
 static void
 shuffle (int *array, size_t cnt) 
@@ -0,0 +1,253 @@
+/* Test program for the block and scanning functions in
+   lib/string.c.
+
+   Checks memcpy(), memmove() and memset() against simple byte
+   loops for every alignment of source and destination within a
+   word, for sizes on both sides of the point where they switch to
+   the string instructions, and for memmove() with blocks
+   overlapping by every distance up to a few words either way.
+
+   Also checks strlen(), strnlen(), strchr(), memchr(), strcmp()
+   and memcmp(), which work a word at a time, against byte loops
+   on random strings at every alignment, including strings that
+   differ or end at every position within a word.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+
+/* Size of the test buffers. */
+#define BUF_SIZE 4096
+
+/* Largest block copied or filled. */
+#define MAX_SIZE 1100
+
+/* Largest distance between overlapping memmove() blocks. */
+#define MAX_SHIFT 24
+
+static unsigned char buf[BUF_SIZE], expect[BUF_SIZE];
+
+static void randomize (void);
+static void verify (void);
+static void test_copy (size_t size, int src_ofs, int dst_ofs);
+static void test_move (size_t size, int shift);
+static void test_set (size_t size, int dst_ofs);
+static void test_scan (size_t len, int ofs);
+static void test_compare (size_t len, int a_ofs, int b_ofs);
+
+/* Test copying, filling, and scanning blocks of various sizes. */
+void
+test (void) 
+{
+  size_t size;
+
+  printf ("testing various size blocks:");
+  for (size = 0; size <= MAX_SIZE; size = size < 40 ? size + 1 : size * 5 / 4)
+    {
+      int ofs, shift;
+
+      printf (" %zu", size);
+      for (ofs = 0; ofs < 64; ofs++) 
+        {
+          test_copy (size, ofs % 8, ofs / 8);
+          test_set (size, ofs % 8);
+          test_scan (size, ofs % 8);
+          test_compare (size, ofs % 8, ofs / 8);
+        }
+      for (shift = -MAX_SHIFT; shift <= MAX_SHIFT; shift++)
+        test_move (size, shift);
+    }
+  
+  printf (" done\n");
+  printf ("string: PASS\n");
+}
+
+/* Fills BUF with random bytes and copies them to EXPECT. */
+static void
+randomize (void) 
+{
+  size_t i;
+
+  for (i = 0; i < BUF_SIZE; i++)
+    buf[i] = expect[i] = random_ulong ();
+}
+
+/* Verifies that BUF matches EXPECT, so that nothing outside the
+   block under test was touched. */
+static void
+verify (void) 
+{
+  size_t i;
+
+  for (i = 0; i < BUF_SIZE; i++)
+    ASSERT (buf[i] == expect[i]);
+}
+
+/* Checks memcpy() of SIZE bytes from offset SRC_OFS in the first
+   half of BUF to offset DST_OFS in the second half. */
+static void
+test_copy (size_t size, int src_ofs, int dst_ofs) 
+{
+  unsigned char *src = buf + src_ofs;
+  unsigned char *dst = buf + BUF_SIZE / 2 + dst_ofs;
+  size_t i;
+
+  randomize ();
+  for (i = 0; i < size; i++)
+    expect[BUF_SIZE / 2 + dst_ofs + i] = src[i];
+  ASSERT (memcpy (dst, src, size) == dst);
+  verify ();
+}
+
+/* Checks memmove() of SIZE bytes to SHIFT bytes away from where
+   they start, which may make the blocks overlap. */
+static void
+test_move (size_t size, int shift) 
+{
+  unsigned char *src = buf + MAX_SHIFT + 3;
+  unsigned char *dst = src + shift;
+  static unsigned char tmp[MAX_SIZE];
+  size_t i;
+
+  randomize ();
+  for (i = 0; i < size; i++)
+    tmp[i] = src[i];
+  for (i = 0; i < size; i++)
+    expect[MAX_SHIFT + 3 + shift + i] = tmp[i];
+  ASSERT (memmove (dst, src, size) == dst);
+  verify ();
+}
+
+/* Checks memset() of SIZE bytes at offset DST_OFS in BUF. */
+static void
+test_set (size_t size, int dst_ofs) 
+{
+  int value = random_ulong ();
+  size_t i;
+
+  randomize ();
+  for (i = 0; i < size; i++)
+    expect[dst_ofs + i] = value;
+  ASSERT (memset (buf + dst_ofs, value, size) == buf + dst_ofs);
+  verify ();
+}
+
+/* Returns a random byte other than 0. */
+static unsigned char
+random_nonzero (void) 
+{
+  return random_ulong () % 255 + 1;
+}
+
+/* Makes a string of LEN random nonzero bytes at S. */
+static void
+random_string (unsigned char *s, size_t len) 
+{
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    s[i] = random_nonzero ();
+  s[len] = '\0';
+}
+
+/* Returns the index of the first C in the SIZE bytes at S, or
+   SIZE if there is none. */
+static size_t
+find_byte (const unsigned char *s, unsigned char c, size_t size) 
+{
+  size_t i;
+
+  for (i = 0; i < size && s[i] != c; i++)
+    continue;
+  return i;
+}
+
+/* Returns -1, 0, or +1 as X is negative, zero, or positive. */
+static int
+sign (int x) 
+{
+  return x < 0 ? -1 : x > 0;
+}
+
+/* Returns the sign of the difference between the first SIZE bytes
+   at A and B, treating them as unsigned. */
+static int
+compare_bytes (const unsigned char *a, const unsigned char *b, size_t size) 
+{
+  for (; size > 0; size--, a++, b++)
+    if (*a != *b)
+      return *a < *b ? -1 : 1;
+  return 0;
+}
+
+/* Checks strlen(), strnlen(), strchr() and memchr() on a random
+   string of LEN bytes at offset OFS in BUF. */
+static void
+test_scan (size_t len, int ofs) 
+{
+  unsigned char *s = buf + ofs;
+  const char *str = (const char *) s;
+  size_t limits[] = {0, len / 2, len, len + 1, len + 9};
+  unsigned char c;
+  size_t i, at;
+
+  randomize ();
+  random_string (s, len);
+  for (i = 0; i <= len; i++)
+    expect[ofs + i] = s[i];
+
+  ASSERT (strlen (str) == len);
+  for (i = 0; i < sizeof limits / sizeof *limits; i++)
+    ASSERT (strnlen (str, limits[i]) == (len < limits[i] ? len : limits[i]));
+
+  /* Look for a byte in the string about half the time. */
+  c = len > 0 && random_ulong () % 2 ? s[random_ulong () % len]
+                                     : random_nonzero ();
+  at = find_byte (s, c, len);
+  ASSERT (strchr (str, c) == (at < len ? str + at : NULL));
+  ASSERT (strchr (str, '\0') == str + len);
+  ASSERT (memchr (s, c, len) == (at < len ? s + at : NULL));
+  ASSERT (memchr (s, c, at) == NULL);
+  ASSERT (memchr (s, '\0', len + 1) == s + len);
+  verify ();
+}
+
+/* Checks strcmp() and memcmp() on random strings of LEN bytes at
+   offset A_OFS in the first half of BUF and offset B_OFS in the
+   second half, first equal and then differing at one place. */
+static void
+test_compare (size_t len, int a_ofs, int b_ofs) 
+{
+  unsigned char *a = buf + a_ofs;
+  unsigned char *b = buf + BUF_SIZE / 2 + b_ofs;
+  size_t i;
+
+  randomize ();
+  random_string (a, len);
+  for (i = 0; i <= len; i++)
+    b[i] = expect[BUF_SIZE / 2 + b_ofs + i] = a[i];
+  for (i = 0; i <= len; i++)
+    expect[a_ofs + i] = a[i];
+
+  ASSERT (strcmp ((char *) a, (char *) b) == 0);
+  ASSERT (memcmp (a, b, len + 1) == 0);
+  if (len > 0)
+    {
+      /* A zero byte makes B the shorter string. */
+      i = random_ulong () % len;
+      b[i] = random_ulong ();
+      expect[BUF_SIZE / 2 + b_ofs + i] = b[i];
+      ASSERT (sign (strcmp ((char *) a, (char *) b))
+              == compare_bytes (a, b, find_byte (b, '\0', len) + 1));
+      ASSERT (sign (memcmp (a, b, len)) == compare_bytes (a, b, len));
+      ASSERT (sign (memcmp (b, a, len)) == compare_bytes (b, a, len));
+    }
+  verify ();
+}
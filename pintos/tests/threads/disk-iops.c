@@ -0,0 +1,116 @@
+/* Measures random single-sector read throughput on the file
+   system disk with 1, 4, and 32 reads outstanding at a time.
+
+   Each queue depth is modeled by that many kernel threads, each
+   of which reads random sectors back to back.  On an IDE disk
+   the channel lock serializes them, so IOPS should not change
+   with queue depth; on an AHCI disk with NCQ (run pintos with
+   --ahci) the reads overlap in the drive and IOPS should grow.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/threads_TESTS.  Run
+   it with "pintos -t --ahci -- run disk-iops" on a kernel built
+   with FILESYS. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "devices/disk.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Total reads issued at each queue depth. */
+#define READ_CNT 4096
+
+struct iops_test
+  {
+    struct disk *disk;          /* Disk under test. */
+    int reads_per_thread;       /* Reads each worker issues. */
+    struct semaphore done;      /* Up'd by each worker at exit. */
+  };
+
+struct iops_worker
+  {
+    struct iops_test *test;
+    unsigned seed;              /* Private random number state. */
+  };
+
+static void reader (void *);
+static void measure (struct disk *, int depth);
+
+void
+test_disk_iops (void)
+{
+  struct disk *d = disk_get (0, 1);
+
+  if (d == NULL)
+    fail ("no file system disk (0:1); need a FILESYS kernel");
+
+  msg ("file system disk: %"PRDSNu" sectors, %d random reads per run",
+       disk_size (d), READ_CNT);
+  measure (d, 1);
+  measure (d, 4);
+  measure (d, 32);
+}
+
+/* Issues READ_CNT random reads to D from DEPTH threads and
+   prints the resulting IOPS. */
+static void
+measure (struct disk *d, int depth)
+{
+  struct iops_test test;
+  struct iops_worker *workers;
+  int64_t start, elapsed;
+  int i;
+
+  test.disk = d;
+  test.reads_per_thread = READ_CNT / depth;
+  sema_init (&test.done, 0);
+
+  workers = malloc (sizeof *workers * depth);
+  if (workers == NULL)
+    fail ("out of memory");
+
+  start = timer_ticks ();
+  for (i = 0; i < depth; i++)
+    {
+      char name[24];
+
+      workers[i].test = &test;
+      workers[i].seed = 0x9e3779b9u * (i + 1);
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT, reader, &workers[i]);
+    }
+  for (i = 0; i < depth; i++)
+    sema_down (&test.done);
+  elapsed = timer_elapsed (start);
+  if (elapsed == 0)
+    elapsed = 1;
+
+  msg ("QD %2d: %d reads in %"PRId64" ticks, %"PRId64" IOPS",
+       depth, test.reads_per_thread * depth, elapsed,
+       (int64_t) test.reads_per_thread * depth * TIMER_FREQ / elapsed);
+  free (workers);
+}
+
+/* Reads random sectors from the test's disk. */
+static void
+reader (void *aux)
+{
+  struct iops_worker *w = aux;
+  struct iops_test *test = w->test;
+  disk_sector_t size = disk_size (test->disk);
+  void *buffer = malloc (DISK_SECTOR_SIZE);
+  int i;
+
+  if (buffer == NULL)
+    PANIC ("out of memory");
+  for (i = 0; i < test->reads_per_thread; i++)
+    {
+      w->seed = w->seed * 1103515245 + 12345;
+      disk_read (test->disk, w->seed % size, buffer);
+    }
+  free (buffer);
+  sema_up (&test->done);
+}
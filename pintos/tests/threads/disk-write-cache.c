@@ -0,0 +1,73 @@
+/* Compares disk write latency with the drive's write cache
+   turned off and on.
+
+   With the cache off, each disk_write() returns only once the
+   sector is on the media.  With it on, writes return as soon as
+   the drive has the data, and a single disk_flush() at the end
+   pays for durability.
+
+   This is a benchmark, not a pass/fail test, and it overwrites
+   the start of the swap disk (1:1).  Run it with
+   "pintos -t --swap-disk=4 -- run disk-write-cache" on a kernel
+   built with FILESYS. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "devices/disk.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+
+/* Sectors written in each run. */
+#define WRITE_CNT 1024
+
+static void measure (struct disk *, bool cache);
+
+void
+test_disk_write_cache (void)
+{
+  struct disk *d = disk_get (1, 1);
+
+  if (d == NULL)
+    fail ("no swap disk (1:1); need a FILESYS kernel");
+  if (disk_size (d) < WRITE_CNT)
+    fail ("swap disk smaller than %d sectors", WRITE_CNT);
+
+  if (!disk_set_write_cache (d, false))
+    fail ("disk has no controllable write cache");
+  measure (d, false);
+
+  disk_set_write_cache (d, true);
+  measure (d, true);
+}
+
+/* Writes WRITE_CNT sectors to D, followed by a flush, and prints
+   the average time per write and the time for the flush.  Times
+   come from timer ticks, so they are only as fine as the total
+   run is long. */
+static void
+measure (struct disk *d, bool cache)
+{
+  uint8_t *buffer = malloc (DISK_SECTOR_SIZE);
+  int64_t start, write_ticks, flush_ticks;
+  int i;
+
+  if (buffer == NULL)
+    fail ("out of memory");
+  memset (buffer, 0x5a, DISK_SECTOR_SIZE);
+
+  start = timer_ticks ();
+  for (i = 0; i < WRITE_CNT; i++)
+    disk_write (d, i, buffer);
+  write_ticks = timer_elapsed (start);
+
+  start = timer_ticks ();
+  disk_flush (d);
+  flush_ticks = timer_elapsed (start);
+
+  msg ("write cache %s: %"PRId64" us per write, flush %"PRId64" us",
+       cache ? "on" : "off",
+       write_ticks * 1000000 / TIMER_FREQ / WRITE_CNT,
+       flush_ticks * 1000000 / TIMER_FREQ);
+  free (buffer);
+}
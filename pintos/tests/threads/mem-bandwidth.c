@@ -0,0 +1,83 @@
+/* Measures the bandwidth of memcpy(), memset(), and memmove()
+   between overlapping blocks, which makes it copy downward, for
+   blocks from 8 bytes to 64 kB.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/threads_TESTS.  Run
+   it with "pintos -- run mem-bandwidth". */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "devices/timer.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Largest block. */
+#define MAX_SIZE 65536
+
+/* Bytes moved for each block size and function. */
+#define TOTAL (32 * 1024 * 1024)
+
+enum mem_op
+  {
+    OP_MEMCPY,
+    OP_MEMSET,
+    OP_MEMMOVE
+  };
+
+static uint8_t *src, *dst;
+
+/* Moves TOTAL bytes by calling OP on SIZE-byte blocks and returns
+   the bandwidth in MB/s. */
+static int64_t
+measure (enum mem_op op, size_t size)
+{
+  size_t i, cnt = TOTAL / size;
+  int64_t start, elapsed;
+
+  start = timer_ticks ();
+  for (i = 0; i < cnt; i++)
+    switch (op)
+      {
+      case OP_MEMCPY:
+        memcpy (dst, src, size);
+        break;
+      case OP_MEMSET:
+        memset (dst, i, size);
+        break;
+      case OP_MEMMOVE:
+        memmove (src + 8, src, size);
+        break;
+      }
+  elapsed = timer_elapsed (start);
+  if (elapsed == 0)
+    elapsed = 1;
+  return (int64_t) TOTAL * TIMER_FREQ / elapsed / 1000000;
+}
+
+void
+test_mem_bandwidth (void)
+{
+  size_t size;
+
+  /* One extra page leaves memmove() room to shift by 8 bytes. */
+  src = palloc_get_multiple (PAL_ASSERT, MAX_SIZE / PGSIZE + 1);
+  dst = palloc_get_multiple (PAL_ASSERT, MAX_SIZE / PGSIZE);
+  memset (src, 0x5a, MAX_SIZE);
+
+  msg ("%8s %10s %10s %10s", "size", "memcpy", "memset", "memmove");
+  for (size = 8; size <= MAX_SIZE; size *= 2)
+    {
+      int64_t cpy = measure (OP_MEMCPY, size);
+      int64_t set = measure (OP_MEMSET, size);
+      int64_t move = measure (OP_MEMMOVE, size);
+
+      msg ("%8zu %5"PRId64" MB/s %5"PRId64" MB/s %5"PRId64" MB/s",
+           size, cpy, set, move);
+    }
+
+  palloc_free_multiple (src, MAX_SIZE / PGSIZE + 1);
+  palloc_free_multiple (dst, MAX_SIZE / PGSIZE);
+}
@@ -0,0 +1,122 @@
+/* Measures how fast strlen(), strchr(), memchr(), strcmp(), and
+   memcmp() scan strings from 8 bytes to 4 kB long, alongside a
+   plain byte loop doing what strlen() does, for comparison.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/threads_TESTS.  Run
+   it with "pintos -- run str-scan". */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "devices/timer.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Longest string. */
+#define MAX_LEN 4096
+
+/* Bytes scanned for each length and function. */
+#define TOTAL (32 * 1024 * 1024)
+
+enum scan_op
+  {
+    OP_LOOP,
+    OP_STRLEN,
+    OP_STRCHR,
+    OP_MEMCHR,
+    OP_STRCMP,
+    OP_MEMCMP,
+    OP_CNT
+  };
+
+static const char *op_names[OP_CNT] =
+  {"loop", "strlen", "strchr", "memchr", "strcmp", "memcmp"};
+
+/* Two equal strings of MAX_LEN bytes each, at different
+   alignments. */
+static char *a, *b;
+
+/* Keeps the results from being optimized away. */
+static volatile size_t sink;
+
+/* Returns the length of S, a byte at a time. */
+static size_t
+byte_strlen (const char *s)
+{
+  const char *p;
+
+  for (p = s; *p != '\0'; p++)
+    continue;
+  return p - s;
+}
+
+/* Scans TOTAL bytes by calling OP on strings of LEN bytes and
+   returns the rate in MB/s. */
+static int64_t
+measure (enum scan_op op, size_t len)
+{
+  size_t i, cnt = TOTAL / len;
+  int64_t start, elapsed;
+
+  a[len] = b[len] = '\0';
+  start = timer_ticks ();
+  for (i = 0; i < cnt; i++)
+    switch (op)
+      {
+      case OP_LOOP:
+        sink = byte_strlen (a);
+        break;
+      case OP_STRLEN:
+        sink = strlen (a);
+        break;
+      case OP_STRCHR:
+        sink = (size_t) strchr (a, 'x');
+        break;
+      case OP_MEMCHR:
+        sink = (size_t) memchr (a, 'x', len);
+        break;
+      case OP_STRCMP:
+        sink = strcmp (a, b);
+        break;
+      case OP_MEMCMP:
+        sink = memcmp (a, b, len);
+        break;
+      default:
+        NOT_REACHED ();
+      }
+  elapsed = timer_elapsed (start);
+  a[len] = b[len] = 'a';
+  if (elapsed == 0)
+    elapsed = 1;
+  return (int64_t) cnt * len * TIMER_FREQ / elapsed / 1000000;
+}
+
+void
+test_str_scan (void)
+{
+  size_t len;
+  int op;
+
+  /* Leave room for the terminator and for misaligning B. */
+  a = palloc_get_multiple (PAL_ASSERT, 2);
+  b = (char *) palloc_get_multiple (PAL_ASSERT, 2) + 3;
+  memset (a, 'a', 2 * PGSIZE);
+  memset (b, 'a', 2 * PGSIZE - 3);
+
+  printf ("(str-scan) %6s", "length");
+  for (op = 0; op < OP_CNT; op++)
+    printf (" %11s", op_names[op]);
+  printf ("\n");
+  for (len = 8; len <= MAX_LEN; len *= 2)
+    {
+      printf ("(str-scan) %6zu", len);
+      for (op = 0; op < OP_CNT; op++)
+        printf (" %6"PRId64" MB/s", measure (op, len));
+      printf ("\n");
+    }
+
+  palloc_free_multiple (a, 2);
+  palloc_free_multiple (b - 3, 2);
+}
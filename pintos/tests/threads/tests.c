@@ -38,6 +38,10 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"disk-iops", test_disk_iops},
+    {"disk-write-cache", test_disk_write_cache},
+    {"mem-bandwidth", test_mem_bandwidth},
+    {"str-scan", test_str_scan},
   };
 
 static const char *test_name;
@@ -32,6 +32,10 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_disk_iops;
+extern test_func test_disk_write_cache;
+extern test_func test_mem_bandwidth;
+extern test_func test_str_scan;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,88 @@
+/* Measures the cost of the futex-based mutexes in lib/user, first
+   locked and unlocked by a single process, which never enters the
+   kernel, then shared through shared memory by PROC_CNT processes
+   that all increment one counter under it.  Checks that the
+   counter ends up right.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/futex-rate:futex-rate -- -q -f
+   run futex-rate". */
+
+#include <inttypes.h>
+#include <mutex.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Lock/unlock pairs by the lone process. */
+#define SOLO_ITERS 1000000
+
+/* Contending processes, and increments by each. */
+#define PROC_CNT 4
+#define PROC_ITERS 200000
+
+/* Where the shared page is mapped. */
+#define SHM_ADDR ((void *) 0x10000000)
+
+/* Contents of the shared page. */
+struct shared {
+  struct mutex mutex;
+  volatile uint64_t counter;
+};
+
+void
+test_main (void)
+{
+  struct shared *s;
+  struct mutex m;
+  pid_t pids[PROC_CNT];
+  uint64_t begin, ns;
+  int fd, i;
+
+  mutex_init (&m);
+  begin = vdso_time_ns ();
+  for (i = 0; i < SOLO_ITERS; i++)
+    {
+      mutex_lock (&m);
+      mutex_unlock (&m);
+    }
+  ns = vdso_time_ns () - begin;
+  msg ("uncontended: %"PRIu64" ns per lock and unlock",
+       ns / SOLO_ITERS);
+
+  fd = shm_create (sizeof *s);
+  CHECK (fd >= 0, "shm_create");
+  s = shm_map (fd, SHM_ADDR);
+  CHECK (s == SHM_ADDR, "shm_map");
+  mutex_init (&s->mutex);
+
+  begin = vdso_time_ns ();
+  for (i = 0; i < PROC_CNT; i++)
+    {
+      pids[i] = fork ("contender");
+      if (pids[i] == 0)
+        {
+          int j;
+
+          for (j = 0; j < PROC_ITERS; j++)
+            {
+              mutex_lock (&s->mutex);
+              s->counter++;
+              mutex_unlock (&s->mutex);
+            }
+          exit (0);
+        }
+      if (pids[i] == PID_ERROR)
+        fail ("fork failed");
+    }
+  for (i = 0; i < PROC_CNT; i++)
+    if (wait (pids[i]) != 0)
+      fail ("contender %d failed", i);
+  ns = vdso_time_ns () - begin;
+
+  if (s->counter != (uint64_t) PROC_CNT * PROC_ITERS)
+    fail ("counter is %"PRIu64", not %d", s->counter, PROC_CNT * PROC_ITERS);
+  msg ("%d processes contending: %"PRIu64" ns per lock and unlock",
+       PROC_CNT, ns / ((uint64_t) PROC_CNT * PROC_ITERS));
+}
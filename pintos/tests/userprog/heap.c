@@ -0,0 +1,120 @@
+/* Checks that sbrk() grows the heap with zeroed pages and shrinks
+   it, but not below its start; that anonymous mmap() places
+   mappings itself or where asked, refuses to overlap or to map
+   files, and that munmap() removes them; and that blocks from
+   malloc() and realloc() keep their contents, in a forked child
+   too. */
+
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+
+/* Where a mapping is placed on request, well clear of the program
+   and its stack. */
+#define MAP_ADDR ((unsigned char *) 0x10000000)
+
+/* Number of blocks allocated. */
+#define BLOCK_CNT 64
+
+static unsigned char *blocks[BLOCK_CNT];
+
+/* Returns the size of block I, which spans small and large sizes,
+   before and after it is grown. */
+static size_t
+block_size (int i, bool grown)
+{
+  return 1 + i * 97 + (grown ? 3000 : 0);
+}
+
+/* Fails unless the SIZE bytes at P are all BYTE. */
+static void
+check_bytes (const unsigned char *p, size_t size, int byte, const char *what)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != byte)
+      fail ("%s: byte %zu is %d, not %d", what, i, p[i], byte);
+}
+
+/* Checks every block still allocated. */
+static void
+check_blocks (void)
+{
+  int i;
+
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    check_bytes (blocks[i], block_size (i, false), i, "grown block");
+}
+
+void
+test_main (void)
+{
+  unsigned char *base, *p;
+  pid_t pid;
+  int i;
+
+  base = sbrk (0);
+  CHECK (base != (void *) -1, "sbrk (0)");
+  CHECK (sbrk (3 * PAGE) == base, "sbrk (3 pages)");
+  check_bytes (base, 3 * PAGE, 0, "new heap");
+  memset (base, 'h', 3 * PAGE);
+  CHECK (sbrk (-2 * PAGE) == base + 3 * PAGE, "sbrk (-2 pages)");
+  CHECK (sbrk (-2 * PAGE) == (void *) -1, "sbrk below the heap must fail");
+  check_bytes (base, PAGE, 'h', "remaining heap");
+  CHECK (sbrk (-PAGE) == base + PAGE, "sbrk (-1 page)");
+
+  p = mmap (NULL, 5 * PAGE, true, -1, 0);
+  CHECK (p != MAP_FAILED, "mmap 5 pages anywhere");
+  check_bytes (p, 5 * PAGE, 0, "anonymous mapping");
+  memset (p, 'm', 5 * PAGE);
+  CHECK (mmap (MAP_ADDR, 2 * PAGE, true, -1, 0) == MAP_ADDR,
+         "mmap 2 pages at 0x10000000");
+  CHECK (mmap (MAP_ADDR + PAGE, PAGE, true, -1, 0) == MAP_FAILED,
+         "overlapping mmap must fail");
+  CHECK (mmap (NULL, PAGE, true, 0, 0) == MAP_FAILED,
+         "mmap of a file descriptor must fail");
+  munmap (MAP_ADDR);
+  CHECK (mmap (MAP_ADDR, PAGE, true, -1, 0) == MAP_ADDR,
+         "mmap again after munmap");
+  munmap (MAP_ADDR);
+  check_bytes (p, 5 * PAGE, 'm', "first mapping");
+  munmap (p);
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      blocks[i] = malloc (block_size (i, false));
+      if (blocks[i] == NULL)
+        fail ("malloc (%zu) failed", block_size (i, false));
+      memset (blocks[i], i, block_size (i, false));
+    }
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    free (blocks[i]);
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    {
+      blocks[i] = realloc (blocks[i], block_size (i, true));
+      if (blocks[i] == NULL)
+        fail ("realloc (%zu) failed", block_size (i, true));
+    }
+  check_blocks ();
+  msg ("malloc and realloc kept their blocks");
+
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      check_blocks ();
+      free (blocks[1]);
+      exit (malloc (PAGE) != NULL ? 0 : -1);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork failed");
+  CHECK (wait (pid) == 0, "wait for child");
+  check_blocks ();
+
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    free (blocks[i]);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(heap) begin
+(heap) sbrk (0)
+(heap) sbrk (3 pages)
+(heap) sbrk (-2 pages)
+(heap) sbrk below the heap must fail
+(heap) sbrk (-1 page)
+(heap) mmap 5 pages anywhere
+(heap) mmap 2 pages at 0x10000000
+(heap) overlapping mmap must fail
+(heap) mmap of a file descriptor must fail
+(heap) mmap again after munmap
+(heap) malloc and realloc kept their blocks
+child: exit(0)
+(heap) wait for child
+(heap) end
+heap: exit(0)
+EOF
+pass;
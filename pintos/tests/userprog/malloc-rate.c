@@ -0,0 +1,135 @@
+/* Measures how many blocks per second malloc() and free() can
+   hand out and take back: small blocks freed at once, so that
+   each comes off a free list; batches of blocks of mixed small
+   sizes, most of them cut from the heap; and 64 kB blocks, which
+   free() caches, compared with calling mmap() and munmap()
+   directly.  Every block is written and checked.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/malloc-rate:malloc-rate -- -q
+   -f run malloc-rate". */
+
+#include <inttypes.h>
+#include <malloc.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Blocks in each batch. */
+#define BATCH 1024
+
+/* Size of a large block. */
+#define LARGE_SIZE 65536
+
+static unsigned char *blocks[BATCH];
+
+/* Reports CNT blocks allocated and freed in NS nanoseconds. */
+static void
+report (const char *how, uint64_t cnt, uint64_t ns)
+{
+  msg ("%s: %"PRIu64" blocks/s", how,
+       ns > 0 ? cnt * 1000000000 / ns : 0);
+}
+
+/* Stamps block P of SIZE bytes, the Ith, at both ends. */
+static void
+stamp (unsigned char *p, size_t size, int i)
+{
+  if (p == NULL)
+    fail ("allocating %zu bytes failed", size);
+  p[0] = p[size - 1] = i;
+}
+
+/* Fails unless block P of SIZE bytes carries the stamp for I. */
+static void
+check (const unsigned char *p, size_t size, int i)
+{
+  if (p[0] != (unsigned char) i || p[size - 1] != (unsigned char) i)
+    fail ("block %d was overwritten", i);
+}
+
+/* Allocates and frees CNT 32-byte blocks, one at a time. */
+static void
+measure_pairs (int cnt)
+{
+  uint64_t begin = vdso_time_ns ();
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      unsigned char *p = malloc (32);
+
+      stamp (p, 32, i);
+      check (p, 32, i);
+      free (p);
+    }
+  report ("32-byte pairs", cnt, vdso_time_ns () - begin);
+}
+
+/* Allocates ROUNDS batches of BATCH blocks of 16 to 2048 bytes,
+   freeing each batch once it is complete. */
+static void
+measure_batches (int rounds)
+{
+  uint64_t begin = vdso_time_ns ();
+  int r, i;
+
+  for (r = 0; r < rounds; r++)
+    {
+      for (i = 0; i < BATCH; i++)
+        {
+          size_t size = 16 + (i * 37 + r) % 2033;
+
+          blocks[i] = malloc (size);
+          stamp (blocks[i], size, i);
+        }
+      for (i = 0; i < BATCH; i++)
+        {
+          check (blocks[i], 16 + (i * 37 + r) % 2033, i);
+          free (blocks[i]);
+        }
+    }
+  report ("mixed small batches", (uint64_t) rounds * BATCH,
+          vdso_time_ns () - begin);
+}
+
+/* Allocates and frees CNT large blocks, by malloc() or, if
+   DIRECT, by mmap() and munmap(). */
+static void
+measure_large (int cnt, bool direct)
+{
+  uint64_t begin = vdso_time_ns ();
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      unsigned char *p;
+
+      if (direct)
+        {
+          p = mmap (NULL, LARGE_SIZE, true, -1, 0);
+          stamp (p == MAP_FAILED ? NULL : p, LARGE_SIZE, i);
+          check (p, LARGE_SIZE, i);
+          munmap (p);
+        }
+      else
+        {
+          p = malloc (LARGE_SIZE);
+          stamp (p, LARGE_SIZE, i);
+          check (p, LARGE_SIZE, i);
+          free (p);
+        }
+    }
+  report (direct ? "64 kB mmap/munmap" : "64 kB malloc/free", cnt,
+          vdso_time_ns () - begin);
+}
+
+void
+test_main (void)
+{
+  measure_pairs (100000);
+  measure_batches (64);
+  measure_large (1000, false);
+  measure_large (1000, true);
+}
@@ -0,0 +1,69 @@
+/* Opens "sample.txt" FILE_CNT times, which must hand out the
+   lowest free file descriptor each time, and checks that
+   descriptors closed in between are handed out again first.  Then
+   checks that a descriptor made by dup2() far above the others,
+   and the highest of the others, still work after fork(), each
+   moving only its own position. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 10000
+
+static int fds[FILE_CNT];
+
+/* Returns true if reading from FD yields the start of
+   sample.txt. */
+static bool
+read_start (int fd)
+{
+  char buf[16];
+
+  return (read (fd, buf, sizeof buf) == sizeof buf
+          && !memcmp (buf, sample, sizeof buf));
+}
+
+void
+test_main (void)
+{
+  int high, i;
+  pid_t pid;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      fds[i] = open ("sample.txt");
+      if (fds[i] < 2 || (i > 0 && fds[i] != fds[i - 1] + 1))
+        fail ("open #%d returned %d", i, fds[i]);
+    }
+  msg ("open \"sample.txt\" %d times", FILE_CNT);
+
+  close (fds[FILE_CNT / 2]);
+  close (fds[10]);
+  CHECK (open ("sample.txt") == fds[10],
+         "open reuses the lowest free descriptor");
+  CHECK (open ("sample.txt") == fds[FILE_CNT / 2],
+         "open reuses the next free descriptor");
+
+  high = fds[FILE_CNT - 1] + 5000;
+  CHECK (dup2 (fds[0], high) == high, "dup2 above the highest descriptor");
+  CHECK (read_start (high) && read_start (fds[0]),
+         "duplicates move independently");
+
+  pid = fork ("child");
+  if (pid == 0)
+    exit (read_start (fds[FILE_CNT - 1]) && read_start (high) ? 0 : 1);
+  if (pid == PID_ERROR)
+    fail ("fork failed");
+  if (wait (pid) != 0)
+    fail ("child could not read");
+  CHECK (read_start (fds[FILE_CNT - 1]),
+         "child's reads leave the parent's position alone");
+
+  for (i = 0; i < FILE_CNT; i++)
+    close (fds[i]);
+  close (high);
+  CHECK (open ("sample.txt") == fds[0], "open after closing everything");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) open "sample.txt" 10000 times
+(open-many) open reuses the lowest free descriptor
+(open-many) open reuses the next free descriptor
+(open-many) dup2 above the highest descriptor
+(open-many) duplicates move independently
+child: exit(0)
+(open-many) child's reads leave the parent's position alone
+(open-many) open after closing everything
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
@@ -0,0 +1,83 @@
+/* Measures the throughput of a pipe between two processes for
+   writes of 1 byte, 512 bytes and 64 kB.  The child reads
+   everything and checks that it arrived in order.  Also checks
+   that a read end sees end of file once every write end, the
+   child's included, is closed.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/pipe-rate:pipe-rate -- -q -f
+   run pipe-rate". */
+
+#include <inttypes.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Largest write, and the size of each read. */
+#define BUF_SIZE 65536
+
+static unsigned char buf[BUF_SIZE];
+
+/* Reads from FD until end of file, checking that byte I of the
+   stream is I % 251.  Returns the number of kB read, or -1 if the
+   data is wrong. */
+static int
+drain (int fd)
+{
+  size_t total = 0;
+  int n, i;
+
+  while ((n = read (fd, buf, sizeof buf)) > 0)
+    for (i = 0; i < n; i++, total++)
+      if (buf[i] != total % 251)
+        return -1;
+  return total / 1024;
+}
+
+/* Sends TOTAL bytes through a pipe to a child in writes of SIZE
+   bytes and reports the throughput. */
+static void
+measure (size_t size, size_t total)
+{
+  uint64_t begin, ns, bps;
+  int fds[2];
+  size_t done, i;
+  pid_t pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  pid = fork ("reader");
+  if (pid == 0)
+    {
+      close (fds[1]);
+      exit (drain (fds[0]));
+    }
+  if (pid == PID_ERROR)
+    fail ("fork failed");
+  close (fds[0]);
+
+  begin = vdso_time_ns ();
+  for (done = 0; done < total; done += size)
+    {
+      for (i = 0; i < size; i++)
+        buf[i] = (done + i) % 251;
+      if (write (fds[1], buf, size) != (int) size)
+        fail ("%zu-byte write failed", size);
+    }
+  close (fds[1]);
+  if (wait (pid) != (int) (total / 1024))
+    fail ("reader got the wrong data");
+  ns = vdso_time_ns () - begin;
+
+  bps = ns > 0 ? (uint64_t) total * 1000000000 / ns : 0;
+  msg ("%zu-byte writes: %"PRIu64".%02"PRIu64" MB/s", size,
+       bps / 1000000, bps / 10000 % 100);
+}
+
+void
+test_main (void)
+{
+  measure (1, 16 * 1024);
+  measure (512, 1024 * 1024);
+  measure (BUF_SIZE, 4 * 1024 * 1024);
+}
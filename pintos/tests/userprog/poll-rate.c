@@ -0,0 +1,137 @@
+/* Measures how fast a process can wait for one of many pipes to
+   become ready, with poll() and with an epoll interest set.  The
+   parent writes a byte to each of PIPE_CNT pipes in turn; the child
+   waits for whichever is ready, reads the byte, checks that it came
+   from the expected pipe, and answers through another pipe.  Also
+   checks that poll() times out when nothing is ready.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/poll-rate:poll-rate -- -q -f
+   run poll-rate". */
+
+#include <inttypes.h>
+#include <poll.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of pipes waited on. */
+#define PIPE_CNT 32
+
+/* Number of round trips in each measurement. */
+#define ROUNDS 2048
+
+static int fds[PIPE_CNT][2];
+static int answer[2];
+
+/* Waits with poll() for one of the pipes, and returns its index,
+   or -1 if there is not exactly one. */
+static int
+wait_poll (void)
+{
+  struct pollfd pfds[PIPE_CNT];
+  int i, which = -1;
+
+  for (i = 0; i < PIPE_CNT; i++)
+    {
+      pfds[i].fd = fds[i][0];
+      pfds[i].events = POLLIN;
+    }
+  if (poll (pfds, PIPE_CNT, -1) != 1)
+    return -1;
+  for (i = 0; i < PIPE_CNT; i++)
+    if (pfds[i].revents & POLLIN)
+      which = i;
+  return which;
+}
+
+/* Waits with epoll_wait() for one of the pipes, and returns its
+   index, or -1 if there is not exactly one. */
+static int
+wait_epoll (void)
+{
+  struct epoll_event ev;
+
+  if (epoll_wait (&ev, 1, -1) != 1 || !(ev.events & POLLIN))
+    return -1;
+  return ev.data;
+}
+
+/* Runs ROUNDS round trips with the child waiting through WAIT and
+   reports their rate. */
+static void
+measure (const char *how, int (*wait_fn) (void))
+{
+  uint64_t begin, ns, rate;
+  char c;
+  int i, r;
+  pid_t pid;
+
+  for (i = 0; i < PIPE_CNT; i++)
+    CHECK (pipe (fds[i]) == 0, "pipe %d", i);
+  CHECK (pipe (answer) == 0, "answer pipe");
+
+  pid = fork ("waiter");
+  if (pid == 0)
+    {
+      if (wait_fn == wait_epoll)
+        for (i = 0; i < PIPE_CNT; i++)
+          {
+            struct epoll_event ev = {POLLIN, i};
+
+            if (epoll_ctl (EPOLL_CTL_ADD, fds[i][0], &ev) != 0)
+              exit (-1);
+          }
+      for (r = 0; r < ROUNDS; r++)
+        {
+          int which = wait_fn ();
+
+          if (which != r % PIPE_CNT || read (fds[which][0], &c, 1) != 1)
+            exit (-1);
+          write (answer[1], &c, 1);
+        }
+      exit (0);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork failed");
+
+  begin = vdso_time_ns ();
+  for (r = 0; r < ROUNDS; r++)
+    if (write (fds[r % PIPE_CNT][1], &c, 1) != 1
+        || read (answer[0], &c, 1) != 1)
+      fail ("waiter failed in round %d", r);
+  if (wait (pid) != 0)
+    fail ("waiter failed");
+  ns = vdso_time_ns () - begin;
+
+  rate = ns > 0 ? (uint64_t) ROUNDS * 1000000000 / ns : 0;
+  msg ("%s over %d pipes: %"PRIu64" round trips/s", how, PIPE_CNT, rate);
+
+  for (i = 0; i < PIPE_CNT; i++)
+    {
+      close (fds[i][0]);
+      close (fds[i][1]);
+    }
+  close (answer[0]);
+  close (answer[1]);
+}
+
+void
+test_main (void)
+{
+  struct pollfd pfd;
+  int64_t begin;
+
+  CHECK (pipe (answer) == 0, "pipe");
+  pfd.fd = answer[0];
+  pfd.events = POLLIN;
+  begin = get_ticks ();
+  CHECK (poll (&pfd, 1, 10) == 0, "poll times out on an empty pipe");
+  CHECK (get_ticks () - begin >= 10, "poll waits out its timeout");
+  close (answer[0]);
+  close (answer[1]);
+
+  measure ("poll", wait_poll);
+  measure ("epoll", wait_epoll);
+}
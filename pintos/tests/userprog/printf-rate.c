@@ -0,0 +1,103 @@
+/* Measures how many system calls it takes to print 1 MiB of short
+   formatted lines, and how fast it goes, with hprintf(), which
+   writes each call's output at once, and with fprintf() on a
+   stream that is line-buffered or fully buffered with buffers of
+   various sizes.  The output goes through a pipe to a child,
+   which checks that all of it arrives.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/printf-rate:printf-rate -- -q
+   -f run printf-rate". */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Bytes printed in each measurement. */
+#define TOTAL (1024 * 1024)
+
+/* Length of each line printed. */
+#define LINE_LEN 32
+
+static char buf[65536];
+
+/* Prints line I, of LINE_LEN bytes, to S, or with hprintf() to FD
+   if S is null. */
+static void
+print_line (FILE *s, int fd, int i)
+{
+  if (s != NULL)
+    fprintf (s, "%6d %08x the quick fox\n", i, i * 2654435761u);
+  else
+    hprintf (fd, "%6d %08x the quick fox\n", i, i * 2654435761u);
+}
+
+/* Prints TOTAL bytes through a pipe, on a stream buffered as MODE
+   with a SIZE-byte buffer, or with hprintf() if SIZE is 0, and
+   reports the system calls and the time it took. */
+static void
+measure (const char *how, int mode, size_t size)
+{
+  struct rusage before, after;
+  uint64_t begin, ns, bps, calls;
+  FILE *s = NULL;
+  int fds[2], i;
+  pid_t pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  pid = fork ("drain");
+  if (pid == 0)
+    {
+      size_t total = 0;
+      int n;
+
+      close (fds[1]);
+      while ((n = read (fds[0], buf, sizeof buf)) > 0)
+        total += n;
+      exit (total == TOTAL ? 0 : -1);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork failed");
+  close (fds[0]);
+
+  if (size > 0)
+    {
+      s = fdopen (fds[1], "w");
+      CHECK (s != NULL && setvbuf (s, NULL, mode, size) == 0, "fdopen");
+    }
+
+  getrusage (RUSAGE_SELF, &before);
+  begin = vdso_time_ns ();
+  for (i = 0; i < TOTAL / LINE_LEN; i++)
+    print_line (s, fds[1], i);
+  if (s != NULL)
+    fflush (s);
+  ns = vdso_time_ns () - begin;
+  getrusage (RUSAGE_SELF, &after);
+
+  if (s != NULL)
+    fclose (s);
+  else
+    close (fds[1]);
+  if (wait (pid) != 0)
+    fail ("%s: output went missing", how);
+
+  /* Leave out the getrusage() call that took BEFORE. */
+  calls = after.syscalls - before.syscalls - 1;
+  bps = ns > 0 ? (uint64_t) TOTAL * 1000000000 / ns : 0;
+  msg ("%s: %"PRIu64" syscalls/MiB, %"PRIu64".%02"PRIu64" MB/s", how,
+       calls, bps / 1000000, bps / 10000 % 100);
+}
+
+void
+test_main (void)
+{
+  measure ("hprintf", 0, 0);
+  measure ("line-buffered", _IOLBF, BUFSIZ);
+  measure ("512-byte buffer", _IOFBF, 512);
+  measure ("4 kB buffer", _IOFBF, 4096);
+  measure ("64 kB buffer", _IOFBF, 65536);
+}
@@ -0,0 +1,85 @@
+/* Checks that getrusage() counts the caller's CPU time, I/O and
+   resident pages, and that a child's usage, including the page
+   fault that kills it, is added to RUSAGE_CHILDREN once the child
+   has been waited for. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Timer ticks to spend in user mode at a time. */
+#define SPIN_TICKS 10
+
+static char buf[512];
+
+/* Busy-waits in user mode for TICKS timer ticks. */
+static void
+spin (int ticks)
+{
+  int64_t start = vdso_ticks ();
+
+  while (vdso_ticks () < start + ticks)
+    continue;
+}
+
+void
+test_main (void)
+{
+  struct rusage before, after, children;
+  pid_t pid;
+  int fd;
+
+  CHECK (getrusage (RUSAGE_SELF, &before) == 0, "getrusage (RUSAGE_SELF)");
+  CHECK (getrusage (42, &after) == -1, "getrusage (42) must fail");
+  CHECK (before.max_rss > 0, "resident pages are counted");
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  memset (buf, 'x', sizeof buf);
+  spin (SPIN_TICKS);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"data\"");
+  seek (fd, 0);
+  CHECK (read (fd, buf, sizeof buf) == sizeof buf, "read \"data\"");
+
+  CHECK (getrusage (RUSAGE_SELF, &after) == 0, "getrusage (RUSAGE_SELF)");
+  if (after.user_ticks <= before.user_ticks)
+    fail ("user ticks did not grow");
+  if (after.bytes_written < before.bytes_written + sizeof buf
+      || after.bytes_read < before.bytes_read + sizeof buf)
+    fail ("bytes read or written were not counted");
+
+  CHECK (getrusage (RUSAGE_CHILDREN, &children) == 0,
+         "getrusage (RUSAGE_CHILDREN)");
+  if (children.user_ticks != 0 || children.bytes_written != 0)
+    fail ("children's usage is not empty before any wait");
+
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      spin (SPIN_TICKS);
+      write (fd, buf, sizeof buf);
+      *(volatile int *) NULL = 42;
+      fail ("should have died");
+    }
+  if (pid == PID_ERROR)
+    fail ("fork failed");
+  if (wait (pid) != -1)
+    fail ("child should have been killed");
+
+  CHECK (getrusage (RUSAGE_CHILDREN, &children) == 0,
+         "getrusage (RUSAGE_CHILDREN) after wait");
+  if (children.user_ticks == 0)
+    fail ("child's user ticks were not counted");
+  if (children.bytes_written < sizeof buf)
+    fail ("child's writes were not counted");
+  if (children.nonpresent_faults == 0)
+    fail ("child's page fault was not counted");
+  if (children.max_rss == 0)
+    fail ("child's resident pages were not counted");
+
+  getrusage (RUSAGE_SELF, &after);
+  if (after.voluntary_switches <= before.voluntary_switches)
+    fail ("waiting for the child was not a voluntary switch");
+  close (fd);
+}
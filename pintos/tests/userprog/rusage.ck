@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rusage) begin
+(rusage) getrusage (RUSAGE_SELF)
+(rusage) getrusage (42) must fail
+(rusage) resident pages are counted
+(rusage) create "data"
+(rusage) open "data"
+(rusage) write "data"
+(rusage) read "data"
+(rusage) getrusage (RUSAGE_SELF)
+(rusage) getrusage (RUSAGE_CHILDREN)
+child: exit(-1)
+(rusage) getrusage (RUSAGE_CHILDREN) after wait
+(rusage) end
+rusage: exit(0)
+EOF
+pass;
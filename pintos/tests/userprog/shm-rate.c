@@ -0,0 +1,169 @@
+/* Measures how fast two processes can hand each other 64 kB
+   buffers, first by filling a shared memory region and passing a
+   1-byte token through a pipe, then by writing the whole buffer
+   through the pipe.  In both cases the child checks every byte it
+   receives.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/shm-rate:shm-rate -- -q -f
+   run shm-rate". */
+
+#include <inttypes.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Size of each buffer handed over. */
+#define BUF_SIZE 65536
+
+/* Number of buffers handed over in each measurement. */
+#define ROUNDS 256
+
+/* Where the shared region is mapped, well clear of the program
+   and its stack. */
+#define SHM_ADDR ((unsigned char *) 0x10000000)
+
+static unsigned char buf[BUF_SIZE];
+
+/* Fills BUF_SIZE bytes at P with the pattern for round R. */
+static void
+fill (unsigned char *p, int r)
+{
+  size_t i;
+
+  for (i = 0; i < BUF_SIZE; i++)
+    p[i] = (i + r) % 251;
+}
+
+/* Returns true if the BUF_SIZE bytes at P hold the pattern for
+   round R. */
+static bool
+check (const unsigned char *p, int r)
+{
+  size_t i;
+
+  for (i = 0; i < BUF_SIZE; i++)
+    if (p[i] != (i + r) % 251)
+      return false;
+  return true;
+}
+
+/* Reports the throughput of ROUNDS buffers moved in NS
+   nanoseconds. */
+static void
+report (const char *how, uint64_t ns)
+{
+  uint64_t bps = ns > 0 ? (uint64_t) ROUNDS * BUF_SIZE * 1000000000 / ns : 0;
+
+  msg ("%s: %"PRIu64".%02"PRIu64" MB/s", how,
+       bps / 1000000, bps / 10000 % 100);
+}
+
+/* Hands buffers over in shared memory, with a token through
+   TO_CHILD to say a buffer is ready and one back through
+   TO_PARENT to say it has been checked. */
+static void
+measure_shm (void)
+{
+  int to_child[2], to_parent[2];
+  uint64_t begin;
+  char token;
+  int fd, r;
+  pid_t pid;
+
+  fd = shm_create (BUF_SIZE);
+  CHECK (fd >= 0, "shm_create");
+  CHECK (shm_map (fd, SHM_ADDR) == SHM_ADDR, "shm_map");
+  CHECK (pipe (to_child) == 0 && pipe (to_parent) == 0, "pipe");
+
+  pid = fork ("shm-reader");
+  if (pid == 0)
+    {
+      for (r = 0; r < ROUNDS; r++)
+        {
+          if (read (to_child[0], &token, 1) != 1 || !check (SHM_ADDR, r))
+            exit (-1);
+          write (to_parent[1], &token, 1);
+        }
+      exit (0);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork failed");
+
+  begin = vdso_time_ns ();
+  for (r = 0; r < ROUNDS; r++)
+    {
+      fill (SHM_ADDR, r);
+      write (to_child[1], &token, 1);
+      if (read (to_parent[0], &token, 1) != 1)
+        fail ("reader got the wrong data in round %d", r);
+    }
+  if (wait (pid) != 0)
+    fail ("reader failed");
+  report ("shared memory", vdso_time_ns () - begin);
+
+  CHECK (shm_unmap (SHM_ADDR), "shm_unmap");
+  close (fd);
+  close (to_child[0]);
+  close (to_child[1]);
+  close (to_parent[0]);
+  close (to_parent[1]);
+}
+
+/* Hands buffers over by writing them through a pipe, with a token
+   back through another to say each has been checked. */
+static void
+measure_pipe (void)
+{
+  int to_child[2], to_parent[2];
+  uint64_t begin;
+  char token;
+  int r, n;
+  pid_t pid;
+
+  CHECK (pipe (to_child) == 0 && pipe (to_parent) == 0, "pipe");
+
+  pid = fork ("pipe-reader");
+  if (pid == 0)
+    {
+      for (r = 0; r < ROUNDS; r++)
+        {
+          int got;
+
+          for (got = 0; got < BUF_SIZE; got += n)
+            if ((n = read (to_child[0], buf + got, BUF_SIZE - got)) <= 0)
+              exit (-1);
+          if (!check (buf, r))
+            exit (-1);
+          write (to_parent[1], &token, 1);
+        }
+      exit (0);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork failed");
+
+  begin = vdso_time_ns ();
+  for (r = 0; r < ROUNDS; r++)
+    {
+      fill (buf, r);
+      if (write (to_child[1], buf, BUF_SIZE) != BUF_SIZE
+          || read (to_parent[0], &token, 1) != 1)
+        fail ("reader got the wrong data in round %d", r);
+    }
+  if (wait (pid) != 0)
+    fail ("reader failed");
+  report ("pipe", vdso_time_ns () - begin);
+
+  close (to_child[0]);
+  close (to_child[1]);
+  close (to_parent[0]);
+  close (to_parent[1]);
+}
+
+void
+test_main (void)
+{
+  measure_shm ();
+  measure_pipe ();
+}
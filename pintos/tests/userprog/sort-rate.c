@@ -0,0 +1,156 @@
+/* Measures sorting 128 kB of random bytes, the workload of the VM
+   tests child-qsort and child-sort, and 32768 random 32-bit
+   integers.  Sorts each with qsort(), counting
+   the comparisons it makes, and with radix_sort(), and the bytes
+   also with child-sort's counting sort.  Every result is
+   checked.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/sort-rate:sort-rate -- -q -f
+   run sort-rate". */
+
+#include <inttypes.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of bytes and of integers sorted. */
+#define BYTE_CNT (128 * 1024)
+#define INT_CNT 32768
+
+static unsigned char bytes[BYTE_CNT], sorted_bytes[BYTE_CNT];
+static uint32_t ints[INT_CNT], sorted_ints[INT_CNT];
+static uint64_t tmp[BYTE_CNT / sizeof (uint64_t)];
+
+/* Comparisons made by the comparison functions below. */
+static uint64_t compare_cnt;
+
+static int
+compare_uchars (const void *a_, const void *b_)
+{
+  const unsigned char *a = a_;
+  const unsigned char *b = b_;
+
+  compare_cnt++;
+  return *a < *b ? -1 : *a > *b;
+}
+
+static int
+compare_uints (const void *a_, const void *b_)
+{
+  const uint32_t *a = a_;
+  const uint32_t *b = b_;
+
+  compare_cnt++;
+  return *a < *b ? -1 : *a > *b;
+}
+
+/* Sorts the bytes by counting them, as child-sort does. */
+static void
+counting_sort (unsigned char *buf, size_t size)
+{
+  static size_t histogram[256];
+  unsigned char *p = buf;
+  size_t i;
+
+  memset (histogram, 0, sizeof histogram);
+  for (i = 0; i < size; i++)
+    histogram[buf[i]]++;
+  for (i = 0; i < 256; i++)
+    {
+      size_t j = histogram[i];
+      while (j-- > 0)
+        *p++ = i;
+    }
+}
+
+/* Reports sorting CNT elements in NS nanoseconds, with
+   COMPARE_CNT comparisons if COUNTED. */
+static void
+report (const char *how, size_t cnt, uint64_t ns, bool counted)
+{
+  if (counted)
+    msg ("%s: %"PRIu64" us, %"PRIu64" comparisons", how, ns / 1000,
+         compare_cnt);
+  else
+    msg ("%s: %"PRIu64" us", how, ns / 1000);
+  msg ("%s: %"PRIu64" elements/s", how,
+       ns > 0 ? (uint64_t) cnt * 1000000000 / ns : 0);
+}
+
+/* Fails unless the CNT elements of SIZE bytes at ARRAY are in
+   nondecreasing order by COMPARE. */
+static void
+check_order (const char *how, const void *array, size_t cnt, size_t size,
+             int (*compare) (const void *, const void *))
+{
+  const unsigned char *p = array;
+  size_t i;
+
+  for (i = 1; i < cnt; i++)
+    if (compare (p + (i - 1) * size, p + i * size) > 0)
+      fail ("%s: elements %zu and %zu out of order", how, i - 1, i);
+}
+
+/* Sorts a copy of the bytes with each method. */
+static void
+measure_bytes (void)
+{
+  uint64_t begin;
+
+  memcpy (sorted_bytes, bytes, BYTE_CNT);
+  begin = vdso_time_ns ();
+  counting_sort (sorted_bytes, BYTE_CNT);
+  report ("bytes, counting sort", BYTE_CNT, vdso_time_ns () - begin, false);
+  check_order ("counting sort", sorted_bytes, BYTE_CNT, 1, compare_uchars);
+
+  memcpy (sorted_bytes, bytes, BYTE_CNT);
+  begin = vdso_time_ns ();
+  radix_sort (sorted_bytes, tmp, BYTE_CNT, 1);
+  report ("bytes, radix_sort()", BYTE_CNT, vdso_time_ns () - begin, false);
+  check_order ("radix_sort()", sorted_bytes, BYTE_CNT, 1, compare_uchars);
+
+  memcpy (sorted_bytes, bytes, BYTE_CNT);
+  compare_cnt = 0;
+  begin = vdso_time_ns ();
+  qsort (sorted_bytes, BYTE_CNT, 1, compare_uchars);
+  report ("bytes, qsort()", BYTE_CNT, vdso_time_ns () - begin, true);
+  check_order ("qsort()", sorted_bytes, BYTE_CNT, 1, compare_uchars);
+}
+
+/* Sorts a copy of the integers with each method. */
+static void
+measure_ints (void)
+{
+  uint64_t begin;
+
+  memcpy (sorted_ints, ints, sizeof ints);
+  begin = vdso_time_ns ();
+  radix_sort (sorted_ints, tmp, INT_CNT, sizeof *ints);
+  report ("ints, radix_sort()", INT_CNT, vdso_time_ns () - begin, false);
+  check_order ("radix_sort()", sorted_ints, INT_CNT, sizeof *ints,
+               compare_uints);
+
+  memcpy (sorted_ints, ints, sizeof ints);
+  compare_cnt = 0;
+  begin = vdso_time_ns ();
+  qsort (sorted_ints, INT_CNT, sizeof *ints, compare_uints);
+  report ("ints, qsort()", INT_CNT, vdso_time_ns () - begin, true);
+  check_order ("qsort()", sorted_ints, INT_CNT, sizeof *ints, compare_uints);
+}
+
+void
+test_main (void)
+{
+  random_init (0);
+  random_bytes (bytes, sizeof bytes);
+  random_bytes (ints, sizeof ints);
+
+  measure_bytes ();
+  measure_ints ();
+}
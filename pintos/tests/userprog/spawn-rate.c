@@ -0,0 +1,134 @@
+/* Measures how many child processes per second can be started
+   and waited for with fork() and exec(), with vfork() and exec(),
+   and with spawn().  Each child is child-simple.  Also checks that
+   spawn() carries out its file actions, including redirecting the
+   child's output into a pipe.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/spawn-rate:spawn-rate -p
+   tests/userprog/child-simple:child-simple -- -q -f run
+   spawn-rate". */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Children started per method. */
+#define CHILD_CNT 20
+
+/* Exit code of child-simple. */
+#define CHILD_EXIT 81
+
+static char *const child_argv[] = {"child-simple", NULL};
+
+static pid_t
+start_fork (void)
+{
+  pid_t pid = fork ("child-simple");
+
+  if (pid == 0)
+    {
+      exec ("child-simple");
+      exit (-1);
+    }
+  return pid;
+}
+
+static pid_t
+start_vfork (void)
+{
+  pid_t pid = vfork ("child-simple");
+
+  if (pid == 0)
+    {
+      exec ("child-simple");
+      exit (-1);
+    }
+  return pid;
+}
+
+static pid_t
+start_spawn (void)
+{
+  return spawn ("child-simple", child_argv, NULL);
+}
+
+/* Starts and reaps CHILD_CNT children with START and reports the
+   rate at which it did so. */
+static void
+measure (const char *method, pid_t (*start) (void))
+{
+  uint64_t begin, ns;
+  int i;
+
+  begin = vdso_time_ns ();
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid_t pid = start ();
+
+      if (pid == PID_ERROR)
+        fail ("%s: could not start child %d", method, i);
+      if (wait (pid) != CHILD_EXIT)
+        fail ("%s: child %d exited with the wrong status", method, i);
+    }
+  ns = vdso_time_ns () - begin;
+
+  msg ("%s: %"PRIu64" processes/s", method,
+       ns > 0 ? (uint64_t) CHILD_CNT * 1000000000 / ns : 0);
+}
+
+void
+test_main (void)
+{
+  struct spawn_action actions[] =
+    {
+      {SPAWN_CLOSE, 0, NULL, 0},
+      {SPAWN_OPEN, 0, "child-simple", 0},
+      {SPAWN_END, 0, NULL, 0},
+    };
+  struct spawn_action redirect[] =
+    {
+      {SPAWN_DUP2, STDOUT_FILENO, NULL, 0},
+      {SPAWN_CLOSE, 0, NULL, 0},
+      {SPAWN_CLOSE, 0, NULL, 0},
+      {SPAWN_END, 0, NULL, 0},
+    };
+  static const char expected[] = "(child-simple) run\n";
+  char buf[sizeof expected];
+  int fd, fds[2];
+
+  /* A closed descriptor that the child is asked to close makes
+     spawn() fail, and opening it again in the child leaves it
+     closed in the parent. */
+  CHECK ((fd = open ("child-simple")) > 1, "open \"child-simple\"");
+  actions[0].fd = actions[1].fd = fd + 1;
+  CHECK (spawn ("child-simple", child_argv, actions) == PID_ERROR,
+         "spawn with bad close fails");
+  actions[0].fd = actions[1].fd = fd;
+  CHECK (wait (spawn ("child-simple", child_argv, actions)) == CHILD_EXIT,
+         "spawn with file actions");
+  CHECK (filesize (fd) > 0, "parent's fd still open");
+  close (fd);
+  CHECK (spawn ("no-such-file", NULL, NULL) == PID_ERROR,
+         "spawn of missing file fails");
+
+  /* The child's console output goes into the pipe instead. */
+  CHECK (pipe (fds) == 0, "pipe");
+  redirect[0].oldfd = redirect[2].fd = fds[1];
+  redirect[1].fd = fds[0];
+  CHECK (wait (spawn ("child-simple", child_argv, redirect)) == CHILD_EXIT,
+         "spawn with stdout redirected");
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == sizeof expected - 1
+         && !memcmp (buf, expected, sizeof expected - 1),
+         "child's output came through the pipe");
+  close (fds[0]);
+
+  measure ("fork+exec", start_fork);
+  measure ("vfork+exec", start_vfork);
+  measure ("spawn", start_spawn);
+}
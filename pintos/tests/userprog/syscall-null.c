@@ -0,0 +1,48 @@
+/* Measures the round-trip latency of a system call that does no
+   work, in CPU timestamp counter cycles.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/syscall-null:syscall-null
+   -- -q run syscall-null". */
+
+#include <inttypes.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* System calls per timed run. */
+#define CALL_CNT 100000
+
+/* Timed runs; the fastest is reported. */
+#define RUN_CNT 5
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+void
+test_main (void)
+{
+  uint64_t best = UINT64_MAX;
+  int run, i;
+
+  for (run = 0; run < RUN_CNT; run++)
+    {
+      uint64_t start = rdtsc ();
+      uint64_t cycles;
+
+      for (i = 0; i < CALL_CNT; i++)
+        null_syscall ();
+      cycles = rdtsc () - start;
+      if (cycles < best)
+        best = cycles;
+    }
+
+  msg ("%d null system calls: %"PRIu64" cycles each (best of %d runs)",
+       CALL_CNT, best / CALL_CNT, RUN_CNT);
+}
@@ -0,0 +1,60 @@
+/* Measures the cost of large read and write system calls, in CPU
+   timestamp counter cycles per kilobyte, by writing a 512 kB file
+   in 64 kB calls and reading it back the same way.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/syscall-rw:syscall-rw -- -q
+   -f run syscall-rw". */
+
+#include <inttypes.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Bytes per system call. */
+#define BUF_SIZE (64 * 1024)
+
+/* System calls per pass. */
+#define CALL_CNT 8
+
+static char buf[BUF_SIZE];
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+void
+test_main (void)
+{
+  uint64_t start, write_cycles, read_cycles;
+  int fd, i;
+
+  memset (buf, 'x', sizeof buf);
+  CHECK (create ("bench", 0), "create \"bench\"");
+  CHECK ((fd = open ("bench")) > 1, "open \"bench\"");
+
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    if (write (fd, buf, BUF_SIZE) != BUF_SIZE)
+      fail ("write %d failed", i);
+  write_cycles = rdtsc () - start;
+
+  seek (fd, 0);
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    if (read (fd, buf, BUF_SIZE) != BUF_SIZE)
+      fail ("read %d failed", i);
+  read_cycles = rdtsc () - start;
+  close (fd);
+
+  msg ("write: %"PRIu64" cycles/kB in %d kB calls",
+       write_cycles / (CALL_CNT * BUF_SIZE / 1024), BUF_SIZE / 1024);
+  msg ("read: %"PRIu64" cycles/kB in %d kB calls",
+       read_cycles / (CALL_CNT * BUF_SIZE / 1024), BUF_SIZE / 1024);
+}
@@ -0,0 +1,119 @@
+/* Measures how many processes per second can be started and
+   waited for when each one must first initialize itself, here by
+   sieving a table of primes, compared with starting them already
+   initialized from a template with spawn_from_template().
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/template-rate:template-rate
+   -- -q -f run template-rate". */
+
+#include <inttypes.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+/* Children started per method. */
+#define CHILD_CNT 20
+
+/* Size of the table of primes, and the number of primes in it. */
+#define SIEVE_SIZE (1 << 17)
+#define PRIME_CNT 12251
+
+/* composite[i] is nonzero if i is not prime. */
+static char composite[SIEVE_SIZE];
+
+/* The costly initialization. */
+static void
+init (void)
+{
+  int i, j;
+
+  composite[0] = composite[1] = 1;
+  for (i = 2; i * i < SIEVE_SIZE; i++)
+    if (!composite[i])
+      for (j = i * i; j < SIEVE_SIZE; j += i)
+        composite[j] = 1;
+}
+
+/* The work a child does once initialized.  Returns 0 if the
+   table is right. */
+static int
+child_main (int argc, char *argv[])
+{
+  int cnt = 0;
+  int i;
+
+  if (argc != 2 || strcmp (argv[1], "child"))
+    return 1;
+  for (i = 0; i < SIEVE_SIZE; i++)
+    cnt += !composite[i];
+  return cnt != PRIME_CNT;
+}
+
+static char *const cold_argv[] = {"template-rate", "cold", NULL};
+static char *const warm_argv[] = {"template-rate", "child", NULL};
+
+static pid_t
+start_cold (void)
+{
+  return spawn ("template-rate", cold_argv, NULL);
+}
+
+static pid_t
+start_warm (void)
+{
+  return spawn_from_template (getpid (), warm_argv);
+}
+
+/* Starts and reaps CHILD_CNT children with START and reports the
+   rate at which it did so. */
+static void
+measure (const char *method, pid_t (*start) (void))
+{
+  uint64_t begin, ns;
+  int i;
+
+  begin = vdso_time_ns ();
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid_t pid = start ();
+
+      if (pid == PID_ERROR)
+        fail ("%s: could not start child %d", method, i);
+      if (wait (pid) != 0)
+        fail ("%s: child %d exited with the wrong status", method, i);
+    }
+  ns = vdso_time_ns () - begin;
+
+  msg ("%s: %"PRIu64" processes/s", method,
+       ns > 0 ? (uint64_t) CHILD_CNT * 1000000000 / ns : 0);
+}
+
+int
+main (int argc, char *argv[])
+{
+  static char *child_argv[] = {"template-rate", "child", NULL};
+
+  test_name = "template-rate";
+
+  /* Started by start_cold(): initialize, then work. */
+  if (argc == 2 && !strcmp (argv[1], "cold"))
+    {
+      init ();
+      return child_main (2, child_argv);
+    }
+
+  msg ("begin");
+  measure ("spawn", start_cold);
+
+  init ();
+  CHECK (spawn_from_template (getpid (), warm_argv) == PID_ERROR,
+         "spawn from missing template fails");
+  CHECK (template_mark (child_main) == 0, "template_mark");
+  CHECK (spawn_from_template (getpid (), NULL) == PID_ERROR,
+         "spawn from template without arguments fails");
+  measure ("spawn_from_template", start_warm);
+  msg ("end");
+  return 0;
+}
@@ -0,0 +1,134 @@
+/* Measures how long it takes to start a thread and wait for it,
+   next to fork() and wait() of a process, then has THREAD_CNT
+   threads increment one counter under a mutex, which they share
+   without any shared memory object since they share the address
+   space.  Checks that the counter ends up right and that each
+   thread sees its own thread-local block.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/thread-rate:thread-rate -- -q
+   -f run thread-rate". */
+
+#include <inttypes.h>
+#include <mutex.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Threads, or processes, started one at a time. */
+#define START_ROUNDS 200
+
+/* Contending threads, and increments by each. */
+#define THREAD_CNT 4
+#define THREAD_ITERS 200000
+
+/* Size of each thread's stack. */
+#define STACK_SIZE 4096
+
+static char stacks[THREAD_CNT][STACK_SIZE] __attribute__ ((aligned (16)));
+
+static struct mutex mutex;
+static volatile uint64_t counter;
+
+/* A thread-local block: by convention its first word points to
+   itself. */
+struct tls
+  {
+    struct tls *self;
+    int id;
+  };
+
+static struct tls tls_blocks[THREAD_CNT];
+
+/* Does nothing; started and joined to time thread creation. */
+static int
+noop (void *aux UNUSED)
+{
+  return 0;
+}
+
+/* Installs the thread-local block for thread number *ID, then
+   increments the counter THREAD_ITERS times under the mutex.
+   Returns the number of times the block went missing. */
+static int
+add (void *id_)
+{
+  int id = *(int *) id_;
+  struct tls *tls = &tls_blocks[id];
+  int i, lost = 0;
+
+  tls->self = tls;
+  tls->id = id;
+  if (set_tls (tls) != 0)
+    return -1;
+  for (i = 0; i < THREAD_ITERS; i++)
+    {
+      mutex_lock (&mutex);
+      counter++;
+      mutex_unlock (&mutex);
+      if (((struct tls *) get_tls ())->id != id)
+        lost++;
+    }
+  return lost;
+}
+
+/* Reports NS nanoseconds spent on START_ROUNDS starts. */
+static void
+report (const char *how, uint64_t ns)
+{
+  msg ("%s: %"PRIu64" us each", how, ns / START_ROUNDS / 1000);
+}
+
+void
+test_main (void)
+{
+  int ids[THREAD_CNT];
+  pid_t tids[THREAD_CNT];
+  uint64_t begin, ns;
+  int i;
+
+  begin = vdso_time_ns ();
+  for (i = 0; i < START_ROUNDS; i++)
+    {
+      pid_t tid = thread_spawn (noop, NULL, stacks[0] + STACK_SIZE);
+      if (tid == PID_ERROR)
+        fail ("thread_spawn failed");
+      if (thread_join (tid) != 0)
+        fail ("thread_join failed");
+    }
+  report ("thread_spawn and thread_join", vdso_time_ns () - begin);
+
+  begin = vdso_time_ns ();
+  for (i = 0; i < START_ROUNDS; i++)
+    {
+      pid_t pid = fork ("child");
+      if (pid == 0)
+        exit (0);
+      if (pid == PID_ERROR)
+        fail ("fork failed");
+      if (wait (pid) != 0)
+        fail ("wait failed");
+    }
+  report ("fork and wait", vdso_time_ns () - begin);
+
+  mutex_init (&mutex);
+  begin = vdso_time_ns ();
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      ids[i] = i;
+      tids[i] = thread_spawn (add, &ids[i], stacks[i] + STACK_SIZE);
+      if (tids[i] == PID_ERROR)
+        fail ("thread_spawn failed");
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    if (thread_join (tids[i]) != 0)
+      fail ("thread %d lost its thread-local block", i);
+  ns = vdso_time_ns () - begin;
+
+  if (counter != (uint64_t) THREAD_CNT * THREAD_ITERS)
+    fail ("counter is %"PRIu64", not %d", counter,
+          THREAD_CNT * THREAD_ITERS);
+  msg ("%d threads: %"PRIu64" ns per increment", THREAD_CNT,
+       ns / (THREAD_CNT * THREAD_ITERS));
+}
@@ -0,0 +1,193 @@
+/* Copies a file twice, once with read and write system calls and
+   once through a submission/completion ring, and compares the
+   time each takes in CPU timestamp counter cycles.  Both copies
+   move the data in small chunks, to show the cost of one system
+   call per chunk.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/uring-copy:uring-copy -- -q
+   -f run uring-copy". */
+
+#include <inttypes.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Size of the file copied. */
+#define FILE_SIZE (128 * 1024)
+
+/* Bytes per read or write. */
+#define CHUNK_SIZE 1024
+
+/* Operations in flight at once in the ring copy. */
+#define QUEUE_DEPTH 16
+
+static char bufs[QUEUE_DEPTH][CHUNK_SIZE];
+static int lens[QUEUE_DEPTH];
+
+static struct uring *ring;
+
+/* Stops the compiler from moving memory accesses across it. */
+#define barrier() asm volatile ("" : : : "memory")
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Queues an operation in the ring's submission queue.  The
+   caller must not queue more than URING_SQ_ENTRIES at once. */
+static void
+queue_op (enum uring_op opcode, int fd, void *addr, size_t len,
+          size_t off, uint64_t user_data)
+{
+  struct uring_sqe *sqe = &ring->sqes[ring->sq_tail % URING_SQ_ENTRIES];
+
+  memset (sqe, 0, sizeof *sqe);
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) addr;
+  sqe->len = len;
+  sqe->off = off;
+  sqe->user_data = user_data;
+  barrier ();
+  ring->sq_tail++;
+}
+
+/* Submits the CNT queued operations, waits for all of them, and
+   records each result in LENS[], indexed by its user data. */
+static void
+run_ops (unsigned cnt)
+{
+  unsigned i;
+
+  if (uring_enter (cnt, cnt) != (int) cnt)
+    fail ("uring_enter failed");
+  for (i = 0; i < cnt; i++)
+    {
+      struct uring_cqe *cqe = &ring->cqes[ring->cq_head % URING_CQ_ENTRIES];
+
+      barrier ();
+      lens[cqe->user_data] = cqe->res;
+      barrier ();
+      ring->cq_head++;
+    }
+}
+
+/* Copies FROM to TO with read and write system calls. */
+static void
+copy_plain (const char *from, const char *to)
+{
+  int in, out, n;
+
+  CHECK ((in = open (from)) > 1, "open \"%s\"", from);
+  CHECK ((out = open (to)) > 1, "open \"%s\"", to);
+  while ((n = read (in, bufs[0], CHUNK_SIZE)) > 0)
+    if (write (out, bufs[0], n) != n)
+      fail ("write to \"%s\" failed", to);
+  close (in);
+  close (out);
+}
+
+/* Copies FROM to TO through the ring, QUEUE_DEPTH chunks at a
+   time, including the opens and closes. */
+static void
+copy_ring (const char *from, const char *to)
+{
+  int in, out, i;
+  size_t ofs;
+
+  queue_op (URING_OP_OPEN, 0, (void *) from, 0, 0, 0);
+  queue_op (URING_OP_OPEN, 0, (void *) to, 0, 0, 1);
+  run_ops (2);
+  CHECK ((in = lens[0]) > 1, "open \"%s\"", from);
+  CHECK ((out = lens[1]) > 1, "open \"%s\"", to);
+
+  for (ofs = 0; ofs < FILE_SIZE; ofs += QUEUE_DEPTH * CHUNK_SIZE)
+    {
+      for (i = 0; i < QUEUE_DEPTH; i++)
+        queue_op (URING_OP_READ, in, bufs[i], CHUNK_SIZE,
+                  ofs + i * CHUNK_SIZE, i);
+      run_ops (QUEUE_DEPTH);
+      for (i = 0; i < QUEUE_DEPTH; i++)
+        {
+          if (lens[i] < 0)
+            fail ("read from \"%s\" failed", from);
+          queue_op (URING_OP_WRITE, out, bufs[i], lens[i],
+                    ofs + i * CHUNK_SIZE, i);
+        }
+      run_ops (QUEUE_DEPTH);
+      for (i = 0; i < QUEUE_DEPTH; i++)
+        if (lens[i] < 0)
+          fail ("write to \"%s\" failed", to);
+    }
+
+  queue_op (URING_OP_FSYNC, out, NULL, 0, 0, 0);
+  run_ops (1);
+  queue_op (URING_OP_CLOSE, in, NULL, 0, 0, 0);
+  queue_op (URING_OP_CLOSE, out, NULL, 0, 0, 1);
+  run_ops (2);
+  CHECK (lens[0] == 0 && lens[1] == 0, "close files");
+}
+
+/* Checks that files A and B have the same contents. */
+static void
+compare (const char *a, const char *b)
+{
+  int fa, fb;
+  size_t ofs;
+
+  CHECK ((fa = open (a)) > 1, "open \"%s\"", a);
+  CHECK ((fb = open (b)) > 1, "open \"%s\"", b);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    {
+      if (read (fa, bufs[0], CHUNK_SIZE) != CHUNK_SIZE
+          || read (fb, bufs[1], CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("short read at offset %zu", ofs);
+      if (memcmp (bufs[0], bufs[1], CHUNK_SIZE))
+        fail ("\"%s\" and \"%s\" differ at offset %zu", a, b, ofs);
+    }
+  close (fa);
+  close (fb);
+}
+
+void
+test_main (void)
+{
+  uint64_t start, plain_cycles, ring_cycles;
+  size_t ofs;
+  int fd;
+
+  CHECK ((ring = uring_setup ()) != NULL, "uring_setup");
+
+  CHECK (create ("src", FILE_SIZE), "create \"src\"");
+  CHECK (create ("plain", FILE_SIZE), "create \"plain\"");
+  CHECK (create ("ring", FILE_SIZE), "create \"ring\"");
+  CHECK ((fd = open ("src")) > 1, "open \"src\"");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    {
+      memset (bufs[0], 'a' + ofs / CHUNK_SIZE % 26, CHUNK_SIZE);
+      if (write (fd, bufs[0], CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("write to \"src\" failed");
+    }
+  close (fd);
+
+  start = rdtsc ();
+  copy_plain ("src", "plain");
+  plain_cycles = rdtsc () - start;
+
+  start = rdtsc ();
+  copy_ring ("src", "ring");
+  ring_cycles = rdtsc () - start;
+
+  compare ("src", "plain");
+  compare ("src", "ring");
+
+  msg ("system calls: %"PRIu64" cycles/kB", plain_cycles / (FILE_SIZE / 1024));
+  msg ("ring: %"PRIu64" cycles/kB", ring_cycles / (FILE_SIZE / 1024));
+}
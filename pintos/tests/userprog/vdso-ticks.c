@@ -0,0 +1,75 @@
+/* Compares the latency of reading the tick count and the pid
+   through system calls against reading them from the shared
+   kernel data page, in CPU timestamp counter cycles.
+
+   This is a benchmark, not a pass/fail test: its output depends
+   on the host, so it is not listed in tests/userprog_TESTS.  Run
+   it with "pintos -p tests/userprog/vdso-ticks:vdso-ticks
+   -- -q run vdso-ticks". */
+
+#include <inttypes.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Calls per timed run. */
+#define CALL_CNT 100000
+
+/* Timed runs; the fastest is reported. */
+#define RUN_CNT 5
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Returns the fewest cycles per call to FUNC over RUN_CNT runs
+   of CALL_CNT calls each. */
+static uint64_t
+time_calls (int64_t (*func) (void))
+{
+  uint64_t best = UINT64_MAX;
+  int run, i;
+
+  for (run = 0; run < RUN_CNT; run++)
+    {
+      uint64_t start = rdtsc ();
+      uint64_t cycles;
+
+      for (i = 0; i < CALL_CNT; i++)
+        func ();
+      cycles = rdtsc () - start;
+      if (cycles < best)
+        best = cycles;
+    }
+  return best / CALL_CNT;
+}
+
+static int64_t
+call_getpid (void)
+{
+  return getpid ();
+}
+
+static int64_t
+call_vdso_getpid (void)
+{
+  return vdso_getpid ();
+}
+
+void
+test_main (void)
+{
+  CHECK (getpid () == vdso_getpid (), "getpid() matches vdso_getpid()");
+  CHECK (get_ticks () <= vdso_ticks (), "get_ticks() <= vdso_ticks()");
+
+  msg ("get_ticks(): %"PRIu64" cycles per call", time_calls (get_ticks));
+  msg ("vdso_ticks(): %"PRIu64" cycles per call", time_calls (vdso_ticks));
+  msg ("getpid(): %"PRIu64" cycles per call", time_calls (call_getpid));
+  msg ("vdso_getpid(): %"PRIu64" cycles per call",
+       time_calls (call_vdso_getpid));
+  msg ("time since boot: %"PRIu64" ns", vdso_time_ns ());
+}
@@ -25,8 +25,13 @@
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#include "userprog/futex.h"
+#include "userprog/image.h"
+#include "userprog/mman.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "userprog/uring.h"
+#include "userprog/vdso.h"
 #endif
 #include "tests/threads/tests.h"
 #ifdef VM
@@ -100,6 +105,12 @@ main (void) {
 #ifdef USERPROG
 	exception_init ();
 	syscall_init ();
+	vdso_init ();
+	uring_init ();
+	image_init ();
+	process_template_init ();
+	futex_init ();
+	mman_init ();
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
@@ -361,5 +372,6 @@ print_stats (void) {
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
+	syscall_print_stats ();
 #endif
 }
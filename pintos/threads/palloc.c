@@ -328,6 +328,21 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of free pages in the user pool if PAL_USER
+   is set in FLAGS, otherwise in the kernel pool.  Other threads
+   may take or free pages at any time, so this is only a hint. */
+size_t
+palloc_free_cnt (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t cnt;
+
+	lock_acquire (&pool->lock);
+	cnt = bitmap_count (pool->used_map, 0, bitmap_size (pool->used_map),
+			false);
+	lock_release (&pool->lock);
+	return cnt;
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
@@ -321,3 +321,105 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	while (!list_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
+
+/* Initializes wait queue Q as empty. */
+void
+wait_queue_init (struct wait_queue *q) {
+	ASSERT (q != NULL);
+
+	list_init (&q->waiters);
+}
+
+/* Wakes every waiter on Q: each one's semaphore is upped and, if
+   it has a ready list and is not on it yet, it is appended there.
+   Waiters stay on Q.
+
+   This function may be called from an interrupt handler. */
+void
+wait_queue_wake (struct wait_queue *q) {
+	enum intr_level old_level;
+	struct list_elem *e;
+
+	ASSERT (q != NULL);
+
+	old_level = intr_disable ();
+	for (e = list_begin (&q->waiters); e != list_end (&q->waiters);
+			e = list_next (e)) {
+		struct waiter *w = list_entry (e, struct waiter, elem);
+
+		if (w->ready != NULL && !w->woken) {
+			w->woken = true;
+			list_push_back (w->ready, &w->ready_elem);
+		}
+		sema_up (w->sema);
+	}
+	intr_set_level (old_level);
+}
+
+/* Wakes every waiter on Q, as wait_queue_wake() does, and takes
+   them all off Q, which is about to be freed.  Their threads find
+   out what happened when they look again.
+
+   This function may be called from an interrupt handler. */
+void
+wait_queue_destroy (struct wait_queue *q) {
+	enum intr_level old_level;
+
+	ASSERT (q != NULL);
+
+	old_level = intr_disable ();
+	wait_queue_wake (q);
+	while (!list_empty (&q->waiters)) {
+		struct waiter *w = list_entry (list_pop_front (&q->waiters),
+				struct waiter, elem);
+		w->queue = NULL;
+	}
+	intr_set_level (old_level);
+}
+
+/* Initializes W to up SEMA when woken and, if READY is nonnull,
+   to join READY.  W starts out on no wait queue. */
+void
+waiter_init (struct waiter *w, struct semaphore *sema, struct list *ready) {
+	ASSERT (w != NULL);
+	ASSERT (sema != NULL);
+
+	w->sema = sema;
+	w->ready = ready;
+	w->woken = false;
+	w->queue = NULL;
+}
+
+/* Puts W, which must not be on a wait queue, on Q. */
+void
+waiter_add (struct waiter *w, struct wait_queue *q) {
+	enum intr_level old_level;
+
+	ASSERT (w != NULL && w->queue == NULL);
+	ASSERT (q != NULL);
+
+	old_level = intr_disable ();
+	w->queue = q;
+	list_push_back (&q->waiters, &w->elem);
+	intr_set_level (old_level);
+}
+
+/* Takes W off its wait queue, if it is on one, and off its ready
+   list, if it is on that. */
+void
+waiter_remove (struct waiter *w) {
+	enum intr_level old_level;
+
+	ASSERT (w != NULL);
+
+	old_level = intr_disable ();
+	if (w->queue != NULL) {
+		list_remove (&w->elem);
+		w->queue = NULL;
+	}
+	if (w->woken) {
+		list_remove (&w->ready_elem);
+		w->woken = false;
+	}
+	intr_set_level (old_level);
+}
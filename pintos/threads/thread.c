@@ -4,6 +4,7 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/disk.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
@@ -43,6 +44,10 @@ static struct lock tid_lock;
 /* 스레드 파괴 요청 목록 */
 static struct list destruction_req;
 
+/* 지금까지 생성되어 아직 종료되지 않은 모든 스레드의 리스트.
+   init_thread()에서 추가되고, thread_exit()에서 제거된다. */
+static struct list all_list;
+
 /* 통계 정보. */
 static long long idle_ticks;    /* idle로 보낸 타이머 틱 수. */
 static long long kernel_ticks;  /* 커널 스레드에서의 타이머 틱 수. */
@@ -109,6 +114,7 @@ thread_init (void) {
 	lock_init (&tid_lock);
 	list_init (&ready_list);
 	list_init (&destruction_req);	
+	list_init (&all_list);
 	
 	// Alarm Clock
 	list_init (&sleep_list);						// sleep_list 초기화
@@ -137,9 +143,10 @@ thread_start (void) {
 }
 
 /* 타이머 인터럽트 핸들러가 각 타이머 틱마다 호출한다.
-   즉, 이 함수는 외부 인터럽트 컨텍스트에서 실행된다. */
+   즉, 이 함수는 외부 인터럽트 컨텍스트에서 실행된다.
+   USER는 인터럽트가 사용자 모드에서 걸렸는지를 나타낸다. */
 void
-thread_tick (void) {
+thread_tick (bool user) {
 	struct thread *t = thread_current ();
 
 	/* 통계 업데이트. */
@@ -152,6 +159,14 @@ thread_tick (void) {
 	else
 		kernel_ticks++;
 
+	/* 스레드별 사용량은 실제로 어느 모드에 있었는지로 나눈다. */
+	if (t != idle_thread) {
+		if (user)
+			t->usage.user_ticks++;
+		else
+			t->usage.kernel_ticks++;
+	}
+
 	/* 선점 강제. */
 	if (++thread_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
@@ -322,14 +337,31 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
+	disk_account_exit (thread_current ());
 
 	/* 상태를 dying으로 설정하고 다른 프로세스를 스케줄한다.
 	   실제 파괴는 schedule_tail() 호출 중에 수행된다. */
 	intr_disable ();
+	list_remove (&thread_current ()->allelem);
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
 
+/* 모든 스레드에 대해 FUNC를 호출하며, AUX를 함께 넘긴다.
+   인터럽트가 꺼진 상태에서 호출해야 한다. */
+void
+thread_foreach (thread_action_func *func, void *aux) {
+	struct list_elem *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (e = list_begin (&all_list); e != list_end (&all_list);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, allelem);
+		func (t, aux);
+	}
+}
+
 /* CPU를 양보(yield)한다. 현재 스레드는 잠들지 않으며,
    스케줄러의 선택에 따라 즉시 다시 스케줄될 수도 있다. */
 void
@@ -436,6 +468,8 @@ kernel_thread (thread_func *function, void *aux) {
 /* T를 NAME이라는 이름의 블록된 스레드로 기본 초기화 수행. */
 static void
 init_thread (struct thread *t, const char *name, int priority) {
+	enum intr_level old_level;
+
 	ASSERT (t != NULL);
 	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT (name != NULL);
@@ -446,6 +480,17 @@ init_thread (struct thread *t, const char *name, int priority) {
 	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
 	t->priority = priority;
 	t->magic = THREAD_MAGIC;
+#ifdef USERPROG
+	t->exit_status = -1;
+	list_init (&t->children);
+	list_init (&t->shm_maps);
+	mman_create (&t->mman);
+	list_init (&t->threads);
+#endif
+
+	old_level = intr_disable ();
+	list_push_back (&all_list, &t->allelem);
+	intr_set_level (old_level);
 }
 
 /* 다음에 스케줄될 스레드를 선택하고 반환.
@@ -591,6 +636,12 @@ schedule (void) {
 #endif
 
 	if (curr != next) {
+		/* 기다리러 가는 전환은 자발적, 선점이나 양보는 비자발적. */
+		if (curr->status == THREAD_BLOCKED)
+			curr->usage.voluntary_switches++;
+		else if (curr->status == THREAD_READY)
+			curr->usage.involuntary_switches++;
+
 		/* 전환한 이전 스레드가 죽는 중이라면, 그 struct thread를 파괴.
 		   이는 thread_exit()가 자신 밑에서 카펫을 빼버리지 않도록
 		   (즉, 자기 자신을 당장 해제하지 않도록) 늦게 수행되어야 한다.
@@ -715,4 +766,4 @@ void max_priority()
 	{
 		thread_yield();
 	}
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -9,8 +9,18 @@
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
+/* An exception table entry.  A fault in kernel mode at INSN
+   resumes at FIXUP.  The table is built by the linker from the
+   ex_table sections that userprog/usercopy.c emits. */
+struct ex_entry {
+	uint64_t insn;
+	uint64_t fixup;
+};
+extern const struct ex_entry _start_ex_table[], _end_ex_table[];
+
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static bool fixup_exception (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -140,6 +150,13 @@ page_fault (struct intr_frame *f) {
 	write = (f->error_code & PF_W) != 0;
 	user = (f->error_code & PF_U) != 0;
 
+	/* Charge the fault to the thread that took it, whatever
+	   becomes of it. */
+	if (not_present)
+		thread_current ()->usage.nonpresent_faults++;
+	else
+		thread_current ()->usage.protection_faults++;
+
 #ifdef VM
 	/* For project 3 and later. */
 	if (vm_try_handle_fault (f, fault_addr, user, write, not_present))
@@ -149,6 +166,11 @@ page_fault (struct intr_frame *f) {
 	/* Count page faults. */
 	page_fault_cnt++;
 
+	/* A kernel access to user memory that is allowed to fault
+	   reports the fault to its caller instead. */
+	if (!user && fixup_exception (f))
+		return;
+
 	/* If the fault is true fault, show info and exit. */
 	printf ("Page fault at %p: %s error %s page in %s context.\n",
 			fault_addr,
@@ -158,3 +180,18 @@ page_fault (struct intr_frame *f) {
 	kill (f);
 }
 
+/* If F's faulting instruction has an exception table entry,
+   arranges for F to resume at the entry's fixup address and
+   returns true.  Otherwise returns false.  The table has only a
+   few entries, so a linear search is fine. */
+static bool
+fixup_exception (struct intr_frame *f) {
+	const struct ex_entry *e;
+
+	for (e = _start_ex_table; e < _end_ex_table; e++)
+		if (e->insn == f->rip) {
+			f->rip = e->fixup;
+			return true;
+		}
+	return false;
+}
@@ -0,0 +1,386 @@
+#include "userprog/fdtable.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* File descriptor tables.
+
+   A table keeps its slots in chunks of a page each, made the first
+   time one of their descriptors is handed out, so that a process
+   with a few files open pays for one page but one may open
+   thousands.
+
+   Each chunk has a bitmap with a bit set for each slot in use, and
+   the table has a summary bitmap with a bit set for each word of
+   those bitmaps that has a bit clear, whether its chunk has been
+   made yet or not.  The lowest free descriptor is thus one bsf
+   into the first nonzero summary word and one more into the word
+   it names, and there are only FD_MAX / 4096 summary words.
+
+   Slots 0 and 1 stand for the console until a file is put there,
+   so they are always marked in use and fdt_add() never hands them
+   out.
+
+   A process's threads share its table, so it is changed with
+   interrupts off.  For the same reason fdt_get() hands out a file
+   with a hold on it (see file_hold()), so that a close() in another
+   thread cannot free it while it is in use.  Chunks are allocated with interrupts on and then
+   installed, unless another thread got there first, and whoever
+   needed one looks again. */
+
+/* Slots per chunk, and words in its bitmap. */
+#define CHUNK_SLOTS (PGSIZE / sizeof (struct file *))
+#define CHUNK_WORDS (CHUNK_SLOTS / 64)
+
+/* Chunks per table, and words in its summary bitmap. */
+#define CHUNK_CNT (FD_MAX / CHUNK_SLOTS)
+#define SUMMARY_WORDS (CHUNK_CNT * CHUNK_WORDS / 64)
+
+/* A page of slots. */
+struct fd_chunk {
+	struct file **files;        /* CHUNK_SLOTS slots, null if free. */
+	uint64_t used[CHUNK_WORDS]; /* Bit set for each slot in use. */
+};
+
+/* A file descriptor table. */
+struct fd_table {
+	struct fd_chunk *chunks[CHUNK_CNT]; /* Null until first needed. */
+	uint64_t free[SUMMARY_WORDS];       /* Bit set for each bitmap
+	                                       word with a free slot. */
+};
+
+static struct file **get_slot (struct fd_table *, int fd);
+static bool add_chunk (struct fd_table *, size_t idx);
+static void mark (struct fd_table *, int fd, bool used);
+static int lowest_free (const struct fd_table *);
+static bool copy_files (struct fd_table *dst, const struct fd_table *src);
+
+/* Returns the index of the lowest set bit in X, which must not be
+ * 0. */
+static inline int
+bsf (uint64_t x) {
+	uint64_t idx;
+
+	asm ("bsfq %1, %0" : "=r" (idx) : "rm" (x));
+	return idx;
+}
+
+/* Returns a new, empty file descriptor table, or a null pointer
+ * if memory is exhausted. */
+struct fd_table *
+fdt_create (void) {
+	struct fd_table *t = malloc (sizeof *t);
+
+	if (t == NULL)
+		return NULL;
+	memset (t->chunks, 0, sizeof t->chunks);
+	memset (t->free, 0xff, sizeof t->free);
+	if (!add_chunk (t, 0)) {
+		free (t);
+		return NULL;
+	}
+	mark (t, 0, true);
+	mark (t, 1, true);
+	return t;
+}
+
+/* Returns a new table holding the same files as SRC in the same
+ * slots, with a reference to each, or a null pointer if memory is
+ * exhausted.  Takes time in proportion to the chunks SRC has made,
+ * not to FD_MAX. */
+struct fd_table *
+fdt_clone (struct fd_table *src) {
+	struct fd_table *t = fdt_create ();
+	enum intr_level old_level;
+	size_t i;
+
+	if (t == NULL)
+		return NULL;
+	for (;;) {
+		for (i = 0; i < CHUNK_CNT; i++)
+			if (src->chunks[i] != NULL && t->chunks[i] == NULL
+					&& !add_chunk (t, i)) {
+				fdt_destroy (t);
+				return NULL;
+			}
+
+		/* SRC may have grown while we were making chunks. */
+		old_level = intr_disable ();
+		if (copy_files (t, src))
+			break;
+		intr_set_level (old_level);
+	}
+	intr_set_level (old_level);
+	return t;
+}
+
+/* Frees T, whose files must have been taken out of it. */
+void
+fdt_destroy (struct fd_table *t) {
+	size_t i;
+
+	if (t == NULL)
+		return;
+	for (i = 0; i < CHUNK_CNT; i++)
+		if (t->chunks[i] != NULL) {
+			palloc_free_page (t->chunks[i]->files);
+			free (t->chunks[i]);
+		}
+	free (t);
+}
+
+/* Puts FILE in the lowest free slot of T.  Returns its descriptor,
+ * or -1 if T is full or memory is exhausted. */
+int
+fdt_add (struct fd_table *t, struct file *file) {
+	enum intr_level old_level;
+	struct fd_chunk *c;
+	int fd;
+
+	for (;;) {
+		old_level = intr_disable ();
+		fd = lowest_free (t);
+		c = fd >= 0 ? t->chunks[fd / CHUNK_SLOTS] : NULL;
+		if (c != NULL) {
+			c->files[fd % CHUNK_SLOTS] = file;
+			mark (t, fd, true);
+		}
+		intr_set_level (old_level);
+
+		if (fd < 0 || c != NULL)
+			return fd;
+		if (!add_chunk (t, fd / CHUNK_SLOTS))
+			return -1;
+	}
+}
+
+/* Puts FILE in slot FD of T and stores the file that was there, or
+ * a null pointer, in *OLD.  Returns false if FD is out of range or
+ * memory is exhausted. */
+bool
+fdt_install (struct fd_table *t, int fd, struct file *file,
+		struct file **old) {
+	enum intr_level old_level;
+	struct file **slot;
+
+	if (fd < 0 || fd >= FD_MAX)
+		return false;
+	if (t->chunks[fd / CHUNK_SLOTS] == NULL
+			&& !add_chunk (t, fd / CHUNK_SLOTS))
+		return false;
+
+	old_level = intr_disable ();
+	slot = &t->chunks[fd / CHUNK_SLOTS]->files[fd % CHUNK_SLOTS];
+	*old = *slot;
+	*slot = file;
+	mark (t, fd, true);
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Puts NEW in slot FD of T if OLD is still there.  Returns true if
+ * it was. */
+bool
+fdt_replace (struct fd_table *t, int fd, struct file *old,
+		struct file *new) {
+	enum intr_level old_level;
+	struct file **slot;
+	bool replaced = false;
+
+	ASSERT (old != NULL);
+	if (fd < 0 || fd >= FD_MAX || t->chunks[fd / CHUNK_SLOTS] == NULL)
+		return false;
+
+	old_level = intr_disable ();
+	slot = &t->chunks[fd / CHUNK_SLOTS]->files[fd % CHUNK_SLOTS];
+	if (*slot == old) {
+		*slot = new;
+		replaced = true;
+	}
+	intr_set_level (old_level);
+	return replaced;
+}
+
+/* Returns the file in slot FD of T with a hold on it, which the
+ * caller must drop with file_unhold(), or a null pointer if there
+ * is none. */
+struct file *
+fdt_get (struct fd_table *t, int fd) {
+	struct file **slot = get_slot (t, fd);
+	enum intr_level old_level;
+	struct file *file;
+
+	if (slot == NULL)
+		return NULL;
+	old_level = intr_disable ();
+	file = *slot;
+	if (file != NULL)
+		file_hold (file);
+	intr_set_level (old_level);
+	return file;
+}
+
+/* Takes the file in slot FD of T out of it and returns it, or
+ * returns a null pointer if there is none. */
+struct file *
+fdt_remove (struct fd_table *t, int fd) {
+	struct file **slot = get_slot (t, fd);
+	enum intr_level old_level;
+	struct file *file;
+
+	if (slot == NULL)
+		return NULL;
+
+	old_level = intr_disable ();
+	file = *slot;
+	*slot = NULL;
+	if (file != NULL && fd > 1)
+		mark (t, fd, false);
+	intr_set_level (old_level);
+	return file;
+}
+
+/* Returns the lowest descriptor at or above FD with a file in T,
+ * or -1 if there is none. */
+int
+fdt_next (struct fd_table *t, int fd) {
+	size_t w;
+
+	if (fd < 0)
+		fd = 0;
+	for (w = fd / 64; w < CHUNK_CNT * CHUNK_WORDS; w++) {
+		struct fd_chunk *c = t->chunks[w / CHUNK_WORDS];
+		uint64_t bits;
+
+		if (c == NULL) {
+			w += CHUNK_WORDS - 1 - w % CHUNK_WORDS;
+			continue;
+		}
+		bits = c->used[w % CHUNK_WORDS];
+		if (w == (size_t) fd / 64)
+			bits &= ~(uint64_t) 0 << fd % 64;
+		for (; bits != 0; bits &= bits - 1) {
+			size_t slot = w * 64 + bsf (bits);
+
+			if (c->files[slot % CHUNK_SLOTS] != NULL)
+				return slot;
+		}
+	}
+	return -1;
+}
+
+/* Returns slot FD of T, or a null pointer if FD is out of range or
+ * its chunk does not exist. */
+static struct file **
+get_slot (struct fd_table *t, int fd) {
+	struct fd_chunk *c;
+
+	if (fd < 0 || fd >= FD_MAX)
+		return NULL;
+	c = t->chunks[fd / CHUNK_SLOTS];
+	return c != NULL ? &c->files[fd % CHUNK_SLOTS] : NULL;
+}
+
+/* Allocates chunk IDX of T, unless it already exists.  Returns
+ * false if memory is exhausted. */
+static bool
+add_chunk (struct fd_table *t, size_t idx) {
+	struct fd_chunk *c = malloc (sizeof *c);
+	enum intr_level old_level;
+
+	if (c == NULL)
+		return false;
+	c->files = palloc_get_page (PAL_ZERO);
+	if (c->files == NULL) {
+		free (c);
+		return false;
+	}
+	memset (c->used, 0, sizeof c->used);
+
+	old_level = intr_disable ();
+	if (t->chunks[idx] == NULL) {
+		t->chunks[idx] = c;
+		c = NULL;
+	}
+	intr_set_level (old_level);
+
+	if (c != NULL) {
+		palloc_free_page (c->files);
+		free (c);
+	}
+	return true;
+}
+
+/* Marks slot FD of T, whose chunk must exist, as in use if USED is
+ * true or free otherwise.  Interrupts must be off. */
+static void
+mark (struct fd_table *t, int fd, bool used) {
+	uint64_t *word = &t->chunks[fd / CHUNK_SLOTS]->used[fd / 64 % CHUNK_WORDS];
+	size_t w = fd / 64;
+
+	if (used)
+		*word |= (uint64_t) 1 << fd % 64;
+	else
+		*word &= ~((uint64_t) 1 << fd % 64);
+
+	if (~*word != 0)
+		t->free[w / 64] |= (uint64_t) 1 << w % 64;
+	else
+		t->free[w / 64] &= ~((uint64_t) 1 << w % 64);
+}
+
+/* Returns the lowest free descriptor in T, whose chunk may not
+ * exist yet, or -1 if T is full.  Interrupts must be off. */
+static int
+lowest_free (const struct fd_table *t) {
+	size_t s;
+
+	for (s = 0; s < SUMMARY_WORDS; s++)
+		if (t->free[s] != 0) {
+			size_t w = s * 64 + bsf (t->free[s]);
+			const struct fd_chunk *c = t->chunks[w / CHUNK_WORDS];
+			uint64_t used = c != NULL ? c->used[w % CHUNK_WORDS] : 0;
+
+			return w * 64 + bsf (~used);
+		}
+	return -1;
+}
+
+/* Copies SRC's files, and the bitmaps, into DST, which must be
+ * empty apart from the console's slots, adding a reference to
+ * each file.  Returns false, copying nothing, if SRC has a chunk
+ * that DST lacks.  Interrupts must be off. */
+static bool
+copy_files (struct fd_table *dst, const struct fd_table *src) {
+	size_t i, j;
+
+	for (i = 0; i < CHUNK_CNT; i++)
+		if (src->chunks[i] != NULL && dst->chunks[i] == NULL)
+			return false;
+
+	for (i = 0; i < CHUNK_CNT; i++) {
+		const struct fd_chunk *sc = src->chunks[i];
+		struct fd_chunk *dc = dst->chunks[i];
+
+		if (sc == NULL)
+			continue;
+		for (j = 0; j < CHUNK_WORDS; j++) {
+			uint64_t bits;
+
+			dc->used[j] = sc->used[j];
+			for (bits = sc->used[j]; bits != 0; bits &= bits - 1) {
+				size_t slot = j * 64 + bsf (bits);
+
+				if (sc->files[slot] != NULL)
+					dc->files[slot] = file_ref (sc->files[slot]);
+			}
+		}
+	}
+	memcpy (dst->free, src->free, sizeof dst->free);
+	return true;
+}
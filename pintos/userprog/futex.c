@@ -0,0 +1,149 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include "devices/timer.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/usercopy.h"
+
+/* Fast user-space mutexes.
+
+   A futex is any aligned 32-bit word of user memory.  User code
+   changes it with atomic instructions and only enters the kernel
+   when it has to wait, with futex_wait(), or when someone may be
+   waiting, with futex_wake(), so an uncontended lock costs no
+   system calls at all.
+
+   Waiters are kept in a fixed hash table of wait queues, keyed by
+   the kernel address of the word.  For a process's private memory
+   that identifies the same word as its address space and user
+   address would, and it also lets processes that map the same
+   shared memory, at whatever addresses, wait on each other.  User
+   pages never move while mapped, so the key stays valid for as
+   long as anyone waits on it.
+
+   futex_wait() checks the word and joins its queue under the
+   bucket lock, which futex_wake() takes too, so a wakeup that
+   follows a change to the word cannot be missed. */
+
+/* Number of hash buckets. */
+#define FUTEX_BUCKETS 64
+
+/* A bucket of the hash table. */
+static struct futex_bucket {
+	struct lock lock;           /* Protects WAITERS. */
+	struct list waiters;        /* List of struct futex_waiter. */
+} buckets[FUTEX_BUCKETS];
+
+/* A thread waiting on a futex. */
+struct futex_waiter {
+	const uint32_t *key;        /* Kernel address of the word. */
+	struct semaphore sema;      /* Upped to wake the thread. */
+	bool woken;                 /* Woken by futex_wake()? */
+	struct list_elem elem;      /* Element in bucket's waiters. */
+};
+
+/* Initializes the futex hash table. */
+void
+futex_init (void) {
+	size_t i;
+
+	for (i = 0; i < FUTEX_BUCKETS; i++) {
+		lock_init (&buckets[i].lock);
+		list_init (&buckets[i].waiters);
+	}
+}
+
+/* Returns the kernel address of the word at UADDR in the current
+   process, or a null pointer if UADDR is misaligned or unmapped. */
+static const uint32_t *
+futex_key (const uint32_t *uaddr) {
+	uint32_t value;
+
+	if ((uintptr_t) uaddr % sizeof *uaddr != 0
+			|| !copy_from_user (&value, uaddr, sizeof value))
+		return NULL;
+	return pml4_get_page (thread_current ()->pml4, uaddr);
+}
+
+/* Returns the bucket for KEY. */
+static struct futex_bucket *
+futex_bucket (const uint32_t *key) {
+	return &buckets[hash_bytes (&key, sizeof key) % FUTEX_BUCKETS];
+}
+
+/* If the word at UADDR still holds EXPECTED, waits until
+   futex_wake() is called on it or TIMEOUT ticks pass.  A negative
+   TIMEOUT waits for as long as it takes.  Returns 0 if woken, or
+   -1 if the word held something else, the wait timed out, or
+   UADDR is not a valid futex. */
+int
+futex_wait (uint32_t *uaddr, uint32_t expected, int64_t timeout) {
+	const uint32_t *key = futex_key (uaddr);
+	struct futex_bucket *b;
+	struct futex_waiter w;
+	struct timer_alarm alarm;
+
+	if (key == NULL || timeout == 0)
+		return -1;
+	b = futex_bucket (key);
+
+	lock_acquire (&b->lock);
+	if (*key != expected) {
+		lock_release (&b->lock);
+		return -1;
+	}
+	w.key = key;
+	w.woken = false;
+	sema_init (&w.sema, 0);
+	list_push_back (&b->waiters, &w.elem);
+	lock_release (&b->lock);
+
+	if (timeout > 0)
+		timer_alarm_set (&alarm, timer_ticks () + timeout, &w.sema);
+	sema_down (&w.sema);
+	if (timeout > 0)
+		timer_alarm_cancel (&alarm);
+
+	/* A timeout leaves us on the queue. */
+	lock_acquire (&b->lock);
+	if (!w.woken)
+		list_remove (&w.elem);
+	lock_release (&b->lock);
+	return w.woken ? 0 : -1;
+}
+
+/* Wakes up to CNT threads waiting on the word at UADDR, in the
+   order they started waiting.  Returns the number woken, or -1 if
+   UADDR is not a valid futex. */
+int
+futex_wake (uint32_t *uaddr, int cnt) {
+	const uint32_t *key = futex_key (uaddr);
+	struct futex_bucket *b;
+	struct list_elem *e;
+	int woken = 0;
+
+	if (key == NULL)
+		return -1;
+	b = futex_bucket (key);
+
+	lock_acquire (&b->lock);
+	for (e = list_begin (&b->waiters);
+			woken < cnt && e != list_end (&b->waiters); ) {
+		struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+		if (w->key != key) {
+			e = list_next (e);
+			continue;
+		}
+		e = list_remove (e);
+		w->woken = true;
+		sema_up (&w->sema);
+		woken++;
+	}
+	lock_release (&b->lock);
+	return woken;
+}
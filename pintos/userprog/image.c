@@ -0,0 +1,460 @@
+#include "userprog/image.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Executable image cache.
+
+   Loading a program means parsing its ELF headers and reading its
+   segments.  Shells and test harnesses run the same few programs
+   over and over, so the result is kept here, by inode, for the next
+   exec() of the same file: a warm exec only looks up the name and
+   parses nothing.  Keying on the inode rather than the name means
+   that a file removed and recreated under the same name is never
+   mistaken for the old one.
+
+   The pages of read-only segments are mapped straight into every
+   process that runs the image, so they are shared; process_cleanup()
+   unmaps them with image_unmap() before it destroys the page
+   tables.  Writable segments are copied into each process.
+
+   A cached image holds its file open.  It is thrown away when it
+   is next looked up if the file has since been written, and by
+   image_purge() once the file is removed, so that the cache does
+   not keep a removed file's sectors allocated.  In VM builds only
+   the headers are cached, since pages are loaded lazily from the
+   file.
+
+   The caller must hold filesys_lock. */
+
+/* Maximum number of images in the cache. */
+#define IMAGE_CACHE_MAX 8
+
+/* Cached images, most recently used first. */
+static struct list image_cache;
+static size_t image_cache_cnt;
+
+/* We load ELF binaries.  The following definitions are taken
+ * from the ELF specification, [ELF1], more-or-less verbatim.  */
+
+/* ELF types.  See [ELF1] 1-2. */
+#define EI_NIDENT 16
+
+#define PT_NULL    0            /* Ignore. */
+#define PT_LOAD    1            /* Loadable segment. */
+#define PT_DYNAMIC 2            /* Dynamic linking info. */
+#define PT_INTERP  3            /* Name of dynamic loader. */
+#define PT_NOTE    4            /* Auxiliary info. */
+#define PT_SHLIB   5            /* Reserved. */
+#define PT_PHDR    6            /* Program header table. */
+#define PT_STACK   0x6474e551   /* Stack segment. */
+
+#define PF_X 1          /* Executable. */
+#define PF_W 2          /* Writable. */
+#define PF_R 4          /* Readable. */
+
+/* Executable header.  See [ELF1] 1-4 to 1-8.
+ * This appears at the very beginning of an ELF binary. */
+struct ELF64_hdr {
+	unsigned char e_ident[EI_NIDENT];
+	uint16_t e_type;
+	uint16_t e_machine;
+	uint32_t e_version;
+	uint64_t e_entry;
+	uint64_t e_phoff;
+	uint64_t e_shoff;
+	uint32_t e_flags;
+	uint16_t e_ehsize;
+	uint16_t e_phentsize;
+	uint16_t e_phnum;
+	uint16_t e_shentsize;
+	uint16_t e_shnum;
+	uint16_t e_shstrndx;
+};
+
+struct ELF64_PHDR {
+	uint32_t p_type;
+	uint32_t p_flags;
+	uint64_t p_offset;
+	uint64_t p_vaddr;
+	uint64_t p_paddr;
+	uint64_t p_filesz;
+	uint64_t p_memsz;
+	uint64_t p_align;
+};
+
+/* Abbreviations */
+#define ELF ELF64_hdr
+#define Phdr ELF64_PHDR
+
+static struct image *cache_lookup (struct inode *);
+static void cache_insert (struct image *);
+static void cache_remove (struct image *);
+static struct image *read_image (struct file *);
+static bool validate_segment (const struct Phdr *, struct file *);
+static bool read_pages (struct image_seg *, struct file *);
+static void image_free (struct image *);
+
+/* Initializes the image cache. */
+void
+image_init (void) {
+	list_init (&image_cache);
+}
+
+/* Returns the image of the executable NAME, from the cache if
+ * possible, or a null pointer if it cannot be loaded.  The
+ * caller must release it with image_release(). */
+struct image *
+image_open (const char *name) {
+	struct image *img;
+	struct file *file;
+
+	file = filesys_open (name);
+	if (file == NULL) {
+		printf ("load: %s: open failed\n", name);
+		return NULL;
+	}
+	img = image_ref (cache_lookup (file_get_inode (file)));
+	if (img == NULL) {
+		img = read_image (file);
+		if (img != NULL)
+			cache_insert (img);
+	}
+	file_close (file);
+	if (img == NULL)
+		printf ("load: %s: error loading executable\n", name);
+	return img;
+}
+
+/* Adds a reference to IMG, if not null, and returns it. */
+struct image *
+image_ref (struct image *img) {
+	if (img != NULL)
+		img->ref_cnt++;
+	return img;
+}
+
+/* Drops a reference to IMG, if not null, freeing it if that was
+ * the last. */
+void
+image_release (struct image *img) {
+	if (img != NULL && --img->ref_cnt == 0)
+		image_free (img);
+}
+
+/* Returns the segment of IMG that contains user page UPAGE, and
+ * the page's index within it in *IDX, or a null pointer. */
+static const struct image_seg *
+find_seg (const struct image *img, const void *upage, size_t *idx) {
+	uint64_t va = (uint64_t) upage;
+	size_t i;
+
+	for (i = 0; i < img->seg_cnt; i++) {
+		const struct image_seg *seg = &img->segs[i];
+
+		if (va >= seg->mem_page
+				&& va < seg->mem_page + seg->page_cnt * PGSIZE) {
+			*idx = (va - seg->mem_page) / PGSIZE;
+			return seg;
+		}
+	}
+	return NULL;
+}
+
+/* Returns true if KPAGE, mapped at UPAGE, is one of IMG's shared
+ * pages rather than a page of the process's own.  IMG may be a
+ * null pointer, for a process that has no image. */
+bool
+image_is_shared (const struct image *img, const void *upage,
+		const void *kpage) {
+	const struct image_seg *seg;
+	size_t idx;
+
+	if (img == NULL)
+		return false;
+	seg = find_seg (img, upage, &idx);
+	return (seg != NULL && !seg->writable && seg->pages != NULL
+			&& seg->pages[idx] != NULL && seg->pages[idx] == kpage);
+}
+
+/* Removes IMG's shared pages from PML4, so that destroying PML4
+ * does not free them. */
+void
+image_unmap (const struct image *img, uint64_t *pml4) {
+	size_t i, j;
+
+	for (i = 0; i < img->seg_cnt; i++) {
+		const struct image_seg *seg = &img->segs[i];
+
+		if (seg->writable || seg->pages == NULL)
+			continue;
+		for (j = 0; j < seg->page_cnt; j++) {
+			void *upage = (void *) (seg->mem_page + j * PGSIZE);
+
+			if (seg->pages[j] != NULL
+					&& pml4_get_page (pml4, upage) == seg->pages[j])
+				pml4_clear_page (pml4, upage);
+		}
+	}
+}
+
+/* Drops every cached image whose file has been removed.  Call it
+ * after removing a file. */
+void
+image_purge (void) {
+	struct list_elem *e, *next;
+
+	for (e = list_begin (&image_cache); e != list_end (&image_cache);
+			e = next) {
+		struct image *img = list_entry (e, struct image, elem);
+
+		next = list_next (e);
+		if (inode_is_removed (img->inode))
+			cache_remove (img);
+	}
+}
+
+/* Returns the cached image of INODE, moved to the front of the
+ * cache, or a null pointer if there is none.  Drops a cached image
+ * whose file has changed. */
+static struct image *
+cache_lookup (struct inode *inode) {
+	struct list_elem *e;
+
+	for (e = list_begin (&image_cache); e != list_end (&image_cache);
+			e = list_next (e)) {
+		struct image *img = list_entry (e, struct image, elem);
+
+		if (img->inode != inode)
+			continue;
+		if (inode_write_cnt (img->inode) != img->write_cnt) {
+			cache_remove (img);
+			return NULL;
+		}
+		list_remove (&img->elem);
+		list_push_front (&image_cache, &img->elem);
+		return img;
+	}
+	return NULL;
+}
+
+/* Adds IMG to the cache, evicting the least recently used image
+ * if the cache is full. */
+static void
+cache_insert (struct image *img) {
+	image_ref (img);
+	img->cached = true;
+	list_push_front (&image_cache, &img->elem);
+	if (++image_cache_cnt > IMAGE_CACHE_MAX)
+		cache_remove (list_entry (list_back (&image_cache), struct image, elem));
+}
+
+/* Removes IMG from the cache.  Processes running it keep it. */
+static void
+cache_remove (struct image *img) {
+	ASSERT (img->cached);
+	list_remove (&img->elem);
+	img->cached = false;
+	image_cache_cnt--;
+	image_release (img);
+}
+
+/* Parses the ELF executable FILE and reads in its
+ * segments.  Returns the new image, with one reference, or a null
+ * pointer if FILE is not a valid executable or memory is short. */
+static struct image *
+read_image (struct file *file) {
+	struct ELF ehdr;
+	struct image *img;
+	off_t file_ofs;
+	int i;
+
+	/* Read and verify executable header. */
+	if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
+			|| memcmp (ehdr.e_ident, "\177ELF\2\1\1", 7)
+			|| ehdr.e_type != 2
+			|| ehdr.e_machine != 0x3E // amd64
+			|| ehdr.e_version != 1
+			|| ehdr.e_phentsize != sizeof (struct Phdr)
+			|| ehdr.e_phnum > 1024
+			|| ehdr.e_phnum == 0)
+		return NULL;
+
+	img = calloc (1, sizeof *img);
+	if (img == NULL)
+		return NULL;
+	img->segs = calloc (ehdr.e_phnum, sizeof *img->segs);
+	if (img->segs == NULL) {
+		free (img);
+		return NULL;
+	}
+	img->inode = inode_reopen (file_get_inode (file));
+	img->write_cnt = inode_write_cnt (img->inode);
+	img->entry = ehdr.e_entry;
+	img->ref_cnt = 1;
+
+	/* Read program headers. */
+	file_ofs = ehdr.e_phoff;
+	for (i = 0; i < ehdr.e_phnum; i++) {
+		struct Phdr phdr;
+		struct image_seg *seg;
+		uint64_t page_offset;
+
+		if (file_ofs < 0 || file_ofs > file_length (file))
+			goto error;
+		file_seek (file, file_ofs);
+
+		if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
+			goto error;
+		file_ofs += sizeof phdr;
+		switch (phdr.p_type) {
+			case PT_NULL:
+			case PT_NOTE:
+			case PT_PHDR:
+			case PT_STACK:
+			default:
+				/* Ignore this segment. */
+				break;
+			case PT_DYNAMIC:
+			case PT_INTERP:
+			case PT_SHLIB:
+				goto error;
+			case PT_LOAD:
+				if (!validate_segment (&phdr, file))
+					goto error;
+				seg = &img->segs[img->seg_cnt++];
+				seg->writable = (phdr.p_flags & PF_W) != 0;
+				seg->file_page = phdr.p_offset & ~PGMASK;
+				seg->mem_page = phdr.p_vaddr & ~PGMASK;
+				page_offset = phdr.p_vaddr & PGMASK;
+				if (phdr.p_filesz > 0) {
+					/* Normal segment.
+					 * Read initial part from disk and zero the rest. */
+					seg->read_bytes = page_offset + phdr.p_filesz;
+					seg->zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
+							- seg->read_bytes);
+				} else {
+					/* Entirely zero.
+					 * Don't read anything from disk. */
+					seg->read_bytes = 0;
+					seg->zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+				}
+				seg->page_cnt = (seg->read_bytes + seg->zero_bytes) / PGSIZE;
+				if (!read_pages (seg, file))
+					goto error;
+				break;
+		}
+	}
+	return img;
+
+error:
+	image_free (img);
+	return NULL;
+}
+
+/* Checks whether PHDR describes a valid, loadable segment in
+ * FILE and returns true if so, false otherwise. */
+static bool
+validate_segment (const struct Phdr *phdr, struct file *file) {
+	/* p_offset and p_vaddr must have the same page offset. */
+	if ((phdr->p_offset & PGMASK) != (phdr->p_vaddr & PGMASK))
+		return false;
+
+	/* p_offset must point within FILE. */
+	if (phdr->p_offset > (uint64_t) file_length (file))
+		return false;
+
+	/* p_memsz must be at least as big as p_filesz. */
+	if (phdr->p_memsz < phdr->p_filesz)
+		return false;
+
+	/* The segment must not be empty. */
+	if (phdr->p_memsz == 0)
+		return false;
+
+	/* The virtual memory region must both start and end within the
+	   user address space range. */
+	if (!is_user_vaddr ((void *) phdr->p_vaddr))
+		return false;
+	if (!is_user_vaddr ((void *) (phdr->p_vaddr + phdr->p_memsz)))
+		return false;
+
+	/* The region cannot "wrap around" across the kernel virtual
+	   address space. */
+	if (phdr->p_vaddr + phdr->p_memsz < phdr->p_vaddr)
+		return false;
+
+	/* Disallow mapping page 0.
+	   Not only is it a bad idea to map page 0, but if we allowed
+	   it then user code that passed a null pointer to system calls
+	   could quite likely panic the kernel by way of null pointer
+	   assertions in memcpy(), etc. */
+	if (phdr->p_vaddr < PGSIZE)
+		return false;
+
+	/* It's okay. */
+	return true;
+}
+
+/* Reads the pages of SEG that hold file data from FILE.  Pages
+ * that are all zeros are left as null pointers.  Returns false if
+ * memory is short or the file is too short. */
+static bool
+read_pages (struct image_seg *seg, struct file *file) {
+#ifdef VM
+	/* Pages are loaded lazily from the file. */
+	(void) seg;
+	(void) file;
+	return true;
+#else
+	uint32_t read_bytes = seg->read_bytes;
+	size_t i;
+
+	seg->pages = calloc (seg->page_cnt, sizeof *seg->pages);
+	if (seg->pages == NULL)
+		return false;
+
+	for (i = 0; read_bytes > 0; i++) {
+		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+		uint8_t *kpage = palloc_get_page (PAL_USER);
+
+		if (kpage == NULL)
+			return false;
+		seg->pages[i] = kpage;
+		if (file_read_at (file, kpage, page_read_bytes,
+					seg->file_page + i * PGSIZE) != (off_t) page_read_bytes)
+			return false;
+		memset (kpage + page_read_bytes, 0, PGSIZE - page_read_bytes);
+		read_bytes -= page_read_bytes;
+	}
+	return true;
+#endif
+}
+
+/* Frees IMG and its pages and closes its file. */
+static void
+image_free (struct image *img) {
+	size_t i, j;
+
+	ASSERT (!img->cached);
+	for (i = 0; i < img->seg_cnt; i++) {
+		struct image_seg *seg = &img->segs[i];
+
+		if (seg->pages == NULL)
+			continue;
+		for (j = 0; j < seg->page_cnt; j++)
+			palloc_free_page (seg->pages[j]);
+		free (seg->pages);
+	}
+	free (img->segs);
+	inode_close (img->inode);
+	free (img);
+}
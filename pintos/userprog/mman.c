@@ -0,0 +1,356 @@
+#include "userprog/mman.h"
+#include <debug.h>
+#include <round.h>
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "userprog/uring.h"
+
+/* Heap and anonymous memory.
+
+   A process's heap runs from the page after its program up to its
+   break, which sbrk() moves up and down.  mmap() adds separate
+   anonymous mappings, which munmap() takes away again whole;
+   unless the caller says where, each goes in the highest gap below
+   MMAP_TOP that is big enough.  Both consist of zeroed pages that
+   fork() copies like the rest of the address space.
+
+   The pages belong to the page map, so destroying it frees them;
+   struct mman only records where things are, in the process's main
+   thread, which its other threads share.  Setting up pages may
+   sleep, so changes are serialized by a lock rather than by turning
+   interrupts off.  Before freeing pages, sbrk() and munmap() wait
+   for ring operations that may be using them (see uring_pause()).
+
+   A vfork() child runs in its parent's address space until it
+   exec()s or exits, but the record of that space stays with the
+   parent.  So the child may not change its memory map: sbrk(),
+   mmap() and munmap() fail for it. */
+
+/* Top of the area mmap() chooses addresses in, leaving the stack
+ * room to grow. */
+#define MMAP_TOP (USER_STACK - 16 * 1024 * 1024)
+
+/* An anonymous mapping. */
+struct mman_map {
+	uintptr_t addr;             /* User address of its first page. */
+	size_t page_cnt;            /* Size in pages. */
+	struct list_elem elem;      /* Element in struct mman's maps. */
+};
+
+/* Serializes changes to every process's struct mman. */
+static struct lock mman_lock;
+
+static struct mman *current_mman (void);
+static uintptr_t find_gap (struct mman *, size_t page_cnt);
+static void add_map (struct mman *, struct mman_map *);
+static bool enough_pages (size_t page_cnt);
+static bool map_pages (uintptr_t addr, size_t page_cnt, bool writable);
+static void unmap_pages (uintptr_t addr, size_t page_cnt);
+
+/* Initializes the module. */
+void
+mman_init (void) {
+	lock_init (&mman_lock);
+}
+
+/* Initializes MM with no heap and no mappings. */
+void
+mman_create (struct mman *mm) {
+	mm->heap_start = mm->brk = 0;
+	list_init (&mm->maps);
+}
+
+/* Forgets MM's heap and mappings, leaving it as mman_create() did.
+ * Their pages must already be gone with the page map they were
+ * in. */
+void
+mman_destroy (struct mman *mm) {
+	while (!list_empty (&mm->maps))
+		free (list_entry (list_pop_front (&mm->maps), struct mman_map, elem));
+	mm->heap_start = mm->brk = 0;
+}
+
+/* Makes DST, which must have no mappings, record the same heap and
+ * mappings as SRC, for an address space copied from SRC's.
+ * Returns false if memory is exhausted. */
+bool
+mman_copy (struct mman *dst, struct mman *src) {
+	struct list_elem *e;
+	bool success = true;
+
+	ASSERT (list_empty (&dst->maps));
+
+	lock_acquire (&mman_lock);
+	dst->heap_start = src->heap_start;
+	dst->brk = src->brk;
+	for (e = list_begin (&src->maps); e != list_end (&src->maps);
+			e = list_next (e)) {
+		const struct mman_map *sm = list_entry (e, struct mman_map, elem);
+		struct mman_map *m = malloc (sizeof *m);
+
+		if (m == NULL) {
+			success = false;
+			break;
+		}
+		m->addr = sm->addr;
+		m->page_cnt = sm->page_cnt;
+		list_push_back (&dst->maps, &m->elem);
+	}
+	lock_release (&mman_lock);
+	return success;
+}
+
+/* Starts MM's heap, empty, at HEAP_START rounded up to a page. */
+void
+mman_set_heap (struct mman *mm, uintptr_t heap_start) {
+	mm->heap_start = mm->brk = ROUND_UP (heap_start, PGSIZE);
+}
+
+/* Moves the current process's break by INCREMENT bytes, mapping
+ * zeroed pages as it grows and freeing them as it shrinks.
+ * Returns the old break, or (void *) -1 if the heap cannot grow
+ * that far, would shrink below its start, or memory is
+ * exhausted.  The heap may not grow past MMAP_TOP, which keeps
+ * the stack's room free. */
+void *
+mman_sbrk (intptr_t increment) {
+	struct mman *mm = current_mman ();
+	uintptr_t old_brk, new_brk, old_top, new_top;
+	void *result = (void *) -1;
+
+	if (mm == NULL)
+		return result;
+	if (increment < 0)
+		uring_pause ();
+	lock_acquire (&mman_lock);
+	old_brk = mm->brk;
+	new_brk = old_brk + increment;
+	if (mm->heap_start == 0
+			|| (increment > 0 && (new_brk < old_brk || new_brk > MMAP_TOP))
+			|| (increment < 0 && (new_brk > old_brk
+					|| new_brk < mm->heap_start)))
+		goto done;
+
+	old_top = ROUND_UP (old_brk, PGSIZE);
+	new_top = ROUND_UP (new_brk, PGSIZE);
+	if (new_top > old_top) {
+		if (!enough_pages ((new_top - old_top) / PGSIZE)
+				|| !map_pages (old_top, (new_top - old_top) / PGSIZE, true))
+			goto done;
+	} else if (new_top < old_top)
+		unmap_pages (new_top, (old_top - new_top) / PGSIZE);
+	process_add_rss (((int64_t) new_top - (int64_t) old_top) / PGSIZE);
+	mm->brk = new_brk;
+	result = (void *) old_brk;
+
+done:
+	lock_release (&mman_lock);
+	if (increment < 0)
+		uring_resume ();
+	return result;
+}
+
+/* Maps LENGTH bytes, rounded up to whole pages, of zeroed memory
+ * into the current process, writable if WRITABLE is true.  If ADDR
+ * is nonnull, the mapping goes there, which must be page-aligned
+ * and where nothing may be mapped yet; otherwise the kernel picks
+ * a place.  Returns the address of the mapping, or a null pointer
+ * on failure. */
+void *
+mman_map (void *addr, size_t length, bool writable) {
+	struct mman *mm = current_mman ();
+	struct mman_map *m;
+	uintptr_t start;
+	size_t page_cnt;
+
+	if (mm == NULL || length == 0 || length > MMAP_TOP || pg_ofs (addr) != 0)
+		return NULL;
+	page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	if (!enough_pages (page_cnt))
+		return NULL;
+	m = malloc (sizeof *m);
+	if (m == NULL)
+		return NULL;
+
+	lock_acquire (&mman_lock);
+	start = addr != NULL ? (uintptr_t) addr : find_gap (mm, page_cnt);
+	if (start == 0 || !map_pages (start, page_cnt, writable)) {
+		lock_release (&mman_lock);
+		free (m);
+		return NULL;
+	}
+	m->addr = start;
+	m->page_cnt = page_cnt;
+	add_map (mm, m);
+	lock_release (&mman_lock);
+	process_add_rss (page_cnt);
+	return (void *) start;
+}
+
+/* Removes the current process's anonymous mapping that starts at
+ * ADDR, freeing its pages.  Returns false if there is none. */
+bool
+mman_unmap (void *addr) {
+	struct mman *mm = current_mman ();
+	struct mman_map *found = NULL;
+	struct list_elem *e;
+
+	if (mm == NULL)
+		return false;
+	uring_pause ();
+	lock_acquire (&mman_lock);
+	for (e = list_begin (&mm->maps); e != list_end (&mm->maps);
+			e = list_next (e)) {
+		struct mman_map *m = list_entry (e, struct mman_map, elem);
+
+		if (m->addr == (uintptr_t) addr) {
+			list_remove (&m->elem);
+			unmap_pages (m->addr, m->page_cnt);
+			found = m;
+			break;
+		}
+	}
+	lock_release (&mman_lock);
+	uring_resume ();
+
+	if (found == NULL)
+		return false;
+	process_add_rss (-(int64_t) found->page_cnt);
+	free (found);
+	return true;
+}
+
+/* Returns the current process's struct mman, or a null pointer if
+ * the process is a vfork() child borrowing its parent's address
+ * space. */
+static struct mman *
+current_mman (void) {
+	struct thread *leader = process_leader (thread_current ());
+
+	return leader->vfork_done == NULL ? &leader->mman : NULL;
+}
+
+/* Returns the address of the highest PAGE_CNT unmapped pages below
+ * MMAP_TOP and above MM's heap that none of MM's mappings use, or
+ * 0 if there are none. */
+static uintptr_t
+find_gap (struct mman *mm, size_t page_cnt) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	uintptr_t size = page_cnt * PGSIZE;
+	uintptr_t floor = ROUND_UP (mm->brk, PGSIZE);
+	uintptr_t top = MMAP_TOP;
+	struct list_elem *e = list_begin (&mm->maps);
+
+	/* Each pass looks at the gap between TOP and the next mapping
+	 * down, or the heap if there are none left.  Shared memory
+	 * and the like are not on the list, so every page is checked
+	 * too. */
+	for (;;) {
+		const struct mman_map *m = NULL;
+		uintptr_t bottom = floor;
+
+		if (e != list_end (&mm->maps)) {
+			m = list_entry (e, struct mman_map, elem);
+			if (m->addr + m->page_cnt * PGSIZE > bottom)
+				bottom = m->addr + m->page_cnt * PGSIZE;
+		}
+		while (top >= bottom + size) {
+			uintptr_t va = top - size;
+			size_t i;
+
+			for (i = 0; i < page_cnt; i++)
+				if (pml4_get_page (pml4, (void *) (va + i * PGSIZE)) != NULL)
+					break;
+			if (i == page_cnt)
+				return va;
+			/* Page I is in use, so look below it. */
+			top = va + i * PGSIZE;
+		}
+		if (m == NULL)
+			return 0;
+		if (m->addr < top)
+			top = m->addr;
+		e = list_next (e);
+	}
+}
+
+/* Adds M to MM's mappings, keeping them highest first. */
+static void
+add_map (struct mman *mm, struct mman_map *m) {
+	struct list_elem *e;
+
+	for (e = list_begin (&mm->maps); e != list_end (&mm->maps);
+			e = list_next (e))
+		if (list_entry (e, struct mman_map, elem)->addr < m->addr)
+			break;
+	list_insert (e, &m->elem);
+}
+
+/* Returns false if PAGE_CNT pages are sure not to be available,
+ * so that a huge request fails before map_pages() gets to work on
+ * it a page at a time. */
+static bool
+enough_pages (size_t page_cnt) {
+	return page_cnt <= palloc_free_cnt (PAL_USER);
+}
+
+/* Maps PAGE_CNT zeroed pages into the current process starting at
+ * ADDR, where nothing may be mapped yet.  On failure, maps none of
+ * them and returns false. */
+#ifndef VM
+static bool
+map_pages (uintptr_t addr, size_t page_cnt, bool writable) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	size_t i;
+
+	for (i = 0; i < page_cnt; i++) {
+		void *va = (void *) (addr + i * PGSIZE);
+
+		if (!is_user_vaddr (va) || (uintptr_t) va < addr
+				|| pml4_get_page (pml4, va) != NULL)
+			return false;
+	}
+	for (i = 0; i < page_cnt; i++) {
+		void *va = (void *) (addr + i * PGSIZE);
+		void *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+
+		if (kpage == NULL || !pml4_set_page (pml4, va, kpage, writable)) {
+			palloc_free_page (kpage);
+			unmap_pages (addr, i);
+			return false;
+		}
+	}
+	return true;
+}
+#else
+/* With VM, user pages belong to the supplemental page table, which
+ * has no anonymous memory to offer yet. */
+static bool
+map_pages (uintptr_t addr UNUSED, size_t page_cnt UNUSED,
+		bool writable UNUSED) {
+	return false;
+}
+#endif
+
+/* Unmaps and frees the PAGE_CNT pages of the current process
+ * starting at ADDR. */
+static void
+unmap_pages (uintptr_t addr, size_t page_cnt) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	size_t i;
+
+	for (i = 0; i < page_cnt; i++) {
+		void *va = (void *) (addr + i * PGSIZE);
+		void *kpage = pml4_get_page (pml4, va);
+
+		if (kpage != NULL) {
+			pml4_clear_page (pml4, va);
+			palloc_free_page (kpage);
+		}
+	}
+}
@@ -0,0 +1,360 @@
+#include "userprog/poll.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include "devices/input.h"
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/process.h"
+
+/* Waiting for file descriptors to become ready.
+
+   Each thing a descriptor can wait on, such as the console's input
+   buffer or a pipe, keeps a wait queue that it wakes whenever it
+   may have become ready.  To wait on several descriptors at once, a
+   thread puts a waiter on each of their queues, all upping one
+   semaphore, and sleeps on that semaphore until one of them is
+   woken or its timeout, kept by a timer alarm, runs out.  Files and
+   shared memory never make anyone wait, so they are always ready.
+
+   poll_fds() puts its waiters on the queues for the length of one
+   call.  An interest set, built with poll_ctl(), keeps them there
+   between calls to poll_wait(): a woken waiter joins the set's
+   ready list, so poll_wait() only looks at descriptors that may be
+   ready instead of at all of them.  A descriptor stays on the ready
+   list for as long as it is ready.
+
+   Each process has at most one interest set, made on first use,
+   which it does not pass on to its children.  The set belongs to
+   the process's main thread, like its file descriptors, so that a
+   close() in any thread takes the descriptor out of it; the
+   threads' changes to it are serialized by its lock. */
+
+/* A process's interest set. */
+struct poll_set {
+	struct lock lock;           /* Protects ENTRIES and their members. */
+	struct list entries;        /* List of struct poll_entry. */
+	struct list ready;          /* Waiters that may be ready. */
+	struct semaphore sema;      /* Upped when a waiter is woken. */
+};
+
+/* A descriptor in an interest set. */
+struct poll_entry {
+	int fd;                     /* File descriptor. */
+	uint32_t events;            /* Events of interest. */
+	uint64_t data;              /* Reported with its events. */
+	struct waiter waiter;       /* On FD's wait queue. */
+	struct list_elem elem;      /* Element in poll_set's entries. */
+};
+
+/* Events reported whether or not they were asked for. */
+#define POLL_ALWAYS (POLLERR | POLLHUP | POLLNVAL)
+
+/* Returns the events ready on FD in the current process.  If W is
+   nonnull, also puts it on the wait queue, if any, woken whenever
+   that may change.  Descriptors 0 and 1 stand for the console
+   unless a file has been put there. */
+static int
+fd_poll (int fd, struct waiter *w) {
+	struct file *file = process_get_file (fd);
+	int events;
+
+	if (file != NULL) {
+		events = file_poll (file, w);
+		process_put_file (file);
+		return events;
+	}
+	if (fd == STDIN_FILENO)
+		return input_poll (w) ? POLLIN : 0;
+	if (fd == STDOUT_FILENO)
+		return POLLOUT;
+	return POLLNVAL;
+}
+
+/* Returns true if a wait that was given a timeout of RELATIVE
+   ticks, which ends at tick DEADLINE, has run out of time. */
+static bool
+timed_out (int64_t relative, int64_t deadline) {
+	return relative == 0 || (relative > 0 && timer_ticks () >= deadline);
+}
+
+/* Fills in the revents member of the CNT descriptors in FDS with
+   the events ready on each.  If none is ready, waits until one is
+   or TIMEOUT ticks pass, whichever comes first.  A negative TIMEOUT
+   waits for as long as it takes, and 0 does not wait.  Returns the
+   number of descriptors with events, or -1 if memory is
+   exhausted. */
+int
+poll_fds (struct pollfd *fds, size_t cnt, int64_t timeout) {
+	int64_t deadline = timer_ticks () + timeout;
+	struct timer_alarm alarm;
+	struct semaphore sema;
+	struct waiter *waiters;
+	bool first = true;
+	int ready;
+	size_t i;
+
+	waiters = cnt > 0 ? calloc (cnt, sizeof *waiters) : NULL;
+	if (cnt > 0 && waiters == NULL)
+		return -1;
+	sema_init (&sema, 0);
+	for (i = 0; i < cnt; i++)
+		waiter_init (&waiters[i], &sema, NULL);
+	if (timeout > 0)
+		timer_alarm_set (&alarm, deadline, &sema);
+
+	for (;;) {
+		ready = 0;
+		for (i = 0; i < cnt; i++) {
+			struct waiter *w = first && timeout != 0 ? &waiters[i] : NULL;
+
+			fds[i].revents = 0;
+			if (fds[i].fd < 0)
+				continue;
+			fds[i].revents = fd_poll (fds[i].fd, w)
+				& (fds[i].events | POLL_ALWAYS);
+			if (fds[i].revents != 0)
+				ready++;
+		}
+		if (ready > 0 || timed_out (timeout, deadline))
+			break;
+		first = false;
+		sema_down (&sema);
+	}
+
+	if (timeout > 0)
+		timer_alarm_cancel (&alarm);
+	for (i = 0; i < cnt; i++)
+		waiter_remove (&waiters[i]);
+	free (waiters);
+	return ready;
+}
+
+/* Returns the current process's interest set, making it if it
+   does not have one yet.  Returns a null pointer if memory is
+   exhausted. */
+static struct poll_set *
+get_set (void) {
+	struct thread *leader = process_leader (thread_current ());
+
+	if (leader->poll_set == NULL) {
+		struct poll_set *set = malloc (sizeof *set);
+		enum intr_level old_level;
+
+		if (set == NULL)
+			return NULL;
+		lock_init (&set->lock);
+		list_init (&set->entries);
+		list_init (&set->ready);
+		sema_init (&set->sema, 0);
+
+		/* Another thread may have made one meanwhile. */
+		old_level = intr_disable ();
+		if (leader->poll_set == NULL) {
+			leader->poll_set = set;
+			set = NULL;
+		}
+		intr_set_level (old_level);
+		free (set);
+	}
+	return leader->poll_set;
+}
+
+/* Returns the entry for FD in SET, or a null pointer if there is
+   none. */
+static struct poll_entry *
+find_entry (struct poll_set *set, int fd) {
+	struct list_elem *e;
+
+	for (e = list_begin (&set->entries); e != list_end (&set->entries);
+			e = list_next (e)) {
+		struct poll_entry *pe = list_entry (e, struct poll_entry, elem);
+
+		if (pe->fd == fd)
+			return pe;
+	}
+	return NULL;
+}
+
+/* Puts W on its ready list, if it is not there yet, as though it
+   had been woken, but without upping its semaphore. */
+static void
+make_ready (struct waiter *w) {
+	enum intr_level old_level = intr_disable ();
+
+	if (!w->woken) {
+		w->woken = true;
+		list_push_back (w->ready, &w->ready_elem);
+	}
+	intr_set_level (old_level);
+}
+
+/* Removes PE from its set and frees it. */
+static void
+remove_entry (struct poll_entry *pe) {
+	waiter_remove (&pe->waiter);
+	list_remove (&pe->elem);
+	free (pe);
+}
+
+/* Changes the current process's interest set as OP, one of
+   EPOLL_CTL_*, says: adds FD to it with the events and data in EV,
+   changes them for FD, or removes FD.  Returns false if FD is not
+   open, if it is already in the set for EPOLL_CTL_ADD or not in it
+   otherwise, or if memory is exhausted. */
+bool
+poll_ctl (int op, int fd, const struct epoll_event *ev) {
+	struct poll_set *set = get_set ();
+	struct poll_entry *pe;
+	bool success = false;
+
+	if (set == NULL)
+		return false;
+	lock_acquire (&set->lock);
+	pe = find_entry (set, fd);
+
+	switch (op) {
+		case EPOLL_CTL_ADD:
+			if (pe != NULL || fd_poll (fd, NULL) & POLLNVAL)
+				break;
+			pe = malloc (sizeof *pe);
+			if (pe == NULL)
+				break;
+			pe->fd = fd;
+			pe->events = ev->events;
+			pe->data = ev->data;
+			waiter_init (&pe->waiter, &set->sema, &set->ready);
+			list_push_back (&set->entries, &pe->elem);
+			fd_poll (fd, &pe->waiter);
+			make_ready (&pe->waiter);
+			success = true;
+			break;
+
+		case EPOLL_CTL_MOD:
+			if (pe == NULL)
+				break;
+			pe->events = ev->events;
+			pe->data = ev->data;
+			make_ready (&pe->waiter);
+			success = true;
+			break;
+
+		case EPOLL_CTL_DEL:
+			if (pe == NULL)
+				break;
+			remove_entry (pe);
+			success = true;
+			break;
+
+		default:
+			break;
+	}
+	lock_release (&set->lock);
+	return success;
+}
+
+/* Stores in EVENTS up to MAX events ready on descriptors in the
+   current process's interest set.  If none is ready, waits until
+   one is or TIMEOUT ticks pass, as in poll_fds().  Returns the
+   number of events stored, or -1 if memory is exhausted. */
+int
+poll_wait (struct epoll_event *events, int max, int64_t timeout) {
+	int64_t deadline = timer_ticks () + timeout;
+	struct poll_set *set = get_set ();
+	struct timer_alarm alarm;
+	int cnt;
+
+	if (set == NULL)
+		return -1;
+	if (timeout > 0)
+		timer_alarm_set (&alarm, deadline, &set->sema);
+
+	for (;;) {
+		enum intr_level old_level;
+		size_t left;
+
+		/* Wakeups from before this point are about to be seen. */
+		while (sema_try_down (&set->sema))
+			continue;
+
+		/* Look at each waiter that was on the ready list, taking it
+		   off and putting it back at the end if it is still ready.
+		   Waiters woken meanwhile join the end too, to be looked at
+		   next time around. */
+		cnt = 0;
+		lock_acquire (&set->lock);
+		old_level = intr_disable ();
+		left = list_size (&set->ready);
+		intr_set_level (old_level);
+		while (left-- > 0) {
+			struct poll_entry *pe;
+			int revents;
+
+			old_level = intr_disable ();
+			if (list_empty (&set->ready)) {
+				intr_set_level (old_level);
+				break;
+			}
+			pe = list_entry (list_pop_front (&set->ready), struct poll_entry,
+					waiter.ready_elem);
+			pe->waiter.woken = false;
+			intr_set_level (old_level);
+
+			revents = fd_poll (pe->fd, NULL) & (pe->events | POLL_ALWAYS);
+			if (revents == 0)
+				continue;
+			if (cnt < max) {
+				events[cnt].events = revents;
+				events[cnt].data = pe->data;
+				cnt++;
+			}
+			make_ready (&pe->waiter);
+		}
+		lock_release (&set->lock);
+		if (cnt > 0 || timed_out (timeout, deadline))
+			break;
+		sema_down (&set->sema);
+	}
+
+	if (timeout > 0)
+		timer_alarm_cancel (&alarm);
+	return cnt;
+}
+
+/* Removes FD from the current process's interest set, if it is
+   there.  Called when FD is closed. */
+void
+poll_forget (int fd) {
+	struct poll_set *set = process_leader (thread_current ())->poll_set;
+	struct poll_entry *pe;
+
+	if (set == NULL)
+		return;
+	lock_acquire (&set->lock);
+	pe = find_entry (set, fd);
+	if (pe != NULL)
+		remove_entry (pe);
+	lock_release (&set->lock);
+}
+
+/* Frees the current process's interest set, if it has one.  Called
+   by the process's main thread once the others have exited. */
+void
+poll_destroy (void) {
+	struct thread *t = thread_current ();
+	struct poll_set *set = t->poll_set;
+
+	ASSERT (t->leader == NULL);
+
+	if (set == NULL)
+		return;
+	while (!list_empty (&set->entries))
+		remove_entry (list_entry (list_front (&set->entries),
+					struct poll_entry, elem));
+	free (set);
+	t->poll_set = NULL;
+}
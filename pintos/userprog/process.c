@@ -2,18 +2,30 @@
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "userprog/fdtable.h"
 #include "userprog/gdt.h"
+#include "userprog/image.h"
+#include "userprog/mman.h"
+#include "userprog/poll.h"
+#include "userprog/shm.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "userprog/uring.h"
+#include "userprog/vdso.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
@@ -22,15 +34,164 @@
 #include "vm/vm.h"
 #endif
 
+/* Model-specific register holding the FS segment base. */
+#define MSR_FS_BASE 0xc0000100
+
+/* A child process's exit record.  It is shared between the child,
+ * which fills it in when it exits, and the parent, which reads it
+ * in process_wait(), and freed by whichever lets go of it last. */
+struct child {
+	tid_t tid;                  /* Child's thread id. */
+	int exit_status;            /* Status passed to exit(). */
+	struct semaphore exited;    /* Upped when the child exits. */
+	int ref_cnt;                /* 2 while both parent and child live. */
+	struct rusage usage;        /* Resources used by the child and the
+	                               children it waited for. */
+	struct list_elem elem;      /* Element in parent's children list. */
+};
+
+/* Arguments to initd(). */
+struct initd_args {
+	char *cmd_line;             /* Command line, in a page of its own. */
+	struct child *child;        /* Exit record for the new process. */
+};
+
+/* Arguments to __do_fork() and do_vfork(), owned by the parent's
+ * clone_process(). */
+struct fork_args {
+	struct thread *parent;      /* Process being cloned. */
+	struct intr_frame *parent_if;   /* Parent's user context. */
+	struct child *child;        /* Exit record for the new process. */
+	struct semaphore done;      /* Upped once the child is set up. */
+	bool success;               /* Whether the child was set up. */
+};
+
+/* Arguments to do_spawn(), owned by the parent's process_spawn(). */
+struct spawn_args {
+	struct thread *parent;      /* Process starting the program. */
+	const char *path;           /* Executable to load. */
+	char *cmd_line;             /* Arguments, separated by spaces. */
+	const struct spawn_action *actions;  /* File actions to carry out. */
+	size_t action_cnt;          /* Number of ACTIONS. */
+	struct child *child;        /* Exit record for the new process. */
+	struct semaphore done;      /* Upped once the child is loaded. */
+	bool success;               /* Whether the child was loaded. */
+};
+
+/* Arguments to do_thread_spawn(), owned by the caller's
+ * process_thread_spawn(). */
+struct thread_args {
+	struct thread *leader;      /* Main thread of the process. */
+	uint64_t entry;             /* Where the thread starts... */
+	uint64_t stack;             /* ...with this stack pointer... */
+	uint64_t arg0, arg1;        /* ...and these in rdi and rsi. */
+	struct child *child;        /* Exit record, for process_join(). */
+	struct semaphore done;      /* Upped once the thread is set up. */
+};
+
+/* A copy of a process's address space, from which
+ * process_spawn_template() starts new processes that need no
+ * loading or initialization.  See process_template_mark(). */
+struct template {
+	tid_t tid;                  /* Process that made it. */
+	char name[16];              /* Name for the processes it starts. */
+	uint64_t *pml4;             /* Copy of the address space. */
+	struct mman mman;           /* Its heap and anonymous mappings. */
+	struct image *image;        /* Executable it was loaded from. */
+	uint64_t entry;             /* Where new processes start... */
+	uint64_t arg;               /* ...with this in rdx. */
+	int ref_cnt;                /* Maker, plus processes being started. */
+	struct list_elem elem;      /* Element in template_list. */
+};
+
+/* Arguments to do_spawn_template(), owned by the parent's
+ * process_spawn_template(). */
+struct template_args {
+	struct thread *parent;      /* Process starting the child. */
+	struct template *template;  /* Template to start it from. */
+	char *cmd_line;             /* Arguments, separated by spaces. */
+	struct child *child;        /* Exit record for the new process. */
+	struct semaphore done;      /* Upped once the child is set up. */
+	bool success;               /* Whether the child was set up. */
+};
+
+/* Templates that processes have made.  Accessed with interrupts
+ * off. */
+static struct list template_list;
+
 static void process_cleanup (void);
-static bool load (const char *file_name, struct intr_frame *if_);
-static void initd (void *f_name);
+static bool load (const char *path, char *cmd_line, struct intr_frame *if_);
+static void initd (void *aux);
+static tid_t clone_process (const char *name, struct intr_frame *if_,
+		thread_func *);
 static void __do_fork (void *);
+static void do_vfork (void *);
+static void do_spawn (void *);
+static void do_spawn_template (void *);
+#ifndef VM
+static void do_thread_spawn (void *);
+#endif
+static void wait_for_threads (void);
+static bool copy_address_space (uint64_t *dst, uint64_t *src,
+		const struct image *, struct thread *owner);
+static void template_release (struct template *);
+static void template_drop (void);
+static bool push_arguments (char *file_name, char **save_ptr,
+		struct intr_frame *if_);
+static bool duplicate_files (struct thread *parent);
+static bool do_file_actions (const struct spawn_action *, size_t cnt);
+static bool install_file (int fd, struct file *);
+static void add_usage (struct rusage *dst, const struct rusage *src);
+static void add_thread_usage (struct thread *, void *ru);
 
 /* General process initializer for initd and other process. */
-static void
+static bool
 process_init (void) {
 	struct thread *current = thread_current ();
+
+	current->fd_table = fdt_create ();
+	return current->fd_table != NULL;
+}
+
+/* Creates an exit record for a new child process or thread and
+ * adds it to LIST, which is the current thread's children or its
+ * main thread's threads.  Returns a null pointer if memory is
+ * exhausted. */
+static struct child *
+child_create (struct list *list) {
+	struct child *c = malloc (sizeof *c);
+
+	if (c != NULL) {
+		enum intr_level old_level;
+
+		c->tid = TID_ERROR;
+		c->exit_status = -1;
+		sema_init (&c->exited, 0);
+		c->ref_cnt = 2;
+		old_level = intr_disable ();
+		list_push_back (list, &c->elem);
+		intr_set_level (old_level);
+	}
+	return c;
+}
+
+/* Returns the main thread of T's process, which owns the state
+ * that the process's threads share. */
+struct thread *
+process_leader (struct thread *t) {
+	return t->leader != NULL ? t->leader : t;
+}
+
+/* Drops one reference to exit record C, freeing it if that was
+ * the last one. */
+static void
+child_release (struct child *c) {
+	enum intr_level old_level = intr_disable ();
+	bool last = --c->ref_cnt == 0;
+	intr_set_level (old_level);
+
+	if (last)
+		free (c);
 }
 
 /* Starts the first userland program, called "initd", loaded from FILE_NAME.
@@ -40,33 +201,63 @@ process_init (void) {
  * Notice that THIS SHOULD BE CALLED ONCE. */
 tid_t
 process_create_initd (const char *file_name) {
-	char *fn_copy;
+	struct initd_args *args;
+	char name[sizeof thread_current ()->name];
 	tid_t tid;
 
+	args = malloc (sizeof *args);
+	if (args == NULL)
+		return TID_ERROR;
+	args->child = NULL;
+
 	/* Make a copy of FILE_NAME.
 	 * Otherwise there's a race between the caller and load(). */
-	fn_copy = palloc_get_page (0);
-	if (fn_copy == NULL)
-		return TID_ERROR;
-	strlcpy (fn_copy, file_name, PGSIZE);
+	args->cmd_line = palloc_get_page (0);
+	if (args->cmd_line == NULL)
+		goto error;
+	strlcpy (args->cmd_line, file_name, PGSIZE);
 
-	/* Create a new thread to execute FILE_NAME. */
-	tid = thread_create (file_name, PRI_DEFAULT, initd, fn_copy);
-	if (tid == TID_ERROR)
-		palloc_free_page (fn_copy);
-	return tid;
+	args->child = child_create (&thread_current ()->children);
+	if (args->child == NULL)
+		goto error;
+
+	/* Create a new thread to execute FILE_NAME, named after the
+	 * program without its arguments. */
+	strlcpy (name, file_name, sizeof name);
+	name[strcspn (name, " ")] = '\0';
+	tid = args->child->tid = thread_create (name, PRI_DEFAULT, initd, args);
+	if (tid != TID_ERROR)
+		return tid;
+
+error:
+	if (args->child != NULL) {
+		list_remove (&args->child->elem);
+		free (args->child);
+	}
+	palloc_free_page (args->cmd_line);
+	free (args);
+	return TID_ERROR;
 }
 
 /* A thread function that launches first user process. */
 static void
-initd (void *f_name) {
+initd (void *aux) {
+	struct initd_args *args = aux;
+	char *cmd_line = args->cmd_line;
+
+	thread_current ()->child = args->child;
+	free (args);
+
 #ifdef VM
 	supplemental_page_table_init (&thread_current ()->spt);
 #endif
 
-	process_init ();
+	if (!process_init ()) {
+		palloc_free_page (cmd_line);
+		thread_exit ();
+	}
 
-	if (process_exec (f_name) < 0)
+	if (process_exec (cmd_line) < 0)
 		PANIC("Fail to launch initd\n");
 	NOT_REACHED ();
 }
@@ -74,42 +265,182 @@ initd (void *f_name) {
 /* Clones the current process as `name`. Returns the new process's thread id, or
  * TID_ERROR if the thread cannot be created. */
 tid_t
-process_fork (const char *name, struct intr_frame *if_ UNUSED) {
+process_fork (const char *name, struct intr_frame *if_) {
+	return clone_process (name, if_, __do_fork);
+}
+
+/* Creates a child process named NAME that runs in the current
+ * process's address space, starting from the user context IF_,
+ * and blocks until the child calls exec() or exits.  Cheaper than
+ * process_fork() for a child that is about to exec(), because the
+ * address space is lent rather than copied.  Returns the child's
+ * thread id, or TID_ERROR if it cannot be created. */
+tid_t
+process_vfork (const char *name, struct intr_frame *if_) {
+	return clone_process (name, if_, do_vfork);
+}
+
+/* Starts a child process named NAME that runs FUNC, which is
+ * __do_fork() or do_vfork(), to take over the user context IF_.
+ * Returns the child's thread id, or TID_ERROR on failure. */
+static tid_t
+clone_process (const char *name, struct intr_frame *if_, thread_func *func) {
+	struct fork_args args;
+	tid_t tid;
+
+	args.parent = thread_current ();
+	args.parent_if = if_;
+	args.child = child_create (&thread_current ()->children);
+	if (args.child == NULL)
+		return TID_ERROR;
+	sema_init (&args.done, 0);
+	args.success = false;
+
 	/* Clone current thread to new thread.*/
-	return thread_create (name,
-			PRI_DEFAULT, __do_fork, thread_current ());
+	tid = args.child->tid = thread_create (name, PRI_DEFAULT, func, &args);
+	if (tid == TID_ERROR) {
+		list_remove (&args.child->elem);
+		free (args.child);
+		return TID_ERROR;
+	}
+
+	/* The child reads ARGS and our address space, so we may not
+	 * return until it is done with them.  If it failed, reap it. */
+	sema_down (&args.done);
+	if (!args.success) {
+		process_wait (tid);
+		return TID_ERROR;
+	}
+	return tid;
+}
+
+/* Starts the executable PATH as a new child process, passing it
+ * the words of CMD_LINE as arguments, after carrying out the
+ * ACTION_CNT file actions in ACTIONS on the file descriptors that
+ * it inherits.  Unlike fork() followed by exec(), this never
+ * copies the current address space.  CMD_LINE is modified.
+ * Returns the child's thread id, or TID_ERROR if the program
+ * cannot be started. */
+tid_t
+process_spawn (const char *path, char *cmd_line,
+		const struct spawn_action *actions, size_t action_cnt) {
+	struct spawn_args args;
+	tid_t tid;
+
+	args.parent = thread_current ();
+	args.path = path;
+	args.cmd_line = cmd_line;
+	args.actions = actions;
+	args.action_cnt = action_cnt;
+	args.child = child_create (&thread_current ()->children);
+	if (args.child == NULL)
+		return TID_ERROR;
+	sema_init (&args.done, 0);
+	args.success = false;
+
+	tid = args.child->tid = thread_create (path, PRI_DEFAULT, do_spawn, &args);
+	if (tid == TID_ERROR) {
+		list_remove (&args.child->elem);
+		free (args.child);
+		return TID_ERROR;
+	}
+
+	/* As in clone_process(), wait until the child is done with
+	 * ARGS and our files, and reap it if it failed. */
+	sema_down (&args.done);
+	if (!args.success) {
+		process_wait (tid);
+		return TID_ERROR;
+	}
+	return tid;
 }
 
 #ifndef VM
+/* Page maps for duplicate_pte() to copy between. */
+struct pte_copy {
+	uint64_t *src;              /* Page map to copy. */
+	uint64_t *dst;              /* Page map to copy into. */
+	const struct image *image;  /* Executable whose text is shared. */
+	struct thread *owner;       /* Process whose shared memory to skip. */
+	size_t page_cnt;            /* Pages mapped into DST so far. */
+};
+
 /* Duplicate the parent's address space by passing this function to the
  * pml4_for_each. This is only for the project 2. */
 static bool
 duplicate_pte (uint64_t *pte, void *va, void *aux) {
-	struct thread *current = thread_current ();
-	struct thread *parent = (struct thread *) aux;
+	struct pte_copy *copy = aux;
 	void *parent_page;
 	void *newpage;
 	bool writable;
 
-	/* 1. TODO: If the parent_page is kernel page, then return immediately. */
-
-	/* 2. Resolve VA from the parent's page map level 4. */
-	parent_page = pml4_get_page (parent->pml4, va);
+	/* 1. If the parent_page is kernel page, then return immediately.
+	 *    The shared data page is not copied either; __do_fork() maps
+	 *    it into the child.  Nor is the parent's ring, which the
+	 *    child does not inherit, nor its shared memory, which
+	 *    shm_fork() maps. */
+	if (is_kernel_vaddr (va) || va == (void *) VDSO_ADDR
+			|| va == (void *) URING_ADDR
+			|| (copy->owner != NULL && shm_contains (copy->owner, va)))
+		return true;
+
+	/* 2. Resolve VA from the parent's page map level 4.  A page of
+	 *    the executable's text is shared, not copied. */
+	parent_page = pml4_get_page (copy->src, va);
+	if (image_is_shared (copy->image, va, parent_page)) {
+		if (!pml4_set_page (copy->dst, va, parent_page, false))
+			return false;
+		copy->page_cnt++;
+		return true;
+	}
 
-	/* 3. TODO: Allocate new PAL_USER page for the child and set result to
-	 *    TODO: NEWPAGE. */
+	/* 3. Allocate new PAL_USER page for the child and set result to
+	 *    NEWPAGE. */
+	newpage = palloc_get_page (PAL_USER);
+	if (newpage == NULL)
+		return false;
 
-	/* 4. TODO: Duplicate parent's page to the new page and
-	 *    TODO: check whether parent's page is writable or not (set WRITABLE
-	 *    TODO: according to the result). */
+	/* 4. Duplicate parent's page to the new page and
+	 *    check whether parent's page is writable or not (set WRITABLE
+	 *    according to the result). */
+	memcpy (newpage, parent_page, PGSIZE);
+	writable = is_writable (pte);
 
 	/* 5. Add new page to child's page table at address VA with WRITABLE
 	 *    permission. */
-	if (!pml4_set_page (current->pml4, va, newpage, writable)) {
-		/* 6. TODO: if fail to insert page, do error handling. */
+	if (!pml4_set_page (copy->dst, va, newpage, writable)) {
+		/* 6. If fail to insert page, do error handling. */
+		palloc_free_page (newpage);
+		return false;
 	}
+	copy->page_cnt++;
 	return true;
 }
+
+/* Copies the user pages mapped in SRC into DST, except that the
+ * text pages of IMAGE are shared rather than copied, and the
+ * shared memory mappings of OWNER, the process using SRC if any,
+ * are left out.  The pages count towards the current process's
+ * resident set if DST is its page map.  Returns false if memory
+ * is exhausted. */
+static bool
+copy_address_space (uint64_t *dst, uint64_t *src, const struct image *image,
+		struct thread *owner) {
+	struct pte_copy copy = {src, dst, image, owner, 0};
+	bool success = pml4_for_each (src, duplicate_pte, &copy);
+
+	if (dst == thread_current ()->pml4)
+		process_add_rss (copy.page_cnt);
+	return success;
+}
+#else
+/* With VM, pages belong to the supplemental page table, which
+ * process templates do not support yet. */
+static bool
+copy_address_space (uint64_t *dst UNUSED, uint64_t *src UNUSED,
+		const struct image *image UNUSED, struct thread *owner UNUSED) {
+	return false;
+}
 #endif
 
 /* A thread function that copies parent's execution context.
@@ -118,19 +449,30 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
  *       this function. */
 static void
 __do_fork (void *aux) {
+	struct fork_args *args = aux;
 	struct intr_frame if_;
-	struct thread *parent = (struct thread *) aux;
+	struct thread *parent = args->parent;
+	struct thread *leader = process_leader (parent);
 	struct thread *current = thread_current ();
-	/* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-	struct intr_frame *parent_if;
-	bool succ = true;
+	struct intr_frame *parent_if = args->parent_if;
+	bool succ;
 
-	/* 1. Read the cpu context to local stack. */
-	memcpy (&if_, parent_if, sizeof (struct intr_frame));
+	current->child = args->child;
+	current->fs_base = parent->fs_base;
 
-	/* 2. Duplicate PT */
+	/* 1. Read the cpu context to local stack.  The child sees 0 as
+	 *    the return value of fork(). */
+	memcpy (&if_, parent_if, sizeof (struct intr_frame));
+	if_.R.rax = 0;
+
+	/* 2. Duplicate PT.  We share the parent's executable image.
+	 *    The parent may be one of several threads, so what belongs
+	 *    to its whole process is found in its main thread. */
+	lock_acquire (&filesys_lock);
+	current->image = image_ref (leader->image);
+	lock_release (&filesys_lock);
 	current->pml4 = pml4_create();
-	if (current->pml4 == NULL)
+	if (current->pml4 == NULL || !vdso_map (current->pml4))
 		goto error;
 
 	process_activate (current);
@@ -139,32 +481,581 @@ __do_fork (void *aux) {
 	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
 		goto error;
 #else
-	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
+	if (!copy_address_space (current->pml4, parent->pml4, current->image,
+				leader)
+			|| !shm_fork (leader))
 		goto error;
 #endif
+	if (!mman_copy (&current->mman, &leader->mman))
+		goto error;
 
-	/* TODO: Your code goes here.
-	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
-	 * TODO:       in include/filesys/file.h. Note that parent should not return
-	 * TODO:       from the fork() until this function successfully duplicates
-	 * TODO:       the resources of parent.*/
-
-	process_init ();
+	/* 3. Duplicate the open files.  The parent does not return
+	 *    from fork() until we are done with its resources. */
+	succ = duplicate_files (parent);
+	if (succ && leader->exec_file != NULL) {
+		lock_acquire (&filesys_lock);
+		current->exec_file = file_duplicate (leader->exec_file);
+		lock_release (&filesys_lock);
+		succ = current->exec_file != NULL;
+	}
 
 	/* Finally, switch to the newly created process. */
-	if (succ)
+	if (succ) {
+		args->success = true;
+		sema_up (&args->done);
 		do_iret (&if_);
+	}
 error:
+	sema_up (&args->done);
 	thread_exit ();
 }
 
+/* A thread function that takes over the user context of the
+ * parent in process_vfork(), running in the parent's address
+ * space.  process_cleanup() hands the address space back when we
+ * exec() or exit, which lets the parent go on. */
+static void
+do_vfork (void *aux) {
+	struct fork_args *args = aux;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+
+	current->child = args->child;
+
+	memcpy (&if_, args->parent_if, sizeof if_);
+	if_.R.rax = 0;
+
+	current->pml4 = args->parent->pml4;
+	current->fs_base = args->parent->fs_base;
+	current->vfork_done = &args->done;
+	process_activate (current);
+#ifdef VM
+	supplemental_page_table_init (&current->spt);
+#endif
+
+	if (!duplicate_files (args->parent))
+		thread_exit ();
+	args->success = true;
+	do_iret (&if_);
+}
+
+/* A thread function that loads the program for process_spawn(). */
+static void
+do_spawn (void *aux) {
+	struct spawn_args *args = aux;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+	bool success;
+
+	current->child = args->child;
+#ifdef VM
+	supplemental_page_table_init (&current->spt);
+#endif
+
+	memset (&if_, 0, sizeof if_);
+	if_.ds = if_.es = if_.ss = SEL_UDSEG;
+	if_.cs = SEL_UCSEG;
+	if_.eflags = FLAG_IF | FLAG_MBS;
+
+	success = (duplicate_files (args->parent)
+			&& do_file_actions (args->actions, args->action_cnt)
+			&& load (args->path, args->cmd_line, &if_));
+
+	/* ARGS belongs to the parent, which may return as soon as we
+	 * let it go. */
+	args->success = success;
+	sema_up (&args->done);
+	if (!success)
+		thread_exit ();
+	do_iret (&if_);
+}
+
+#ifndef VM
+/* Starts a new thread in the current process, sharing its address
+ * space and open files, that begins running user code at ENTRY
+ * with stack pointer STACK and ARG0 and ARG1 in rdi and rsi.  The
+ * process lasts until all of its threads have exited.  Returns the
+ * new thread's id, for process_join(), or TID_ERROR on failure. */
+tid_t
+process_thread_spawn (uint64_t entry, uint64_t stack, uint64_t arg0,
+		uint64_t arg1) {
+	struct thread *curr = thread_current ();
+	struct thread_args args;
+	enum intr_level old_level;
+	tid_t tid;
+
+	args.leader = process_leader (curr);
+	args.entry = entry;
+	args.stack = stack;
+	args.arg0 = arg0;
+	args.arg1 = arg1;
+	args.child = child_create (&args.leader->threads);
+	if (args.child == NULL)
+		return TID_ERROR;
+	sema_init (&args.done, 0);
+
+	/* Count the thread before it exists, so that the main thread
+	 * cannot tear the address space down under it. */
+	old_level = intr_disable ();
+	args.leader->thread_cnt++;
+	intr_set_level (old_level);
+
+	tid = args.child->tid = thread_create (args.leader->name, PRI_DEFAULT,
+			do_thread_spawn, &args);
+	if (tid == TID_ERROR) {
+		old_level = intr_disable ();
+		list_remove (&args.child->elem);
+		args.leader->thread_cnt--;
+		intr_set_level (old_level);
+		free (args.child);
+		return TID_ERROR;
+	}
+	sema_down (&args.done);
+	return tid;
+}
+
+/* A thread function that starts a thread for
+ * process_thread_spawn() in its main thread's address space. */
+static void
+do_thread_spawn (void *aux) {
+	struct thread_args *args = aux;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+
+	current->leader = args->leader;
+	current->child = args->child;
+	current->pml4 = args->leader->pml4;
+	current->fd_table = args->leader->fd_table;
+	process_activate (current);
+
+	memset (&if_, 0, sizeof if_);
+	if_.ds = if_.es = if_.ss = SEL_UDSEG;
+	if_.cs = SEL_UCSEG;
+	if_.eflags = FLAG_IF | FLAG_MBS;
+	if_.rip = args->entry;
+	if_.rsp = args->stack;
+	if_.R.rdi = args->arg0;
+	if_.R.rsi = args->arg1;
+
+	/* ARGS belongs to the caller, which may return as soon as we
+	 * let it go. */
+	sema_up (&args->done);
+	do_iret (&if_);
+}
+#else
+/* With VM, pages belong to each thread's supplemental page table,
+ * which threads cannot share yet. */
+tid_t
+process_thread_spawn (uint64_t entry UNUSED, uint64_t stack UNUSED,
+		uint64_t arg0 UNUSED, uint64_t arg1 UNUSED) {
+	return TID_ERROR;
+}
+#endif
+
+/* Waits for thread TID of the current process to exit and
+ * returns the status it passed to exit().  Returns -1 at once if
+ * TID is not a thread of this process other than its main thread,
+ * or has already been joined. */
+int
+process_join (tid_t tid) {
+	struct thread *leader = process_leader (thread_current ());
+	struct child *found = NULL;
+	enum intr_level old_level;
+	struct list_elem *e;
+	int status;
+
+	/* Take the record off the list at once, so that only one
+	 * thread can join TID. */
+	old_level = intr_disable ();
+	for (e = list_begin (&leader->threads); e != list_end (&leader->threads);
+			e = list_next (e)) {
+		struct child *c = list_entry (e, struct child, elem);
+
+		if (c->tid == tid) {
+			list_remove (&c->elem);
+			found = c;
+			break;
+		}
+	}
+	intr_set_level (old_level);
+	if (found == NULL)
+		return -1;
+
+	sema_down (&found->exited);
+	status = found->exit_status;
+	child_release (found);
+	return status;
+}
+
+/* Waits until the current thread, a process's main thread, is the
+ * last of the process's threads left. */
+static void
+wait_for_threads (void) {
+	struct thread *curr = thread_current ();
+	struct semaphore done;
+	enum intr_level old_level;
+
+	sema_init (&done, 0);
+	old_level = intr_disable ();
+	if (curr->thread_cnt > 0) {
+		curr->threads_done = &done;
+		intr_set_level (old_level);
+		sema_down (&done);
+		curr->threads_done = NULL;
+	} else
+		intr_set_level (old_level);
+}
+
+/* Sets the current thread's FS base, which user code uses to find
+ * its thread-local storage, to BASE.  Returns false if BASE is not
+ * a user address. */
+bool
+process_set_tls (uint64_t base) {
+	if (base != 0 && !is_user_vaddr ((void *) base))
+		return false;
+	thread_current ()->fs_base = base;
+	write_msr (MSR_FS_BASE, base);
+	return true;
+}
+
+/* Records that the current process has mapped PAGES more user
+ * pages, or fewer if PAGES is negative, and raises its peak
+ * resident set size to match. */
+void
+process_add_rss (int64_t pages) {
+	struct thread *leader = process_leader (thread_current ());
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	leader->rss += pages;
+	if (leader->rss > leader->usage.max_rss)
+		leader->usage.max_rss = leader->rss;
+	intr_set_level (old_level);
+}
+
+/* Stores in *RU the resources used by the current process, all of
+ * its threads included, if WHO is RUSAGE_SELF, or by the children
+ * it has waited for and theirs, if WHO is RUSAGE_CHILDREN.  Returns
+ * false if WHO is neither. */
+bool
+process_getrusage (int who, struct rusage *ru) {
+	struct thread *leader = process_leader (thread_current ());
+	enum intr_level old_level;
+
+	if (who != RUSAGE_SELF && who != RUSAGE_CHILDREN)
+		return false;
+
+	/* Threads that have exited are already in their main thread's
+	 * usage.  Those still running are added in here. */
+	old_level = intr_disable ();
+	if (who == RUSAGE_CHILDREN)
+		*ru = leader->child_usage;
+	else {
+		*ru = leader->usage;
+		thread_foreach (add_thread_usage, ru);
+	}
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Adds the resources in SRC to those in DST.  The peak resident
+ * set size is the larger of the two, not their sum. */
+static void
+add_usage (struct rusage *dst, const struct rusage *src) {
+	dst->user_ticks += src->user_ticks;
+	dst->kernel_ticks += src->kernel_ticks;
+	dst->voluntary_switches += src->voluntary_switches;
+	dst->involuntary_switches += src->involuntary_switches;
+	dst->nonpresent_faults += src->nonpresent_faults;
+	dst->protection_faults += src->protection_faults;
+	if (src->max_rss > dst->max_rss)
+		dst->max_rss = src->max_rss;
+	dst->bytes_read += src->bytes_read;
+	dst->bytes_written += src->bytes_written;
+	dst->syscalls += src->syscalls;
+}
+
+/* A thread_foreach() function that adds T's usage to RU if T is one
+ * of the current process's threads, other than its main thread. */
+static void
+add_thread_usage (struct thread *t, void *ru) {
+	if (t->leader != NULL && t->leader == process_leader (thread_current ()))
+		add_usage (ru, &t->usage);
+}
+
+/* Initializes process templates. */
+void
+process_template_init (void) {
+	list_init (&template_list);
+}
+
+/* Makes a template of the current process: a copy of its address
+ * space as it is now, from which process_spawn_template() starts
+ * new processes at user address ENTRY, with ARG in rdx.  So a
+ * program with costly initialization can do it once and then
+ * start copies of itself that are already initialized.  Replaces
+ * the process's earlier template, if any.  Shared memory mappings
+ * are left out of it.  The template lasts until the process exits
+ * or calls exec().  Returns false if memory is exhausted. */
+bool
+process_template_mark (uint64_t entry, uint64_t arg) {
+	struct thread *curr = thread_current ();
+	struct thread *leader = process_leader (curr);
+	struct template *t;
+	enum intr_level old_level;
+
+	t = malloc (sizeof *t);
+	if (t == NULL)
+		return false;
+	t->tid = curr->tid;
+	strlcpy (t->name, curr->name, sizeof t->name);
+	t->entry = entry;
+	t->arg = arg;
+	t->ref_cnt = 1;
+	mman_create (&t->mman);
+	lock_acquire (&filesys_lock);
+	t->image = image_ref (leader->image);
+	lock_release (&filesys_lock);
+	t->pml4 = pml4_create ();
+	if (t->pml4 == NULL
+			|| !copy_address_space (t->pml4, curr->pml4, t->image, leader)
+			|| !mman_copy (&t->mman, &leader->mman)) {
+		template_release (t);
+		return false;
+	}
+
+	template_drop ();
+	old_level = intr_disable ();
+	list_push_back (&template_list, &t->elem);
+	intr_set_level (old_level);
+	curr->template = t;
+	return true;
+}
+
+/* Starts a new child process from the template made by process
+ * TID, passing it the words of CMD_LINE as arguments.  The child
+ * gets a copy of the template's address space, with its stack
+ * pointer back at the top of the stack, where the arguments go,
+ * and duplicates of the current process's open files.  CMD_LINE
+ * is modified.  Returns the child's thread id, or TID_ERROR if
+ * TID has no template, CMD_LINE is empty or memory is
+ * exhausted. */
+tid_t
+process_spawn_template (tid_t tid, char *cmd_line) {
+	struct template_args args;
+	struct list_elem *e;
+	enum intr_level old_level;
+	tid_t child_tid = TID_ERROR;
+
+	/* Keep the template alive while we use it, even if its maker
+	 * exits. */
+	args.template = NULL;
+	old_level = intr_disable ();
+	for (e = list_begin (&template_list); e != list_end (&template_list);
+			e = list_next (e)) {
+		struct template *t = list_entry (e, struct template, elem);
+
+		if (t->tid == tid) {
+			t->ref_cnt++;
+			args.template = t;
+			break;
+		}
+	}
+	intr_set_level (old_level);
+	if (args.template == NULL)
+		return TID_ERROR;
+
+	args.parent = thread_current ();
+	args.cmd_line = cmd_line;
+	args.child = child_create (&thread_current ()->children);
+	sema_init (&args.done, 0);
+	args.success = false;
+	if (args.child != NULL) {
+		child_tid = args.child->tid = thread_create (args.template->name,
+				PRI_DEFAULT, do_spawn_template, &args);
+		if (child_tid == TID_ERROR) {
+			list_remove (&args.child->elem);
+			free (args.child);
+		} else {
+			/* As in clone_process(). */
+			sema_down (&args.done);
+			if (!args.success) {
+				process_wait (child_tid);
+				child_tid = TID_ERROR;
+			}
+		}
+	}
+	template_release (args.template);
+	return child_tid;
+}
+
+/* A thread function that sets up the child for
+ * process_spawn_template(). */
+static void
+do_spawn_template (void *aux) {
+	struct template_args *args = aux;
+	struct template *t = args->template;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+	char *file_name, *save_ptr;
+	bool success = false;
+
+	current->child = args->child;
+#ifdef VM
+	supplemental_page_table_init (&current->spt);
+#endif
+
+	memset (&if_, 0, sizeof if_);
+	if_.ds = if_.es = if_.ss = SEL_UDSEG;
+	if_.cs = SEL_UCSEG;
+	if_.eflags = FLAG_IF | FLAG_MBS;
+	if_.rip = t->entry;
+	if_.rsp = USER_STACK;
+
+	lock_acquire (&filesys_lock);
+	current->image = image_ref (t->image);
+	lock_release (&filesys_lock);
+
+	current->pml4 = pml4_create ();
+	if (current->pml4 == NULL || !vdso_map (current->pml4))
+		goto done;
+	process_activate (current);
+
+	file_name = strtok_r (args->cmd_line, " ", &save_ptr);
+	if (file_name == NULL
+			|| !copy_address_space (current->pml4, t->pml4, t->image, NULL)
+			|| !mman_copy (&current->mman, &t->mman)
+			|| !push_arguments (file_name, &save_ptr, &if_)
+			|| !duplicate_files (args->parent))
+		goto done;
+	if_.R.rdx = t->arg;
+
+	/* Keep the executable unwritable while we run, as load()
+	 * does. */
+	if (t->image != NULL) {
+		lock_acquire (&filesys_lock);
+		current->exec_file = file_open (inode_reopen (t->image->inode));
+		if (current->exec_file != NULL)
+			file_deny_write (current->exec_file);
+		lock_release (&filesys_lock);
+		if (current->exec_file == NULL)
+			goto done;
+	}
+	success = true;
+
+done:
+	/* ARGS belongs to the parent, which may return as soon as we
+	 * let it go. */
+	args->success = success;
+	sema_up (&args->done);
+	if (!success)
+		thread_exit ();
+	do_iret (&if_);
+}
+
+/* Drops a reference to template T, freeing it if that was the
+ * last one. */
+static void
+template_release (struct template *t) {
+	enum intr_level old_level = intr_disable ();
+	bool last = --t->ref_cnt == 0;
+	intr_set_level (old_level);
+
+	if (!last)
+		return;
+	if (t->pml4 != NULL) {
+		if (t->image != NULL)
+			image_unmap (t->image, t->pml4);
+		pml4_destroy (t->pml4);
+	}
+	mman_destroy (&t->mman);
+	lock_acquire (&filesys_lock);
+	image_release (t->image);
+	lock_release (&filesys_lock);
+	free (t);
+}
+
+/* Withdraws the current process's template, if it has one.
+ * Processes being started from it still finish starting. */
+static void
+template_drop (void) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	if (curr->template == NULL)
+		return;
+	old_level = intr_disable ();
+	list_remove (&curr->template->elem);
+	intr_set_level (old_level);
+	template_release (curr->template);
+	curr->template = NULL;
+}
+
+/* Gives the current process a file descriptor table that shares
+ * PARENT's open files, each of which gets copied only once one of
+ * the processes moves its position (see process_get_own_file()).
+ * Returns false if memory is exhausted. */
+static bool
+duplicate_files (struct thread *parent) {
+	struct thread *current = thread_current ();
+
+	current->fd_table = fdt_clone (parent->fd_table);
+	return current->fd_table != NULL;
+}
+
+/* Carries out the CNT file actions in ACTIONS on the current
+ * process's file descriptors.  Returns false if one fails. */
+static bool
+do_file_actions (const struct spawn_action *actions, size_t cnt) {
+	size_t i;
+
+	for (i = 0; i < cnt; i++) {
+		const struct spawn_action *a = &actions[i];
+		struct file *file;
+
+		if (a->fd < 0 || a->fd >= FD_MAX)
+			return false;
+		switch (a->op) {
+			case SPAWN_OPEN:
+				lock_acquire (&filesys_lock);
+				file = filesys_open (a->path);
+				lock_release (&filesys_lock);
+				if (file == NULL || !install_file (a->fd, file))
+					return false;
+				break;
+			case SPAWN_CLOSE:
+				file = process_get_file (a->fd);
+				if (file == NULL)
+					return false;
+				process_put_file (file);
+				process_close_file (a->fd);
+				break;
+			case SPAWN_DUP2:
+				if (process_dup2 (a->oldfd, a->fd) < 0)
+					return false;
+				break;
+			default:
+				return false;
+		}
+	}
+	return true;
+}
+
 /* Switch the current execution context to the f_name.
  * Returns -1 on fail. */
 int
 process_exec (void *f_name) {
-	char *file_name = f_name;
+	struct thread *curr = thread_current ();
+	char *cmd_line = f_name;
 	bool success;
 
+	/* Other threads are running in the address space we would
+	 * replace. */
+	if (curr->leader != NULL || curr->thread_cnt > 0) {
+		palloc_free_page (cmd_line);
+		return -1;
+	}
+
 	/* We cannot use the intr_frame in the thread structure.
 	 * This is because when current thread rescheduled,
 	 * it stores the execution information to the member. */
@@ -175,12 +1066,13 @@ process_exec (void *f_name) {
 
 	/* We first kill the current context */
 	process_cleanup ();
+	curr->fs_base = 0;
 
 	/* And then load the binary */
-	success = load (file_name, &_if);
+	success = load (NULL, cmd_line, &_if);
 
 	/* If load failed, quit. */
-	palloc_free_page (file_name);
+	palloc_free_page (cmd_line);
 	if (!success)
 		return -1;
 
@@ -195,15 +1087,27 @@ process_exec (void *f_name) {
  * exception), returns -1.  If TID is invalid or if it was not a
  * child of the calling process, or if process_wait() has already
  * been successfully called for the given TID, returns -1
- * immediately, without waiting.
- *
- * This function will be implemented in problem 2-2.  For now, it
- * does nothing. */
+ * immediately, without waiting. */
 int
-process_wait (tid_t child_tid UNUSED) {
-	/* XXX: Hint) The pintos exit if process_wait (initd), we recommend you
-	 * XXX:       to add infinite loop here before
-	 * XXX:       implementing the process_wait. */
+process_wait (tid_t child_tid) {
+	struct list *children = &thread_current ()->children;
+	struct list_elem *e;
+
+	for (e = list_begin (children); e != list_end (children);
+			e = list_next (e)) {
+		struct child *c = list_entry (e, struct child, elem);
+		if (c->tid == child_tid) {
+			int status;
+
+			sema_down (&c->exited);
+			status = c->exit_status;
+			add_usage (&process_leader (thread_current ())->child_usage,
+					&c->usage);
+			list_remove (&c->elem);
+			child_release (c);
+			return status;
+		}
+	}
 	return -1;
 }
 
@@ -211,12 +1115,185 @@ process_wait (tid_t child_tid UNUSED) {
 void
 process_exit (void) {
 	struct thread *curr = thread_current ();
-	/* TODO: Your code goes here.
-	 * TODO: Implement process termination message (see
-	 * TODO: project2/process_termination.html).
-	 * TODO: We recommend you to implement process resource cleanup here. */
+	struct list_elem *e;
+	int fd;
+
+	/* A process lasts until all of its threads have exited.  Its
+	 * other threads share the main thread's address space and
+	 * files, so only the main thread reports the process's exit
+	 * and closes them. */
+	if (curr->leader == NULL) {
+		wait_for_threads ();
+
+		/* Kernel threads that never ran a user program print
+		 * nothing. */
+		if (curr->pml4 != NULL)
+			printf ("%s: exit(%d)\n", curr->name, curr->exit_status);
+
+		if (curr->fd_table != NULL) {
+			for (fd = fdt_next (curr->fd_table, 0); fd >= 0;
+					fd = fdt_next (curr->fd_table, fd + 1))
+				process_close_file (fd);
+			fdt_destroy (curr->fd_table);
+		}
+		poll_destroy ();
+	}
+	curr->fd_table = NULL;
 
 	process_cleanup ();
+
+	/* Let go of our children's exit records, and of those of our
+	 * threads that nobody joined. */
+	while (!list_empty (&curr->children)) {
+		e = list_pop_front (&curr->children);
+		child_release (list_entry (e, struct child, elem));
+	}
+	while (!list_empty (&curr->threads)) {
+		e = list_pop_front (&curr->threads);
+		child_release (list_entry (e, struct child, elem));
+	}
+
+	/* Report our own exit to our parent. */
+	if (curr->child != NULL) {
+		curr->child->exit_status = curr->exit_status;
+		curr->child->usage = curr->usage;
+		add_usage (&curr->child->usage, &curr->child_usage);
+		sema_up (&curr->child->exited);
+		child_release (curr->child);
+		curr->child = NULL;
+	}
+
+	/* Let the main thread go, if we were the last of the others. */
+	if (curr->leader != NULL) {
+		enum intr_level old_level = intr_disable ();
+		add_usage (&curr->leader->usage, &curr->usage);
+		if (--curr->leader->thread_cnt == 0
+				&& curr->leader->threads_done != NULL)
+			sema_up (curr->leader->threads_done);
+		intr_set_level (old_level);
+		curr->leader = NULL;
+	}
+}
+
+/* Installs FILE in the lowest free slot of the current process's
+ * file descriptor table.  Returns the new file descriptor, or -1
+ * if the table is full or memory is exhausted. */
+int
+process_add_file (struct file *file) {
+	return fdt_add (thread_current ()->fd_table, file);
+}
+
+/* Returns the file open as FD in the current process, or a null
+ * pointer if FD is not open.  The console descriptors 0 and 1 are
+ * backed by a file only once process_dup2() has redirected them.
+ * The process's other threads may close FD at any time, so the
+ * file comes with a hold on it that keeps it open until the caller
+ * is done with it and calls process_put_file(). */
+struct file *
+process_get_file (int fd) {
+	return fdt_get (thread_current ()->fd_table, fd);
+}
+
+/* Returns the file open as FD in the current process, like
+ * process_get_file(), for reading, writing or seeking.  If the file
+ * is shared with another descriptor, by fork() or process_dup2(),
+ * FD first gets a copy of its own, so that moving its position
+ * moves no one else's.  Returns a null pointer if FD is not open or
+ * memory is exhausted. */
+struct file *
+process_get_own_file (int fd) {
+	struct fd_table *fdt = thread_current ()->fd_table;
+	struct file *file = fdt_get (fdt, fd);
+	struct file *copy;
+
+	if (file == NULL || !file_is_shared (file))
+		return file;
+
+	lock_acquire (&filesys_lock);
+	copy = file_duplicate (file);
+	lock_release (&filesys_lock);
+	if (copy != NULL) {
+		/* FD's reference passes from FILE to COPY, unless another
+		 * thread has closed FD meanwhile. */
+		bool replaced;
+
+		file_hold (copy);
+		replaced = fdt_replace (fdt, fd, file, copy);
+		lock_acquire (&filesys_lock);
+		if (replaced)
+			file_close (file);
+		else {
+			file_unhold (copy);
+			file_close (copy);
+			copy = NULL;
+		}
+		lock_release (&filesys_lock);
+	}
+	process_put_file (file);
+	return copy;
+}
+
+/* Drops the hold on FILE, if nonnull, that process_get_file() or
+ * process_get_own_file() returned it with. */
+void
+process_put_file (struct file *file) {
+	if (file != NULL) {
+		lock_acquire (&filesys_lock);
+		file_unhold (file);
+		lock_release (&filesys_lock);
+	}
+}
+
+/* Closes FD in the current process, if it is open, and takes it
+ * out of the process's interest set. */
+void
+process_close_file (int fd) {
+	struct file *file;
+
+	poll_forget (fd);
+	file = fdt_remove (thread_current ()->fd_table, fd);
+	if (file != NULL) {
+		lock_acquire (&filesys_lock);
+		file_close (file);
+		lock_release (&filesys_lock);
+	}
+}
+
+/* Makes NEWFD refer to the file open as OLDFD in the current
+ * process, closing NEWFD first if it is open.  NEWFD may be 0 or 1,
+ * to redirect the console.  The two share the file's position only
+ * until one of them moves it, as if NEWFD had a duplicate.  Returns
+ * NEWFD, or -1 if OLDFD is not open, NEWFD is out of range, or
+ * memory is exhausted. */
+int
+process_dup2 (int oldfd, int newfd) {
+	struct file *file = process_get_file (oldfd);
+	int result = -1;
+
+	if (file != NULL && newfd >= 0 && newfd < FD_MAX
+			&& (oldfd == newfd || install_file (newfd, file_ref (file))))
+		result = newfd;
+	process_put_file (file);
+	return result;
+}
+
+/* Puts FILE in slot FD of the current process's file descriptor
+ * table, closing whatever was there.  On failure, closes FILE and
+ * returns false. */
+static bool
+install_file (int fd, struct file *file) {
+	struct file *old;
+	bool success;
+
+	success = fdt_install (thread_current ()->fd_table, fd, file, &old);
+	if (success)
+		poll_forget (fd);
+	else
+		old = file;
+	lock_acquire (&filesys_lock);
+	file_close (old);
+	lock_release (&filesys_lock);
+	return success;
 }
 
 /* Free the current process's resources. */
@@ -228,6 +1305,21 @@ process_cleanup (void) {
 	supplemental_page_table_kill (&curr->spt);
 #endif
 
+	/* Workers may still be using our memory. */
+	uring_destroy ();
+
+	/* Our template is a copy of the address space we are giving
+	 * up. */
+	template_drop ();
+
+	/* Let others write our executable again. */
+	if (curr->exec_file != NULL) {
+		lock_acquire (&filesys_lock);
+		file_close (curr->exec_file);
+		lock_release (&filesys_lock);
+		curr->exec_file = NULL;
+	}
+
 	uint64_t *pml4;
 	/* Destroy the current process's page directory and switch back
 	 * to the kernel-only page directory. */
@@ -242,7 +1334,34 @@ process_cleanup (void) {
 		 * that's been freed (and cleared). */
 		curr->pml4 = NULL;
 		pml4_activate (NULL);
-		pml4_destroy (pml4);
+		shm_unmap_all (pml4);
+		if (curr->leader == NULL) {
+			curr->rss = 0;
+			mman_destroy (&curr->mman);
+		}
+		if (curr->leader != NULL) {
+			/* The address space is our main thread's, which
+			 * tears it down once we are all gone. */
+		} else if (curr->vfork_done != NULL) {
+			/* The address space is our parent's, lent to us by
+			 * process_vfork().  Give it back. */
+			sema_up (curr->vfork_done);
+			curr->vfork_done = NULL;
+		} else {
+			/* Shared pages belong to their owners. */
+			vdso_unmap (pml4);
+			if (curr->image != NULL)
+				image_unmap (curr->image, pml4);
+			pml4_destroy (pml4);
+		}
+	}
+
+	/* Done with our executable's image. */
+	if (curr->image != NULL) {
+		lock_acquire (&filesys_lock);
+		image_release (curr->image);
+		lock_release (&filesys_lock);
+		curr->image = NULL;
 	}
 }
 
@@ -253,158 +1372,83 @@ process_activate (struct thread *next) {
 	/* Activate thread's page tables. */
 	pml4_activate (next->pml4);
 
+	/* Restore the user thread's thread-local storage pointer.
+	 * The kernel itself does not use FS. */
+	if (next->pml4 != NULL)
+		write_msr (MSR_FS_BASE, next->fs_base);
+
+	/* Tell user code who is running. */
+	vdso_switch (next);
+
 	/* Set thread's kernel stack for use in processing interrupts. */
 	tss_update (next);
 }
 
-/* We load ELF binaries.  The following definitions are taken
- * from the ELF specification, [ELF1], more-or-less verbatim.  */
-
-/* ELF types.  See [ELF1] 1-2. */
-#define EI_NIDENT 16
-
-#define PT_NULL    0            /* Ignore. */
-#define PT_LOAD    1            /* Loadable segment. */
-#define PT_DYNAMIC 2            /* Dynamic linking info. */
-#define PT_INTERP  3            /* Name of dynamic loader. */
-#define PT_NOTE    4            /* Auxiliary info. */
-#define PT_SHLIB   5            /* Reserved. */
-#define PT_PHDR    6            /* Program header table. */
-#define PT_STACK   0x6474e551   /* Stack segment. */
-
-#define PF_X 1          /* Executable. */
-#define PF_W 2          /* Writable. */
-#define PF_R 4          /* Readable. */
-
-/* Executable header.  See [ELF1] 1-4 to 1-8.
- * This appears at the very beginning of an ELF binary. */
-struct ELF64_hdr {
-	unsigned char e_ident[EI_NIDENT];
-	uint16_t e_type;
-	uint16_t e_machine;
-	uint32_t e_version;
-	uint64_t e_entry;
-	uint64_t e_phoff;
-	uint64_t e_shoff;
-	uint32_t e_flags;
-	uint16_t e_ehsize;
-	uint16_t e_phentsize;
-	uint16_t e_phnum;
-	uint16_t e_shentsize;
-	uint16_t e_shnum;
-	uint16_t e_shstrndx;
-};
-
-struct ELF64_PHDR {
-	uint32_t p_type;
-	uint32_t p_flags;
-	uint64_t p_offset;
-	uint64_t p_vaddr;
-	uint64_t p_paddr;
-	uint64_t p_filesz;
-	uint64_t p_memsz;
-	uint64_t p_align;
-};
-
-/* Abbreviations */
-#define ELF ELF64_hdr
-#define Phdr ELF64_PHDR
-
 static bool setup_stack (struct intr_frame *if_);
-static bool validate_segment (const struct Phdr *, struct file *);
+#ifdef VM
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes,
 		bool writable);
+#else
+static bool load_segment (const struct image_seg *);
+#endif
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
+/* Loads the ELF executable named PATH, or by the first word of
+ * CMD_LINE if PATH is null, into the current thread, passing it
+ * the words of CMD_LINE as arguments.  CMD_LINE is modified.
+ * The executable is parsed, and in project 2 read in, only the
+ * first time; later loads take it from the image cache.
  * Stores the executable's entry point into *RIP
  * and its initial stack pointer into *RSP.
  * Returns true if successful, false otherwise. */
 static bool
-load (const char *file_name, struct intr_frame *if_) {
+load (const char *path, char *cmd_line, struct intr_frame *if_) {
 	struct thread *t = thread_current ();
-	struct ELF ehdr;
+	struct image *img;
 	struct file *file = NULL;
-	off_t file_ofs;
+	char *file_name, *save_ptr;
 	bool success = false;
-	int i;
+	size_t i;
 
 	/* Allocate and activate page directory. */
 	t->pml4 = pml4_create ();
-	if (t->pml4 == NULL)
-		goto done;
+	if (t->pml4 == NULL || !vdso_map (t->pml4))
+		return false;
 	process_activate (thread_current ());
 
-	/* Open executable file. */
-	file = filesys_open (file_name);
-	if (file == NULL) {
-		printf ("load: %s: open failed\n", file_name);
+	file_name = strtok_r (cmd_line, " ", &save_ptr);
+	if (file_name == NULL)
+		return false;
+	if (path == NULL)
+		path = file_name;
+
+	/* Find the executable's image.  process_cleanup() releases it,
+	 * along with any of its pages we have mapped, if we fail. */
+	lock_acquire (&filesys_lock);
+	img = image_open (path);
+	if (img == NULL)
 		goto done;
-	}
-
-	/* Read and verify executable header. */
-	if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
-			|| memcmp (ehdr.e_ident, "\177ELF\2\1\1", 7)
-			|| ehdr.e_type != 2
-			|| ehdr.e_machine != 0x3E // amd64
-			|| ehdr.e_version != 1
-			|| ehdr.e_phentsize != sizeof (struct Phdr)
-			|| ehdr.e_phnum > 1024) {
-		printf ("load: %s: error loading executable\n", file_name);
+	t->image = img;
+	file = file_open (inode_reopen (img->inode));
+	if (file == NULL)
 		goto done;
-	}
 
-	/* Read program headers. */
-	file_ofs = ehdr.e_phoff;
-	for (i = 0; i < ehdr.e_phnum; i++) {
-		struct Phdr phdr;
+	/* Map its segments.  The heap starts above the highest. */
+	for (i = 0; i < img->seg_cnt; i++) {
+		const struct image_seg *seg = &img->segs[i];
+		uintptr_t end = seg->mem_page + seg->read_bytes + seg->zero_bytes;
 
-		if (file_ofs < 0 || file_ofs > file_length (file))
-			goto done;
-		file_seek (file, file_ofs);
+		if (end > t->mman.heap_start)
+			mman_set_heap (&t->mman, end);
 
-		if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
+#ifdef VM
+		if (!load_segment (file, seg->file_page, (void *) seg->mem_page,
+					seg->read_bytes, seg->zero_bytes, seg->writable))
 			goto done;
-		file_ofs += sizeof phdr;
-		switch (phdr.p_type) {
-			case PT_NULL:
-			case PT_NOTE:
-			case PT_PHDR:
-			case PT_STACK:
-			default:
-				/* Ignore this segment. */
-				break;
-			case PT_DYNAMIC:
-			case PT_INTERP:
-			case PT_SHLIB:
-				goto done;
-			case PT_LOAD:
-				if (validate_segment (&phdr, file)) {
-					bool writable = (phdr.p_flags & PF_W) != 0;
-					uint64_t file_page = phdr.p_offset & ~PGMASK;
-					uint64_t mem_page = phdr.p_vaddr & ~PGMASK;
-					uint64_t page_offset = phdr.p_vaddr & PGMASK;
-					uint32_t read_bytes, zero_bytes;
-					if (phdr.p_filesz > 0) {
-						/* Normal segment.
-						 * Read initial part from disk and zero the rest. */
-						read_bytes = page_offset + phdr.p_filesz;
-						zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-								- read_bytes);
-					} else {
-						/* Entirely zero.
-						 * Don't read anything from disk. */
-						read_bytes = 0;
-						zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
-					}
-					if (!load_segment (file, file_page, (void *) mem_page,
-								read_bytes, zero_bytes, writable))
-						goto done;
-				}
-				else
-					goto done;
-				break;
-		}
+#else
+		if (!load_segment (seg))
+			goto done;
+#endif
 	}
 
 	/* Set up stack. */
@@ -412,64 +1456,78 @@ load (const char *file_name, struct intr_frame *if_) {
 		goto done;
 
 	/* Start address. */
-	if_->rip = ehdr.e_entry;
+	if_->rip = img->entry;
 
-	/* TODO: Your code goes here.
-	 * TODO: Implement argument passing (see project2/argument_passing.html). */
+	/* Pass the arguments. */
+	if (!push_arguments (file_name, &save_ptr, if_))
+		goto done;
 
+	/* Keep the executable open, and unwritable, while it runs. */
+	file_deny_write (file);
+	t->exec_file = file;
+	file = NULL;
+	strlcpy (t->name, path, sizeof t->name);
 	success = true;
 
 done:
 	/* We arrive here whether the load is successful or not. */
 	file_close (file);
+	lock_release (&filesys_lock);
 	return success;
 }
 
-
-/* Checks whether PHDR describes a valid, loadable segment in
- * FILE and returns true if so, false otherwise. */
+/* Pushes FILE_NAME and the rest of the words that strtok_r()
+ * finds through SAVE_PTR onto the user stack described by IF_,
+ * followed by the argv[] array that points to them and a fake
+ * return address, and passes argc and argv in RDI and RSI.
+ * Returns false if they do not fit in the stack page. */
 static bool
-validate_segment (const struct Phdr *phdr, struct file *file) {
-	/* p_offset and p_vaddr must have the same page offset. */
-	if ((phdr->p_offset & PGMASK) != (phdr->p_vaddr & PGMASK))
-		return false;
-
-	/* p_offset must point within FILE. */
-	if (phdr->p_offset > (uint64_t) file_length (file))
-		return false;
-
-	/* p_memsz must be at least as big as p_filesz. */
-	if (phdr->p_memsz < phdr->p_filesz)
-		return false;
-
-	/* The segment must not be empty. */
-	if (phdr->p_memsz == 0)
-		return false;
+push_arguments (char *file_name, char **save_ptr, struct intr_frame *if_) {
+	uintptr_t stack_bottom = USER_STACK - PGSIZE;
+	uintptr_t rsp = if_->rsp;
+	uint64_t *argv;
+	char *arg, *p;
+	int argc = 0;
+	int i;
 
-	/* The virtual memory region must both start and end within the
-	   user address space range. */
-	if (!is_user_vaddr ((void *) phdr->p_vaddr))
-		return false;
-	if (!is_user_vaddr ((void *) (phdr->p_vaddr + phdr->p_memsz)))
-		return false;
+	/* Copy the strings.  Each one lands just below the last. */
+	for (arg = file_name; arg != NULL;
+			arg = strtok_r (NULL, " ", save_ptr)) {
+		size_t len = strlen (arg) + 1;
 
-	/* The region cannot "wrap around" across the kernel virtual
-	   address space. */
-	if (phdr->p_vaddr + phdr->p_memsz < phdr->p_vaddr)
+		if (len > rsp - stack_bottom)
+			return false;
+		rsp -= len;
+		memcpy ((void *) rsp, arg, len);
+		argc++;
+	}
+	p = (char *) rsp;
+
+	/* Make room for argv[0...argc], which is null, and the return
+	 * address, aligned so that RSP + 8 is a multiple of 16 as on
+	 * entry to any function. */
+	rsp &= ~(uintptr_t) 0xf;
+	if ((argc + 2) % 2 == 0)
+		rsp -= 8;
+	if ((size_t) (argc + 2) * 8 > rsp - stack_bottom)
 		return false;
+	argv = (uint64_t *) rsp - (argc + 1);
 
-	/* Disallow mapping page 0.
-	   Not only is it a bad idea to map page 0, but if we allowed
-	   it then user code that passed a null pointer to system calls
-	   could quite likely panic the kernel by way of null pointer
-	   assertions in memcpy(), etc. */
-	if (phdr->p_vaddr < PGSIZE)
-		return false;
+	/* The lowest string is the last argument. */
+	argv[argc] = 0;
+	for (i = argc - 1; i >= 0; i--) {
+		argv[i] = (uint64_t) p;
+		p += strlen (p) + 1;
+	}
+	argv[-1] = 0;
 
-	/* It's okay. */
+	if_->rsp = (uint64_t) (argv - 1);
+	if_->R.rdi = argc;
+	if_->R.rsi = (uint64_t) argv;
 	return true;
 }
 
+
 #ifndef VM
 /* Codes of this block will be ONLY USED DURING project 2.
  * If you want to implement the function for whole project 2, implement it
@@ -478,58 +1536,43 @@ validate_segment (const struct Phdr *phdr, struct file *file) {
 /* load() helpers. */
 static bool install_page (void *upage, void *kpage, bool writable);
 
-/* Loads a segment starting at offset OFS in FILE at address
- * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
- * memory are initialized, as follows:
- *
- * - READ_BYTES bytes at UPAGE must be read from FILE
- * starting at offset OFS.
- *
- * - ZERO_BYTES bytes at UPAGE + READ_BYTES must be zeroed.
- *
- * The pages initialized by this function must be writable by the
- * user process if WRITABLE is true, read-only otherwise.
+/* Maps segment SEG of the current process's image into its
+ * address space.  Pages of a read-only segment are mapped from
+ * the image itself and shared with every process that runs it;
+ * the rest are copies of the image's pages, or zeroed.
  *
  * Return true if successful, false if a memory allocation error
- * or disk read error occurs. */
+ * occurs. */
 static bool
-load_segment (struct file *file, off_t ofs, uint8_t *upage,
-		uint32_t read_bytes, uint32_t zero_bytes, bool writable) {
-	ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
+load_segment (const struct image_seg *seg) {
+	uint8_t *upage = (uint8_t *) seg->mem_page;
+	size_t i;
+
 	ASSERT (pg_ofs (upage) == 0);
-	ASSERT (ofs % PGSIZE == 0);
 
-	file_seek (file, ofs);
-	while (read_bytes > 0 || zero_bytes > 0) {
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
+	for (i = 0; i < seg->page_cnt; i++, upage += PGSIZE) {
+		void *cached = seg->pages[i];
+		uint8_t *kpage;
 
-		/* Get a page of memory. */
-		uint8_t *kpage = palloc_get_page (PAL_USER);
-		if (kpage == NULL)
-			return false;
+		/* Share a page of text. */
+		if (!seg->writable && cached != NULL) {
+			if (!install_page (upage, cached, false))
+				return false;
+			continue;
+		}
 
-		/* Load this page. */
-		if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes) {
-			palloc_free_page (kpage);
+		/* Get a page of memory and fill it in. */
+		kpage = palloc_get_page (cached != NULL ? PAL_USER : PAL_USER | PAL_ZERO);
+		if (kpage == NULL)
 			return false;
-		}
-		memset (kpage + page_read_bytes, 0, page_zero_bytes);
+		if (cached != NULL)
+			memcpy (kpage, cached, PGSIZE);
 
 		/* Add the page to the process's address space. */
-		if (!install_page (upage, kpage, writable)) {
-			printf("fail\n");
+		if (!install_page (upage, kpage, seg->writable)) {
 			palloc_free_page (kpage);
 			return false;
 		}
-
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
 	}
 	return true;
 }
@@ -566,8 +1609,11 @@ install_page (void *upage, void *kpage, bool writable) {
 
 	/* Verify that there's not already a page at that virtual
 	 * address, then map our page there. */
-	return (pml4_get_page (t->pml4, upage) == NULL
-			&& pml4_set_page (t->pml4, upage, kpage, writable));
+	if (pml4_get_page (t->pml4, upage) != NULL
+			|| !pml4_set_page (t->pml4, upage, kpage, writable))
+		return false;
+	process_add_rss (1);
+	return true;
 }
 #else
 /* From here, codes will be used after project 3.
@@ -0,0 +1,310 @@
+#include "userprog/shm.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "userprog/uring.h"
+
+/* Shared anonymous memory.
+
+   A shared memory object is a set of zeroed pages that any number
+   of processes can map, each at an address of its choosing, so
+   that they see each other's writes without copying anything.
+   Processes get hold of an object through a file descriptor (see
+   shm_open_file()), which they can hand down by fork() or spawn()
+   like any other.  fork() also passes on the mappings themselves,
+   shared rather than copied.
+
+   An object lives as long as a descriptor or a mapping refers to
+   it.  Mappings are recorded per process, in its main thread, so
+   that process_cleanup() can take them out of the page tables
+   before destroying them; the pages belong to the object.  A
+   process's threads may map and unmap at the same time, so its
+   list of mappings is changed with interrupts off. */
+
+/* A shared memory object. */
+struct shm {
+	size_t page_cnt;            /* Size in pages. */
+	void **pages;               /* Its pages. */
+	int ref_cnt;                /* Descriptors plus mappings. */
+};
+
+/* A mapping of an object into a process. */
+struct shm_map {
+	struct shm *shm;            /* Object mapped. */
+	uint8_t *addr;              /* User address of its first page. */
+	struct list_elem elem;      /* Element in thread's shm_maps. */
+};
+
+static bool map_pages (uint64_t *pml4, struct shm *, uint8_t *addr);
+static void unmap (uint64_t *pml4, struct shm_map *);
+static void add_map (struct thread *, struct shm_map *);
+
+/* File operations for a shared memory object.  It is mapped rather
+ * than read or written. */
+
+static void
+shm_file_ref (void *shm) {
+	shm_ref (shm);
+}
+
+static void
+shm_file_release (void *shm) {
+	shm_release (shm);
+}
+
+static off_t
+shm_file_length (void *shm) {
+	return shm_size (shm);
+}
+
+static const struct file_ops shm_file_ops = {
+	.ref = shm_file_ref,
+	.release = shm_file_release,
+	.length = shm_file_length,
+};
+
+/* Creates a shared memory object of SIZE bytes, rounded up to
+ * whole pages, with one reference.  Returns a null pointer if SIZE
+ * is 0 or memory is exhausted. */
+struct shm *
+shm_create (size_t size) {
+	struct shm *shm;
+	size_t i;
+
+	if (size == 0 || size > SIZE_MAX - PGSIZE)
+		return NULL;
+	shm = malloc (sizeof *shm);
+	if (shm == NULL)
+		return NULL;
+	shm->page_cnt = DIV_ROUND_UP (size, PGSIZE);
+	shm->pages = calloc (shm->page_cnt, sizeof *shm->pages);
+	shm->ref_cnt = 1;
+	if (shm->pages == NULL) {
+		free (shm);
+		return NULL;
+	}
+	for (i = 0; i < shm->page_cnt; i++) {
+		shm->pages[i] = palloc_get_page (PAL_USER | PAL_ZERO);
+		if (shm->pages[i] == NULL) {
+			shm_release (shm);
+			return NULL;
+		}
+	}
+	return shm;
+}
+
+/* Returns a new file standing for SHM, taking over the caller's
+ * reference to it, or a null pointer, and releases SHM, if memory
+ * is exhausted. */
+struct file *
+shm_open_file (struct shm *shm) {
+	return file_open_ops (&shm_file_ops, shm);
+}
+
+/* Returns the shared memory object that FILE stands for, or a null
+ * pointer if it is not one. */
+struct shm *
+shm_from_file (struct file *file) {
+	return file_get_obj (file, &shm_file_ops);
+}
+
+/* Adds a reference to SHM. */
+void
+shm_ref (struct shm *shm) {
+	enum intr_level old_level = intr_disable ();
+	shm->ref_cnt++;
+	intr_set_level (old_level);
+}
+
+/* Drops a reference to SHM, freeing it if that was the last. */
+void
+shm_release (struct shm *shm) {
+	enum intr_level old_level;
+	bool last;
+	size_t i;
+
+	old_level = intr_disable ();
+	last = --shm->ref_cnt == 0;
+	intr_set_level (old_level);
+	if (!last)
+		return;
+
+	for (i = 0; i < shm->page_cnt; i++)
+		palloc_free_page (shm->pages[i]);
+	free (shm->pages);
+	free (shm);
+}
+
+/* Returns the size of SHM in bytes. */
+size_t
+shm_size (const struct shm *shm) {
+	return shm->page_cnt * PGSIZE;
+}
+
+/* Maps SHM, writable, into the current process at ADDR, which
+ * must be page-aligned and where nothing may be mapped yet.
+ * Returns ADDR, or a null pointer on failure. */
+void *
+shm_map (struct shm *shm, void *addr) {
+	struct thread *t = thread_current ();
+	struct shm_map *m;
+	uint8_t *upage = addr;
+	size_t i;
+
+	if (upage == NULL || pg_ofs (upage) != 0)
+		return NULL;
+	for (i = 0; i < shm->page_cnt; i++) {
+		void *va = upage + i * PGSIZE;
+
+		if (!is_user_vaddr (va) || va < addr
+				|| pml4_get_page (t->pml4, va) != NULL)
+			return NULL;
+	}
+
+	m = malloc (sizeof *m);
+	if (m == NULL)
+		return NULL;
+	if (!map_pages (t->pml4, shm, upage)) {
+		free (m);
+		return NULL;
+	}
+	m->shm = shm;
+	m->addr = upage;
+	shm_ref (shm);
+	add_map (process_leader (t), m);
+	process_add_rss (shm->page_cnt);
+	return addr;
+}
+
+/* Removes the current process's mapping that starts at ADDR.
+ * Returns false if there is none. */
+bool
+shm_unmap (void *addr) {
+	struct thread *t = thread_current ();
+	struct list *maps = &process_leader (t)->shm_maps;
+	struct shm_map *found = NULL;
+	enum intr_level old_level;
+	struct list_elem *e;
+
+	old_level = intr_disable ();
+	for (e = list_begin (maps); e != list_end (maps); e = list_next (e)) {
+		struct shm_map *m = list_entry (e, struct shm_map, elem);
+
+		if (m->addr == addr) {
+			list_remove (&m->elem);
+			found = m;
+			break;
+		}
+	}
+	intr_set_level (old_level);
+
+	if (found == NULL)
+		return false;
+	process_add_rss (-(int64_t) found->shm->page_cnt);
+
+	/* A ring operation may be copying to or from the pages. */
+	uring_pause ();
+	unmap (t->pml4, found);
+	uring_resume ();
+	return true;
+}
+
+/* Returns true if UPAGE lies in one of the mappings of T, a
+ * process's main thread. */
+bool
+shm_contains (struct thread *t, const void *upage) {
+	struct list_elem *e;
+
+	for (e = list_begin (&t->shm_maps); e != list_end (&t->shm_maps);
+			e = list_next (e)) {
+		const struct shm_map *m = list_entry (e, struct shm_map, elem);
+
+		if ((const uint8_t *) upage >= m->addr
+				&& (const uint8_t *) upage < m->addr + shm_size (m->shm))
+			return true;
+	}
+	return false;
+}
+
+/* Gives the current process, a child being forked from the
+ * process whose main thread is PARENT, the same mappings as
+ * PARENT, of the same pages.  Returns false if memory is
+ * exhausted. */
+bool
+shm_fork (struct thread *parent) {
+	struct thread *t = thread_current ();
+	struct list_elem *e;
+
+	for (e = list_begin (&parent->shm_maps);
+			e != list_end (&parent->shm_maps); e = list_next (e)) {
+		struct shm_map *pm = list_entry (e, struct shm_map, elem);
+		struct shm_map *m = malloc (sizeof *m);
+
+		if (m == NULL)
+			return false;
+		if (!map_pages (t->pml4, pm->shm, pm->addr)) {
+			free (m);
+			return false;
+		}
+		m->shm = pm->shm;
+		m->addr = pm->addr;
+		shm_ref (m->shm);
+		add_map (t, m);
+		process_add_rss (m->shm->page_cnt);
+	}
+	return true;
+}
+
+/* Removes all of the current process's mappings from PML4, which
+ * must be done before PML4 is destroyed.  Only the main thread,
+ * the last of the process's threads, has any. */
+void
+shm_unmap_all (uint64_t *pml4) {
+	struct thread *t = thread_current ();
+
+	while (!list_empty (&t->shm_maps))
+		unmap (pml4, list_entry (list_pop_front (&t->shm_maps),
+					struct shm_map, elem));
+}
+
+/* Maps the pages of SHM into PML4 starting at ADDR.  On failure,
+ * maps none of them and returns false. */
+static bool
+map_pages (uint64_t *pml4, struct shm *shm, uint8_t *addr) {
+	size_t i;
+
+	for (i = 0; i < shm->page_cnt; i++)
+		if (!pml4_set_page (pml4, addr + i * PGSIZE, shm->pages[i], true)) {
+			while (i-- > 0)
+				pml4_clear_page (pml4, addr + i * PGSIZE);
+			return false;
+		}
+	return true;
+}
+
+/* Takes mapping M, already off its list, out of PML4 and frees
+ * it. */
+static void
+unmap (uint64_t *pml4, struct shm_map *m) {
+	size_t i;
+
+	for (i = 0; i < m->shm->page_cnt; i++)
+		pml4_clear_page (pml4, m->addr + i * PGSIZE);
+	shm_release (m->shm);
+	free (m);
+}
+
+/* Adds M to the mappings of T, a process's main thread. */
+static void
+add_map (struct thread *t, struct shm_map *m) {
+	enum intr_level old_level = intr_disable ();
+	list_push_back (&t->shm_maps, &m->elem);
+	intr_set_level (old_level);
+}
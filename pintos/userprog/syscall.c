@@ -1,16 +1,133 @@
 #include "userprog/syscall.h"
+#include <inttypes.h>
+#include <iostat.h>
+#include <spawn.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include "devices/disk.h"
+#include "devices/input.h"
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "filesys/pipe.h"
+#include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "threads/loader.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
+#include "userprog/image.h"
+#include "userprog/mman.h"
+#include "userprog/poll.h"
+#include "userprog/process.h"
+#include "userprog/shm.h"
+#include "userprog/uring.h"
+#include "userprog/usercopy.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
 
+/* Serializes access to the file system, which is not safe to
+   enter from more than one thread at a time. */
+struct lock filesys_lock;
+
+/* A system call handler.  Takes the caller's arguments straight
+   from its saved registers in F, in the order rdi, rsi, rdx, r10,
+   r8, r9, and returns the value to pass back in rax. */
+typedef uint64_t syscall_func (struct intr_frame *f);
+
+static syscall_func sys_halt, sys_exit, sys_fork, sys_exec, sys_wait;
+static syscall_func sys_create, sys_remove, sys_open, sys_filesize;
+static syscall_func sys_read, sys_write, sys_seek, sys_tell, sys_close;
+static syscall_func sys_iostat, sys_null, sys_get_ticks, sys_getpid;
+static syscall_func sys_uring_setup, sys_uring_enter, sys_vfork, sys_spawn;
+static syscall_func sys_template_mark, sys_spawn_template;
+static syscall_func sys_dup2, sys_pipe;
+static syscall_func sys_shm_create, sys_shm_map, sys_shm_unmap;
+static syscall_func sys_poll, sys_epoll_ctl, sys_epoll_wait;
+static syscall_func sys_futex_wait, sys_futex_wake;
+static syscall_func sys_thread_spawn, sys_thread_join, sys_set_tls;
+static syscall_func sys_getrusage;
+static syscall_func sys_mmap, sys_munmap, sys_sbrk;
+
+/* System call table, indexed by SYS_* number.  A call with no
+   handler here kills the calling process.
+
+   Most handlers read only the argument registers from their
+   struct intr_frame, and syscall_entry saves no more than that
+   for them.  Handlers that need the caller's complete register
+   set must be marked FULL_FRAME. */
+static const struct syscall {
+	syscall_func *func;         /* Handler. */
+	const char *name;           /* Name, for statistics. */
+	bool full_frame;            /* Needs every user register saved? */
+} syscall_table[] = {
+	[SYS_HALT] = {sys_halt, "halt"},
+	[SYS_EXIT] = {sys_exit, "exit"},
+	[SYS_FORK] = {sys_fork, "fork", true},
+	[SYS_EXEC] = {sys_exec, "exec"},
+	[SYS_WAIT] = {sys_wait, "wait"},
+	[SYS_CREATE] = {sys_create, "create"},
+	[SYS_REMOVE] = {sys_remove, "remove"},
+	[SYS_OPEN] = {sys_open, "open"},
+	[SYS_FILESIZE] = {sys_filesize, "filesize"},
+	[SYS_READ] = {sys_read, "read"},
+	[SYS_WRITE] = {sys_write, "write"},
+	[SYS_SEEK] = {sys_seek, "seek"},
+	[SYS_TELL] = {sys_tell, "tell"},
+	[SYS_CLOSE] = {sys_close, "close"},
+	[SYS_DUP2] = {sys_dup2, "dup2"},
+	[SYS_IOSTAT] = {sys_iostat, "iostat"},
+	[SYS_NULL] = {sys_null, "null"},
+	[SYS_GET_TICKS] = {sys_get_ticks, "ticks"},
+	[SYS_GETPID] = {sys_getpid, "getpid"},
+	[SYS_URING_SETUP] = {sys_uring_setup, "ursetup"},
+	[SYS_URING_ENTER] = {sys_uring_enter, "urenter"},
+	[SYS_VFORK] = {sys_vfork, "vfork", true},
+	[SYS_SPAWN] = {sys_spawn, "spawn"},
+	[SYS_TEMPLATE_MARK] = {sys_template_mark, "tmark"},
+	[SYS_SPAWN_TEMPLATE] = {sys_spawn_template, "tspawn"},
+	[SYS_PIPE] = {sys_pipe, "pipe"},
+	[SYS_SHM_CREATE] = {sys_shm_create, "shmcreate"},
+	[SYS_SHM_MAP] = {sys_shm_map, "shmmap"},
+	[SYS_SHM_UNMAP] = {sys_shm_unmap, "shmunmap"},
+	[SYS_POLL] = {sys_poll, "poll"},
+	[SYS_EPOLL_CTL] = {sys_epoll_ctl, "epctl"},
+	[SYS_EPOLL_WAIT] = {sys_epoll_wait, "epwait"},
+	[SYS_FUTEX_WAIT] = {sys_futex_wait, "fwait"},
+	[SYS_FUTEX_WAKE] = {sys_futex_wake, "fwake"},
+	[SYS_THREAD_SPAWN] = {sys_thread_spawn, "tcreate"},
+	[SYS_THREAD_JOIN] = {sys_thread_join, "tjoin"},
+	[SYS_SET_TLS] = {sys_set_tls, "settls"},
+	[SYS_GETRUSAGE] = {sys_getrusage, "rusage"},
+	[SYS_MMAP] = {sys_mmap, "mmap"},
+	[SYS_MUNMAP] = {sys_munmap, "munmap"},
+	[SYS_SBRK] = {sys_sbrk, "sbrk"},
+};
+
+/* Number of entries in syscall_table[]. */
+#define SYSCALL_CNT (sizeof syscall_table / sizeof *syscall_table)
+
+/* Per-call statistics, indexed like syscall_table[].  Calls that
+   do not return, such as exit, count only toward CALLS. */
+static struct syscall_stat {
+	long long calls;            /* Number of invocations. */
+	uint64_t cycles;            /* Total TSC cycles spent in handler. */
+} syscall_stats[SYSCALL_CNT];
+
+/* Bit N is set if system call N is marked FULL_FRAME in
+   syscall_table[].  Read by syscall_entry. */
+uint64_t syscall_full_frame;
+
+static void kill_process (void) NO_RETURN;
+static bool get_user_string (char *dst, const char *ustr, size_t size);
+
 /* System call.
  *
  * Previously system call services was handled by the interrupt handler
@@ -26,6 +143,8 @@ void syscall_handler (struct intr_frame *);
 
 void
 syscall_init (void) {
+	size_t i;
+
 	write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48  |
 			((uint64_t)SEL_KCSEG) << 32);
 	write_msr(MSR_LSTAR, (uint64_t) syscall_entry);
@@ -35,12 +154,767 @@ syscall_init (void) {
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
+
+	/* syscall_entry can only test 64 bits. */
+	ASSERT (SYSCALL_CNT <= 64);
+	for (i = 0; i < SYSCALL_CNT; i++)
+		if (syscall_table[i].full_frame)
+			syscall_full_frame |= 1ULL << i;
+
+	lock_init (&filesys_lock);
+}
+
+/* Prints system call statistics. */
+void
+syscall_print_stats (void) {
+	size_t i;
+
+	for (i = 0; i < SYSCALL_CNT; i++) {
+		const struct syscall_stat *st = &syscall_stats[i];
+
+		if (st->calls > 0)
+			printf ("Syscall: %-8s %8lld calls, %12"PRIu64" cycles, "
+					"%"PRIu64" cycles/call\n",
+					syscall_table[i].name, st->calls, st->cycles,
+					st->cycles / st->calls);
+	}
 }
 
 /* The main system call interface */
 void
-syscall_handler (struct intr_frame *f UNUSED) {
-	// TODO: Your implementation goes here.
-	printf ("system call!\n");
+syscall_handler (struct intr_frame *f) {
+	uint64_t no = f->R.rax;
+	uint64_t start;
+
+	if (no >= SYSCALL_CNT || syscall_table[no].func == NULL)
+		kill_process ();
+
+	syscall_stats[no].calls++;
+	thread_current ()->usage.syscalls++;
+	start = rdtsc ();
+	f->R.rax = syscall_table[no].func (f);
+	syscall_stats[no].cycles += rdtsc () - start;
+}
+
+/* Terminates the current process with exit status -1. */
+static void
+kill_process (void) {
+	thread_current ()->exit_status = -1;
+	thread_exit ();
+}
+
+/* Copies the user string USTR into the SIZE-byte buffer DST.
+   Kills the current process if USTR is not valid user memory.
+   Returns false if USTR does not fit in DST. */
+static bool
+get_user_string (char *dst, const char *ustr, size_t size) {
+	int64_t len = strncpy_from_user (dst, ustr, size);
+
+	if (len < 0)
+		kill_process ();
+	return (size_t) len < size;
+}
+
+/* Powers off the machine. */
+static uint64_t
+sys_halt (struct intr_frame *f UNUSED) {
+	power_off ();
+}
+
+/* Terminates the current process with status rdi. */
+static uint64_t
+sys_exit (struct intr_frame *f) {
+	thread_current ()->exit_status = (int) f->R.rdi;
 	thread_exit ();
 }
+
+/* Clones the current process, naming the clone rdi.  Returns the
+   child's pid to the parent and 0 to the child. */
+static uint64_t
+sys_fork (struct intr_frame *f) {
+	char name[NAME_BUF_SIZE];
+
+	if (!get_user_string (name, (const char *) f->R.rdi, sizeof name))
+		return TID_ERROR;
+	return process_fork (name, f);
+}
+
+/* Replaces the current process with the command line rdi.  Does
+   not return; the process exits with status -1 on failure. */
+static uint64_t
+sys_exec (struct intr_frame *f) {
+	char *cmd_line;
+
+	/* The command line must outlive our address space. */
+	cmd_line = palloc_get_page (0);
+	if (cmd_line == NULL)
+		kill_process ();
+	if (!get_user_string (cmd_line, (const char *) f->R.rdi, PGSIZE)) {
+		palloc_free_page (cmd_line);
+		kill_process ();
+	}
+
+	process_exec (cmd_line);
+	kill_process ();
+}
+
+/* Waits for child process rdi and returns its exit status. */
+static uint64_t
+sys_wait (struct intr_frame *f) {
+	return process_wait ((tid_t) f->R.rdi);
+}
+
+/* Creates file rdi with initial size rsi. */
+static uint64_t
+sys_create (struct intr_frame *f) {
+	char file[NAME_BUF_SIZE];
+	bool success;
+
+	if (!get_user_string (file, (const char *) f->R.rdi, sizeof file))
+		return false;
+	lock_acquire (&filesys_lock);
+	success = filesys_create (file, (off_t) f->R.rsi);
+	lock_release (&filesys_lock);
+	return success;
+}
+
+/* Deletes file rdi. */
+static uint64_t
+sys_remove (struct intr_frame *f) {
+	char file[NAME_BUF_SIZE];
+	bool success;
+
+	if (!get_user_string (file, (const char *) f->R.rdi, sizeof file))
+		return false;
+	lock_acquire (&filesys_lock);
+	success = filesys_remove (file);
+	if (success)
+		image_purge ();
+	lock_release (&filesys_lock);
+	return success;
+}
+
+/* Opens file rdi and returns a new file descriptor for it, or -1
+   on failure. */
+static uint64_t
+sys_open (struct intr_frame *f) {
+	char name[NAME_BUF_SIZE];
+	struct file *file;
+	int fd;
+
+	if (!get_user_string (name, (const char *) f->R.rdi, sizeof name))
+		return -1;
+	lock_acquire (&filesys_lock);
+	file = filesys_open (name);
+	lock_release (&filesys_lock);
+	if (file == NULL)
+		return -1;
+
+	fd = process_add_file (file);
+	if (fd < 0) {
+		lock_acquire (&filesys_lock);
+		file_close (file);
+		lock_release (&filesys_lock);
+	}
+	return fd;
+}
+
+/* Returns the size of the file open as rdi, or -1. */
+static uint64_t
+sys_filesize (struct intr_frame *f) {
+	struct file *file = process_get_file ((int) f->R.rdi);
+	off_t length;
+
+	if (file == NULL)
+		return -1;
+	lock_acquire (&filesys_lock);
+	length = file_length (file);
+	lock_release (&filesys_lock);
+	process_put_file (file);
+	return length;
+}
+
+/* Reads rdx bytes into rsi from rdi, which may be the keyboard.
+   Returns the number of bytes read, or -1 if rdi is not open.
+   The data passes through a kernel buffer a page at a time, since
+   the file system cannot recover from a fault in user memory.
+   A pipe returns whatever it holds rather than waiting for all
+   rdx bytes. */
+static uint64_t
+sys_read (struct intr_frame *f) {
+	int fd = (int) f->R.rdi;
+	uint8_t *buffer = (uint8_t *) f->R.rsi;
+	unsigned size = (unsigned) f->R.rdx;
+	struct file *file;
+	bool pipe;
+	unsigned bytes_read = 0;
+	uint8_t *kbuf;
+
+	file = process_get_own_file (fd);
+	if (file == NULL && fd != 0)
+		return -1;
+	pipe = file != NULL && pipe_is_end (file);
+	kbuf = palloc_get_page (0);
+	if (kbuf == NULL) {
+		process_put_file (file);
+		return -1;
+	}
+
+	while (bytes_read < size) {
+		size_t chunk = size - bytes_read < PGSIZE ? size - bytes_read : PGSIZE;
+		size_t n;
+
+		if (file == NULL) {
+			for (n = 0; n < chunk; n++)
+				kbuf[n] = input_getc ();
+		} else if (pipe) {
+			/* Pipes may block, so they have locks of their own. */
+			n = file_read (file, kbuf, chunk);
+		} else {
+			lock_acquire (&filesys_lock);
+			n = file_read (file, kbuf, chunk);
+			lock_release (&filesys_lock);
+		}
+
+		if (!copy_to_user (buffer + bytes_read, kbuf, n)) {
+			palloc_free_page (kbuf);
+			process_put_file (file);
+			kill_process ();
+		}
+		bytes_read += n;
+		if (n < chunk || pipe)
+			break;
+	}
+
+	palloc_free_page (kbuf);
+	process_put_file (file);
+	thread_current ()->usage.bytes_read += bytes_read;
+	return bytes_read;
+}
+
+/* Writes rdx bytes from rsi to rdi, which may be the console.
+   Returns the number of bytes written, or -1 if rdi is not open.
+   Like sys_read(), copies through a kernel buffer. */
+static uint64_t
+sys_write (struct intr_frame *f) {
+	int fd = (int) f->R.rdi;
+	const uint8_t *buffer = (const uint8_t *) f->R.rsi;
+	unsigned size = (unsigned) f->R.rdx;
+	struct file *file;
+	unsigned bytes_written = 0;
+	uint8_t *kbuf;
+
+	file = process_get_own_file (fd);
+	if (file == NULL && fd != 1)
+		return -1;
+	kbuf = palloc_get_page (0);
+	if (kbuf == NULL) {
+		process_put_file (file);
+		return -1;
+	}
+
+	while (bytes_written < size) {
+		size_t chunk = size - bytes_written < PGSIZE ? size - bytes_written : PGSIZE;
+		size_t n;
+
+		if (!copy_from_user (kbuf, buffer + bytes_written, chunk)) {
+			palloc_free_page (kbuf);
+			process_put_file (file);
+			kill_process ();
+		}
+
+		if (file == NULL) {
+			putbuf ((const char *) kbuf, chunk);
+			n = chunk;
+		} else if (pipe_is_end (file)) {
+			n = file_write (file, kbuf, chunk);
+		} else {
+			lock_acquire (&filesys_lock);
+			n = file_write (file, kbuf, chunk);
+			lock_release (&filesys_lock);
+		}
+
+		bytes_written += n;
+		if (n < chunk)
+			break;
+	}
+
+	palloc_free_page (kbuf);
+	process_put_file (file);
+	thread_current ()->usage.bytes_written += bytes_written;
+	return bytes_written;
+}
+
+/* Moves the position of the file open as rdi to rsi. */
+static uint64_t
+sys_seek (struct intr_frame *f) {
+	struct file *file = process_get_own_file ((int) f->R.rdi);
+
+	if (file != NULL) {
+		lock_acquire (&filesys_lock);
+		file_seek (file, (off_t) f->R.rsi);
+		lock_release (&filesys_lock);
+		process_put_file (file);
+	}
+	return 0;
+}
+
+/* Returns the position of the file open as rdi. */
+static uint64_t
+sys_tell (struct intr_frame *f) {
+	struct file *file = process_get_file ((int) f->R.rdi);
+	off_t position;
+
+	if (file == NULL)
+		return -1;
+	lock_acquire (&filesys_lock);
+	position = file_tell (file);
+	lock_release (&filesys_lock);
+	process_put_file (file);
+	return position;
+}
+
+/* Closes file descriptor rdi. */
+static uint64_t
+sys_close (struct intr_frame *f) {
+	process_close_file ((int) f->R.rdi);
+	return 0;
+}
+
+/* Makes file descriptor rsi a duplicate of rdi.  Returns rsi, or
+   -1 on failure. */
+static uint64_t
+sys_dup2 (struct intr_frame *f) {
+	return process_dup2 ((int) f->R.rdi, (int) f->R.rsi);
+}
+
+/* Stores the disk I/O statistics of process rdi, or of the caller
+   if rdi is 0, in the user buffer rsi.  Returns false if there is
+   no such process. */
+static uint64_t
+sys_iostat (struct intr_frame *f) {
+	tid_t pid = (tid_t) f->R.rdi;
+	struct iostat *st = (struct iostat *) f->R.rsi;
+	struct iostat kst;
+
+	if (!disk_iostat (pid != 0 ? pid : thread_tid (), &kst))
+		return false;
+	if (!copy_to_user (st, &kst, sizeof kst))
+		kill_process ();
+	return true;
+}
+
+/* Does nothing, for measuring system call overhead. */
+static uint64_t
+sys_null (struct intr_frame *f UNUSED) {
+	return 0;
+}
+
+/* Returns the number of timer ticks since boot. */
+static uint64_t
+sys_get_ticks (struct intr_frame *f UNUSED) {
+	return timer_ticks ();
+}
+
+/* Returns the caller's pid. */
+static uint64_t
+sys_getpid (struct intr_frame *f UNUSED) {
+	return process_leader (thread_current ())->tid;
+}
+
+/* Creates a submission/completion ring for the caller.  Returns
+   its address, or a null pointer on failure. */
+static uint64_t
+sys_uring_setup (struct intr_frame *f UNUSED) {
+	return (uint64_t) uring_setup ();
+}
+
+/* Submits up to rdi operations from the caller's ring and waits
+   for rsi completions.  Returns the number submitted, or -1. */
+static uint64_t
+sys_uring_enter (struct intr_frame *f) {
+	return uring_enter ((unsigned) f->R.rdi, (unsigned) f->R.rsi);
+}
+
+/* Like sys_fork(), but the child borrows the caller's address
+   space, and the caller sleeps until the child calls exec() or
+   exits. */
+static uint64_t
+sys_vfork (struct intr_frame *f) {
+	char name[NAME_BUF_SIZE];
+
+	if (!get_user_string (name, (const char *) f->R.rdi, sizeof name))
+		return TID_ERROR;
+	return process_vfork (name, f);
+}
+
+/* Copies the null-terminated user argument vector UARGV into
+   CMD_LINE, a page, as words separated by spaces, or just PATH
+   if UARGV is null.  Returns -1 if UARGV is not valid user
+   memory, 0 if an argument is empty, contains a space, or does
+   not fit, and 1 on success. */
+static int
+copy_argv (char *cmd_line, const char *path, char *const *uargv) {
+	size_t len = 0;
+	char *arg;
+
+	if (uargv == NULL) {
+		strlcpy (cmd_line, path, PGSIZE);
+		return 1;
+	}
+	for (;; uargv++) {
+		int64_t n;
+
+		if (!copy_from_user (&arg, uargv, sizeof arg))
+			return -1;
+		if (arg == NULL)
+			break;
+		n = strncpy_from_user (cmd_line + len, arg, PGSIZE - len);
+		if (n < 0)
+			return -1;
+		if (n == 0 || (size_t) n >= PGSIZE - len - 1
+				|| strchr (cmd_line + len, ' ') != NULL)
+			return 0;
+		len += n;
+		cmd_line[len++] = ' ';
+	}
+	if (len == 0)
+		return 0;
+	cmd_line[len - 1] = '\0';
+	return 1;
+}
+
+/* Copies the user array of file actions UACTIONS, ended by
+   SPAWN_END, into PAGE: the actions first, then the file names
+   they point to.  Stores the number of actions in *CNT.  Returns
+   -1, 0 or 1 like copy_argv(). */
+static int
+copy_spawn_actions (void *page, size_t *cnt,
+		const struct spawn_action *uactions) {
+	struct spawn_action *actions = page;
+	char *names = (char *) (actions + SPAWN_ACTION_MAX);
+	char *names_end = (char *) page + PGSIZE;
+	size_t i;
+
+	*cnt = 0;
+	if (uactions == NULL)
+		return 1;
+	for (i = 0; ; i++) {
+		struct spawn_action *a = &actions[i];
+		int64_t n;
+
+		if (i == SPAWN_ACTION_MAX)
+			return 0;
+		if (!copy_from_user (a, &uactions[i], sizeof *a))
+			return -1;
+		if (a->op == SPAWN_END)
+			break;
+		if (a->op == SPAWN_OPEN) {
+			n = strncpy_from_user (names, a->path, names_end - names);
+			if (n < 0)
+				return -1;
+			if (n >= names_end - names)
+				return 0;
+			a->path = names;
+			names += n + 1;
+		} else if (a->op != SPAWN_CLOSE && a->op != SPAWN_DUP2)
+			return 0;
+	}
+	*cnt = i;
+	return 1;
+}
+
+/* Starts the program rdi as a new child process, passing it the
+   null-terminated argument vector rsi, after carrying out in the
+   child the file actions rdx, an array ended by SPAWN_END.  Either
+   array may be null.  Arguments are passed the way exec() passes
+   a command line, so they may not contain spaces.  Returns the
+   child's pid, or -1 if the program cannot be started. */
+static uint64_t
+sys_spawn (struct intr_frame *f) {
+	char path[NAME_BUF_SIZE];
+	char *cmd_line, *actions;
+	size_t action_cnt;
+	int argv_ok, actions_ok;
+	tid_t tid = TID_ERROR;
+
+	if (!get_user_string (path, (const char *) f->R.rdi, sizeof path))
+		return TID_ERROR;
+	cmd_line = palloc_get_page (0);
+	actions = palloc_get_page (0);
+	if (cmd_line == NULL || actions == NULL) {
+		palloc_free_page (cmd_line);
+		palloc_free_page (actions);
+		return TID_ERROR;
+	}
+
+	argv_ok = copy_argv (cmd_line, path, (char *const *) f->R.rsi);
+	actions_ok = copy_spawn_actions (actions, &action_cnt,
+			(const struct spawn_action *) f->R.rdx);
+	if (argv_ok > 0 && actions_ok > 0)
+		tid = process_spawn (path, cmd_line,
+				(struct spawn_action *) actions, action_cnt);
+
+	palloc_free_page (cmd_line);
+	palloc_free_page (actions);
+	if (argv_ok < 0 || actions_ok < 0)
+		kill_process ();
+	return tid;
+}
+
+/* Creates a pipe and stores file descriptors for its read and
+   write ends in the user array rdi.  Returns 0, or -1 on
+   failure. */
+static uint64_t
+sys_pipe (struct intr_frame *f) {
+	struct file *read_end, *write_end;
+	int fds[2];
+
+	if (!pipe_create (&read_end, &write_end))
+		return -1;
+	fds[0] = process_add_file (read_end);
+	fds[1] = process_add_file (write_end);
+	if (fds[0] < 0 || fds[1] < 0) {
+		if (fds[0] < 0)
+			file_close (read_end);
+		else
+			process_close_file (fds[0]);
+		if (fds[1] < 0)
+			file_close (write_end);
+		else
+			process_close_file (fds[1]);
+		return -1;
+	}
+	if (!copy_to_user ((int *) f->R.rdi, fds, sizeof fds))
+		kill_process ();
+	return 0;
+}
+
+/* Creates a shared memory object of rdi bytes and returns a file
+   descriptor for it, or -1 on failure. */
+static uint64_t
+sys_shm_create (struct intr_frame *f) {
+	struct shm *shm = shm_create (f->R.rdi);
+	struct file *file;
+	int fd;
+
+	if (shm == NULL)
+		return -1;
+	file = shm_open_file (shm);
+	if (file == NULL)
+		return -1;
+	fd = process_add_file (file);
+	if (fd < 0)
+		file_close (file);
+	return fd;
+}
+
+/* Maps the shared memory object open as file descriptor rdi at
+   user address rsi.  Returns the address, or NULL on failure. */
+static uint64_t
+sys_shm_map (struct intr_frame *f) {
+	struct file *file = process_get_file ((int) f->R.rdi);
+	struct shm *shm = file != NULL ? shm_from_file (file) : NULL;
+	void *addr = NULL;
+
+	if (shm != NULL)
+		addr = shm_map (shm, (void *) f->R.rsi);
+	process_put_file (file);
+	return (uint64_t) addr;
+}
+
+/* Removes the shared memory mapping that starts at user address
+   rdi.  Returns false if there is none. */
+static uint64_t
+sys_shm_unmap (struct intr_frame *f) {
+	return shm_unmap ((void *) f->R.rdi);
+}
+
+/* Most descriptors one poll() or epoll_wait() takes. */
+#define POLL_MAX (PGSIZE / sizeof (struct epoll_event))
+
+/* Waits until one of the rsi descriptors in the user array of
+   struct pollfd at rdi is ready, or rdx ticks pass, and fills in
+   their revents.  Returns the number ready, or -1 on failure. */
+static uint64_t
+sys_poll (struct intr_frame *f) {
+	struct pollfd *ufds = (struct pollfd *) f->R.rdi;
+	size_t cnt = f->R.rsi;
+	struct pollfd *fds;
+	int ready;
+
+	if (cnt > POLL_MAX)
+		return -1;
+	fds = palloc_get_page (0);
+	if (fds == NULL)
+		return -1;
+	if (!copy_from_user (fds, ufds, cnt * sizeof *fds)) {
+		palloc_free_page (fds);
+		kill_process ();
+	}
+	ready = poll_fds (fds, cnt, (int64_t) f->R.rdx);
+	if (ready >= 0 && !copy_to_user (ufds, fds, cnt * sizeof *fds)) {
+		palloc_free_page (fds);
+		kill_process ();
+	}
+	palloc_free_page (fds);
+	return ready;
+}
+
+/* Changes the interest set as rdi, one of EPOLL_CTL_*, says for
+   descriptor rsi, with the struct epoll_event at user address rdx
+   for EPOLL_CTL_ADD and EPOLL_CTL_MOD.  Returns 0, or -1 on
+   failure. */
+static uint64_t
+sys_epoll_ctl (struct intr_frame *f) {
+	struct epoll_event ev = {0, 0};
+	int op = (int) f->R.rdi;
+
+	if (op != EPOLL_CTL_DEL
+			&& !copy_from_user (&ev, (void *) f->R.rdx, sizeof ev))
+		kill_process ();
+	return poll_ctl (op, (int) f->R.rsi, &ev) ? 0 : -1;
+}
+
+/* Waits until a descriptor in the interest set is ready, or rdx
+   ticks pass, and stores up to rsi events in the user array at
+   rdi.  Returns the number stored, or -1 on failure. */
+static uint64_t
+sys_epoll_wait (struct intr_frame *f) {
+	struct epoll_event *uevents = (struct epoll_event *) f->R.rdi;
+	int max = (int) f->R.rsi;
+	struct epoll_event *events;
+	int cnt;
+
+	if (max <= 0)
+		return -1;
+	if (max > (int) POLL_MAX)
+		max = POLL_MAX;
+	events = palloc_get_page (0);
+	if (events == NULL)
+		return -1;
+	cnt = poll_wait (events, max, (int64_t) f->R.rdx);
+	if (cnt > 0 && !copy_to_user (uevents, events, cnt * sizeof *events)) {
+		palloc_free_page (events);
+		kill_process ();
+	}
+	palloc_free_page (events);
+	return cnt;
+}
+
+/* Waits on the futex at user address rdi if it holds rsi, for up
+   to rdx ticks.  Returns 0 if woken, or -1 otherwise. */
+static uint64_t
+sys_futex_wait (struct intr_frame *f) {
+	return futex_wait ((uint32_t *) f->R.rdi, (uint32_t) f->R.rsi,
+			(int64_t) f->R.rdx);
+}
+
+/* Wakes up to rsi waiters on the futex at user address rdi.
+   Returns the number woken, or -1 on failure. */
+static uint64_t
+sys_futex_wake (struct intr_frame *f) {
+	return futex_wake ((uint32_t *) f->R.rdi, (int) f->R.rsi);
+}
+
+/* Starts a thread in the caller's process at user address rdi,
+   with stack pointer rsi and rdx and r10 in its rdi and rsi.
+   Returns its thread id, or TID_ERROR on failure. */
+static uint64_t
+sys_thread_spawn (struct intr_frame *f) {
+	if (!is_user_vaddr ((void *) f->R.rdi)
+			|| !is_user_vaddr ((void *) f->R.rsi))
+		return TID_ERROR;
+	return process_thread_spawn (f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10);
+}
+
+/* Waits for thread rdi of the caller's process to exit and returns
+   its exit status. */
+static uint64_t
+sys_thread_join (struct intr_frame *f) {
+	return process_join ((tid_t) f->R.rdi);
+}
+
+/* Sets the caller's thread-local storage pointer to rdi.  Returns
+   0, or -1 if rdi is not a user address. */
+static uint64_t
+sys_set_tls (struct intr_frame *f) {
+	return process_set_tls (f->R.rdi) ? 0 : -1;
+}
+
+/* Stores the resource usage of the caller, if rdi is RUSAGE_SELF,
+   or of its waited-for children, if rdi is RUSAGE_CHILDREN, in the
+   user buffer rsi.  Returns 0, or -1 if rdi is neither. */
+static uint64_t
+sys_getrusage (struct intr_frame *f) {
+	struct rusage *ru = (struct rusage *) f->R.rsi;
+	struct rusage kru;
+
+	if (!process_getrusage ((int) f->R.rdi, &kru))
+		return -1;
+	if (!copy_to_user (ru, &kru, sizeof kru))
+		kill_process ();
+	return 0;
+}
+
+/* Maps rsi bytes of zeroed memory into the caller, writable if rdx
+   is nonzero, at user address rdi or, if that is null, wherever
+   there is room.  Only anonymous mappings, with -1 for the file
+   descriptor r10 and 0 for the offset r8, are supported; files are
+   left to the virtual memory project.  Returns the address of the
+   mapping, or a null pointer on failure. */
+static uint64_t
+sys_mmap (struct intr_frame *f) {
+	if ((int) f->R.r10 != -1 || f->R.r8 != 0)
+		return 0;
+	return (uint64_t) mman_map ((void *) f->R.rdi, f->R.rsi, f->R.rdx != 0);
+}
+
+/* Removes the anonymous mapping that starts at user address rdi. */
+static uint64_t
+sys_munmap (struct intr_frame *f) {
+	mman_unmap ((void *) f->R.rdi);
+	return 0;
+}
+
+/* Moves the caller's break by rdi bytes, which may be negative.
+   Returns the old break, or (void *) -1 on failure. */
+static uint64_t
+sys_sbrk (struct intr_frame *f) {
+	return (uint64_t) mman_sbrk ((intptr_t) f->R.rdi);
+}
+
+/* Makes a template of the caller, from which sys_spawn_template()
+   starts processes at user address rdi, with rsi in their rdx.
+   Returns 0, or -1 on failure. */
+static uint64_t
+sys_template_mark (struct intr_frame *f) {
+	if (!is_user_vaddr ((void *) f->R.rdi))
+		return -1;
+	return process_template_mark (f->R.rdi, f->R.rsi) ? 0 : -1;
+}
+
+/* Starts a new child process from the template made by process
+   rdi, passing it the null-terminated argument vector rsi as
+   sys_spawn() does.  The vector must hold at least one argument.
+   Returns the child's pid, or -1 if it cannot be started. */
+static uint64_t
+sys_spawn_template (struct intr_frame *f) {
+	char *cmd_line;
+	int argv_ok;
+	tid_t tid = TID_ERROR;
+
+	cmd_line = palloc_get_page (0);
+	if (cmd_line == NULL)
+		return TID_ERROR;
+
+	/* A null vector yields an empty command line, which fails. */
+	argv_ok = copy_argv (cmd_line, "", (char *const *) f->R.rsi);
+	if (argv_ok > 0)
+		tid = process_spawn_template ((tid_t) f->R.rdi, cmd_line);
+
+	palloc_free_page (cmd_line);
+	if (argv_ok < 0)
+		kill_process ();
+	return tid;
+}
@@ -2,5 +2,14 @@ userprog_SRC  = userprog/process.c	# Process loading.
 userprog_SRC += userprog/exception.c	# User exception handler.
 userprog_SRC += userprog/syscall-entry.S # System call entry.
 userprog_SRC += userprog/syscall.c	# System call handler.
+userprog_SRC += userprog/usercopy.c	# Kernel access to user memory.
+userprog_SRC += userprog/vdso.c		# Shared kernel data page.
+userprog_SRC += userprog/uring.c	# Submission/completion rings.
+userprog_SRC += userprog/image.c	# Executable image cache.
+userprog_SRC += userprog/shm.c		# Shared memory.
+userprog_SRC += userprog/mman.c		# Heap and anonymous memory.
+userprog_SRC += userprog/poll.c		# Waiting for file descriptors.
+userprog_SRC += userprog/futex.c	# Fast user-space mutexes.
+userprog_SRC += userprog/fdtable.c	# File descriptor tables.
 userprog_SRC += userprog/gdt.c		# GDT initialization.
 userprog_SRC += userprog/tss.c		# TSS management.
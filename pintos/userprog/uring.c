@@ -0,0 +1,463 @@
+#include "userprog/uring.h"
+#include <debug.h>
+#include <list.h>
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
+#include "userprog/usercopy.h"
+
+/* Submission and completion rings.
+
+   A process that calls uring_setup() gets a page, mapped at
+   URING_ADDR, through which it hands the kernel batches of file
+   operations and collects their results, so that many operations
+   cost a single uring_enter() system call.
+
+   Operations that touch the process's file descriptor table (open
+   and close) and those with nothing to wait for run immediately,
+   inside uring_enter().  Reads, writes and syncs are handed to a
+   pool of kernel worker threads, so the process can go on running
+   while they wait for the disk.  A worker cannot use the process's
+   descriptors, which may be closed under it, so each operation
+   carries a private handle to the file, and it reaches the
+   process's buffers through the process's page tables.
+
+   The ring belongs to the process's main thread, so its threads
+   share it.  Nothing pins the pages a worker is copying to or
+   from, so whatever unmaps user memory first calls uring_pause(),
+   which waits for the workers to finish the process's operations
+   and holds back new ones until uring_resume(). */
+
+/* Number of worker threads. */
+#define WORKER_CNT 4
+
+/* Kernel side of a process's ring. */
+struct uring_ctx {
+	struct uring *ring;         /* Shared page, at its kernel address. */
+	uint64_t *pml4;             /* Owner's page tables. */
+	struct lock lock;           /* Protects PENDING and the CQ tail. */
+	struct condition done;      /* Signaled when a completion is posted. */
+	unsigned pending;           /* Submitted but not yet completed. */
+	unsigned working;           /* Of those, handed to the workers. */
+	unsigned pause_cnt;         /* uring_pause() calls not yet resumed. */
+	struct condition idle;      /* Broadcast when WORKING or PAUSE_CNT
+	                               drops to 0. */
+};
+
+/* An operation waiting for or running on a worker. */
+struct uring_work {
+	struct uring_ctx *ctx;      /* Ring to post the completion to. */
+	struct uring_sqe sqe;       /* Copy of the submission. */
+	struct file *file;          /* Private handle to the target file. */
+	struct list_elem elem;      /* Element in work_list. */
+};
+
+/* Operations waiting for a worker. */
+static struct list work_list;
+static struct lock work_lock;
+static struct condition work_ready;
+static bool workers_started;
+
+static void worker (void *aux);
+static bool reserve_cqe (struct uring_ctx *);
+static void post_cqe (struct uring_ctx *, uint64_t user_data, int32_t res);
+static void submit (struct uring_ctx *, const struct uring_sqe *);
+static int32_t do_open (const struct uring_sqe *);
+static int32_t do_close (const struct uring_sqe *);
+static bool queue_work (struct uring_ctx *, const struct uring_sqe *);
+static int32_t do_work (struct uring_work *);
+
+/* Initializes the ring subsystem.  Workers are started by the
+   first uring_setup(). */
+void
+uring_init (void) {
+	list_init (&work_list);
+	lock_init (&work_lock);
+	cond_init (&work_ready);
+}
+
+/* Creates a ring for the current process and maps it at
+   URING_ADDR.  Returns the ring's user address, or a null pointer
+   if the process already has a ring, something else is mapped at
+   URING_ADDR, the process is a vfork() child borrowing its
+   parent's address space, or memory is exhausted. */
+void *
+uring_setup (void) {
+	struct thread *t = process_leader (thread_current ());
+	struct uring_ctx *ctx = NULL;
+	void *page = NULL;
+	int i;
+
+	/* WORK_LOCK also keeps two threads from setting up at once. */
+	lock_acquire (&work_lock);
+	if (!workers_started) {
+		for (i = 0; i < WORKER_CNT; i++)
+			if (thread_create ("uring", PRI_DEFAULT, worker, NULL) == TID_ERROR)
+				break;
+		workers_started = i > 0;
+	}
+	if (!workers_started || t->uring != NULL || t->vfork_done != NULL
+			|| pml4_get_page (t->pml4, (void *) URING_ADDR) != NULL)
+		goto fail;
+
+	ctx = malloc (sizeof *ctx);
+	page = palloc_get_page (PAL_USER | PAL_ZERO);
+	if (ctx == NULL || page == NULL
+			|| !pml4_set_page (t->pml4, (void *) URING_ADDR, page, true))
+		goto fail;
+
+	process_add_rss (1);
+	ctx->ring = page;
+	ctx->pml4 = t->pml4;
+	lock_init (&ctx->lock);
+	cond_init (&ctx->done);
+	ctx->pending = 0;
+	ctx->working = 0;
+	ctx->pause_cnt = 0;
+	cond_init (&ctx->idle);
+	t->uring = ctx;
+	lock_release (&work_lock);
+	return (void *) URING_ADDR;
+
+fail:
+	lock_release (&work_lock);
+	palloc_free_page (page);
+	free (ctx);
+	return NULL;
+}
+
+/* Starts up to TO_SUBMIT operations from the current process's
+   submission queue, then waits until at least MIN_COMPLETE
+   completions are ready to be consumed or nothing more is in
+   flight.  Stops submitting early when the submission queue runs
+   dry or the completion queue has no room for another result.
+   Returns the number of operations submitted, or -1 if the
+   process has no ring. */
+int
+uring_enter (unsigned to_submit, unsigned min_complete) {
+	struct uring_ctx *ctx = process_leader (thread_current ())->uring;
+	struct uring *ring;
+	unsigned submitted;
+
+	if (ctx == NULL)
+		return -1;
+	ring = ctx->ring;
+
+	for (submitted = 0; submitted < to_submit; submitted++) {
+		uint32_t head = ring->sq_head;
+		struct uring_sqe sqe;
+
+		barrier ();
+		if (head == ring->sq_tail || !reserve_cqe (ctx))
+			break;
+
+		/* Take a copy, since the process may change the entry
+		   while we look at it. */
+		barrier ();
+		sqe = ring->sqes[head % URING_SQ_ENTRIES];
+		barrier ();
+		ring->sq_head = head + 1;
+		submit (ctx, &sqe);
+	}
+
+	lock_acquire (&ctx->lock);
+	while (ctx->pending > 0 && ring->cq_tail - ring->cq_head < min_complete)
+		cond_wait (&ctx->done, &ctx->lock);
+	lock_release (&ctx->lock);
+	return submitted;
+}
+
+/* Waits until no worker is using the current process's memory for
+   one of its ring's operations, and keeps them from starting new
+   ones until uring_resume(), so that pages can be unmapped and
+   freed safely meanwhile.  Does nothing if the process has no
+   ring. */
+void
+uring_pause (void) {
+	struct uring_ctx *ctx = process_leader (thread_current ())->uring;
+
+	if (ctx == NULL)
+		return;
+	lock_acquire (&ctx->lock);
+	ctx->pause_cnt++;
+	while (ctx->working > 0)
+		cond_wait (&ctx->idle, &ctx->lock);
+	lock_release (&ctx->lock);
+}
+
+/* Lets the current process's ring operations that uring_pause()
+   held back go ahead. */
+void
+uring_resume (void) {
+	struct uring_ctx *ctx = process_leader (thread_current ())->uring;
+
+	if (ctx == NULL)
+		return;
+	lock_acquire (&ctx->lock);
+	ASSERT (ctx->pause_cnt > 0);
+	if (--ctx->pause_cnt == 0)
+		cond_broadcast (&ctx->idle, &ctx->lock);
+	lock_release (&ctx->lock);
+}
+
+/* Tears down the current process's ring, if it has one, after
+   waiting for its operations to finish.  The ring page itself is
+   freed along with the process's page tables.  Only the main
+   thread has a ring. */
+void
+uring_destroy (void) {
+	struct thread *t = thread_current ();
+	struct uring_ctx *ctx = t->uring;
+
+	if (ctx == NULL)
+		return;
+
+	lock_acquire (&ctx->lock);
+	while (ctx->pending > 0)
+		cond_wait (&ctx->done, &ctx->lock);
+	lock_release (&ctx->lock);
+
+	t->uring = NULL;
+	free (ctx);
+}
+
+/* Reserves a completion queue slot for one more operation in CTX.
+   Returns false if every slot is taken by unconsumed completions
+   or operations in flight. */
+static bool
+reserve_cqe (struct uring_ctx *ctx) {
+	struct uring *ring = ctx->ring;
+	bool ok;
+
+	lock_acquire (&ctx->lock);
+	ok = ring->cq_tail - ring->cq_head + ctx->pending < URING_CQ_ENTRIES;
+	if (ok)
+		ctx->pending++;
+	lock_release (&ctx->lock);
+	return ok;
+}
+
+/* Posts the result RES of an operation to CTX's completion queue,
+   into the slot reserved for it by reserve_cqe(). */
+static void
+post_cqe (struct uring_ctx *ctx, uint64_t user_data, int32_t res) {
+	struct uring *ring = ctx->ring;
+	struct uring_cqe *cqe;
+
+	lock_acquire (&ctx->lock);
+	ASSERT (ctx->pending > 0);
+	cqe = &ring->cqes[ring->cq_tail % URING_CQ_ENTRIES];
+	cqe->user_data = user_data;
+	cqe->res = res;
+	barrier ();
+	ring->cq_tail++;
+	ctx->pending--;
+	cond_signal (&ctx->done, &ctx->lock);
+	lock_release (&ctx->lock);
+}
+
+/* Starts operation SQE, for which a completion slot has been
+   reserved in CTX. */
+static void
+submit (struct uring_ctx *ctx, const struct uring_sqe *sqe) {
+	int32_t res;
+
+	switch (sqe->opcode) {
+		case URING_OP_NOP:
+			res = 0;
+			break;
+		case URING_OP_OPEN:
+			res = do_open (sqe);
+			break;
+		case URING_OP_CLOSE:
+			res = do_close (sqe);
+			break;
+		case URING_OP_READ:
+		case URING_OP_WRITE:
+		case URING_OP_FSYNC:
+			if (queue_work (ctx, sqe))
+				return;
+			res = -1;
+			break;
+		default:
+			res = -1;
+			break;
+	}
+	post_cqe (ctx, sqe->user_data, res);
+}
+
+/* Opens the file named by SQE and returns a new file descriptor
+   for it, or -1. */
+static int32_t
+do_open (const struct uring_sqe *sqe) {
+	char name[NAME_BUF_SIZE];
+	int64_t len;
+	struct file *file;
+	int fd;
+
+	len = strncpy_from_user (name, (const char *) sqe->addr, sizeof name);
+	if (len < 0 || (size_t) len >= sizeof name)
+		return -1;
+
+	lock_acquire (&filesys_lock);
+	file = filesys_open (name);
+	lock_release (&filesys_lock);
+	if (file == NULL)
+		return -1;
+
+	fd = process_add_file (file);
+	if (fd < 0) {
+		lock_acquire (&filesys_lock);
+		file_close (file);
+		lock_release (&filesys_lock);
+	}
+	return fd;
+}
+
+/* Closes SQE's file descriptor.  Returns 0, or -1 if it was not
+   open. */
+static int32_t
+do_close (const struct uring_sqe *sqe) {
+	struct file *file = process_get_file (sqe->fd);
+
+	if (file == NULL)
+		return -1;
+	process_put_file (file);
+	process_close_file (sqe->fd);
+	return 0;
+}
+
+/* Hands SQE to the workers.  Returns false if its file descriptor
+   is not open or memory is exhausted. */
+static bool
+queue_work (struct uring_ctx *ctx, const struct uring_sqe *sqe) {
+	struct file *file = process_get_file (sqe->fd);
+	struct uring_work *w;
+
+	if (file == NULL)
+		return false;
+	w = malloc (sizeof *w);
+	if (w == NULL) {
+		process_put_file (file);
+		return false;
+	}
+
+	lock_acquire (&filesys_lock);
+	w->file = file_reopen (file);
+	lock_release (&filesys_lock);
+	process_put_file (file);
+	if (w->file == NULL) {
+		free (w);
+		return false;
+	}
+	w->ctx = ctx;
+	w->sqe = *sqe;
+
+	lock_acquire (&ctx->lock);
+	while (ctx->pause_cnt > 0)
+		cond_wait (&ctx->idle, &ctx->lock);
+	ctx->working++;
+	lock_release (&ctx->lock);
+
+	lock_acquire (&work_lock);
+	list_push_back (&work_list, &w->elem);
+	cond_signal (&work_ready, &work_lock);
+	lock_release (&work_lock);
+	return true;
+}
+
+/* A worker thread: runs queued operations forever. */
+static void
+worker (void *aux UNUSED) {
+	for (;;) {
+		struct uring_work *w;
+		int32_t res;
+
+		lock_acquire (&work_lock);
+		while (list_empty (&work_list))
+			cond_wait (&work_ready, &work_lock);
+		w = list_entry (list_pop_front (&work_list), struct uring_work, elem);
+		lock_release (&work_lock);
+
+		res = do_work (w);
+
+		lock_acquire (&w->ctx->lock);
+		if (--w->ctx->working == 0)
+			cond_broadcast (&w->ctx->idle, &w->ctx->lock);
+		lock_release (&w->ctx->lock);
+
+		lock_acquire (&filesys_lock);
+		file_close (w->file);
+		lock_release (&filesys_lock);
+		post_cqe (w->ctx, w->sqe.user_data, res);
+		free (w);
+	}
+}
+
+/* Returns the kernel address of byte UADDR of the user address
+   space PML4, or a null pointer if it is not mapped for user
+   access, or not writable when WRITE is true. */
+static uint8_t *
+user_to_kernel (uint64_t *pml4, const uint8_t *uaddr, bool write) {
+	uint64_t *pte;
+
+	if (!is_user_vaddr (uaddr))
+		return NULL;
+	pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
+	if (pte == NULL || !(*pte & PTE_P) || !(*pte & PTE_U)
+			|| (write && !(*pte & PTE_W)))
+		return NULL;
+	return (uint8_t *) ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+}
+
+/* Carries out read, write or sync operation W on behalf of its
+   process.  Returns the number of bytes transferred, 0 for a
+   sync, or -1 if nothing could be transferred. */
+static int32_t
+do_work (struct uring_work *w) {
+	const struct uring_sqe *sqe = &w->sqe;
+	bool is_read = sqe->opcode == URING_OP_READ;
+	const uint8_t *uaddr = (const uint8_t *) sqe->addr;
+	uint32_t done = 0;
+
+	if (sqe->opcode == URING_OP_FSYNC) {
+		lock_acquire (&filesys_lock);
+		file_sync (w->file);
+		lock_release (&filesys_lock);
+		return 0;
+	}
+
+	/* Transfer a page at a time, since consecutive user pages need
+	   not be consecutive in kernel memory. */
+	while (done < sqe->len) {
+		uint32_t left = sqe->len - done;
+		uint32_t chunk = PGSIZE - pg_ofs (uaddr + done);
+		uint8_t *kaddr;
+		off_t n;
+
+		if (chunk > left)
+			chunk = left;
+		kaddr = user_to_kernel (w->ctx->pml4, uaddr + done, is_read);
+		if (kaddr == NULL)
+			return done > 0 ? (int32_t) done : -1;
+
+		lock_acquire (&filesys_lock);
+		if (is_read)
+			n = file_read_at (w->file, kaddr, chunk, sqe->off + done);
+		else
+			n = file_write_at (w->file, kaddr, chunk, sqe->off + done);
+		lock_release (&filesys_lock);
+
+		done += n;
+		if ((uint32_t) n < chunk)
+			break;
+	}
+	return done;
+}
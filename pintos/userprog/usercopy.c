@@ -0,0 +1,89 @@
+#include "userprog/usercopy.h"
+#include <string.h>
+#include "threads/vaddr.h"
+
+/* Access to user memory from the kernel.
+
+   These functions touch user memory directly, without first
+   checking that it is mapped.  Each instruction that may fault
+   has an entry in the exception table, which page_fault()
+   consults for faults in kernel mode: execution resumes at the
+   entry's fixup address, which turns the fault into an error
+   return.  Only the range check against KERN_BASE is done up
+   front, since the kernel's own pages would not fault. */
+
+/* Adds an exception table entry saying that a fault at local
+   label INSN resumes at local label FIXUP. */
+#define EX_TABLE(INSN, FIXUP)                           \
+	".pushsection ex_table, \"a\"\n"                    \
+	".quad " #INSN ", " #FIXUP "\n"                     \
+	".popsection\n"
+
+/* Returns true if the SIZE bytes at UADDR are all below
+   KERN_BASE. */
+static inline bool
+is_user_range (const void *uaddr, size_t size) {
+	uint64_t start = (uint64_t) uaddr;
+	uint64_t end = start + size;
+
+	return end >= start && end <= KERN_BASE;
+}
+
+/* Copies SIZE bytes from SRC to DST with "rep movsb".  Returns
+   the number of bytes not copied, which is nonzero only if a page
+   fault cut the copy short: the CPU leaves RCX counting the bytes
+   that remain. */
+static inline size_t
+copy_user (void *dst, const void *src, size_t size) {
+	asm volatile ("1: rep movsb\n"
+			"2:\n"
+			EX_TABLE (1b, 2b)
+			: "+D" (dst), "+S" (src), "+c" (size)
+			:
+			: "memory");
+	return size;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns true
+   if successful, false if USRC is not all mapped user memory. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	return is_user_range (usrc, size) && copy_user (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns true
+   if successful, false if UDST is not all writable user memory. */
+bool
+copy_to_user (void *udst, const void *src, size_t size) {
+	return is_user_range (udst, size) && copy_user (udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   the SIZE-byte buffer DST.  Returns the string's length, not
+   counting the null terminator, or -1 if USRC is not mapped user
+   memory.  If the string does not fit, returns SIZE and leaves
+   DST unterminated.
+
+   The string's length is not known in advance, so it is copied a
+   page at a time: a page is either mapped or not as a whole, so
+   reading all of it is safe wherever in it the string ends. */
+int64_t
+strncpy_from_user (char *dst, const char *usrc, size_t size) {
+	size_t done = 0;
+
+	while (done < size) {
+		const char *src = usrc + done;
+		size_t chunk = PGSIZE - pg_ofs (src);
+		const char *end;
+
+		if (chunk > size - done)
+			chunk = size - done;
+		if (!is_user_range (src, chunk) || copy_user (dst + done, src, chunk) != 0)
+			return -1;
+		end = memchr (dst + done, '\0', chunk);
+		if (end != NULL)
+			return end - dst;
+		done += chunk;
+	}
+	return size;
+}
@@ -0,0 +1,66 @@
+#include "userprog/vdso.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "intrinsic.h"
+
+/* The shared data page.
+
+   One page of kernel memory is mapped read-only at VDSO_ADDR in
+   every user process, so that programs can find out the time or
+   their own id by reading memory instead of making a system call.
+   See include/lib/vdso.h for its layout and lib/user/vdso.c for
+   the readers. */
+static struct vdso_data *vdso;
+
+/* Time stamp counter at vdso_init(), for averaging the TSC rate
+   over the whole time since boot. */
+static uint64_t boot_tsc;
+
+/* Allocates the shared data page.  Must be called before timer
+   interrupts are enabled. */
+void
+vdso_init (void) {
+	vdso = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	vdso->timer_freq = TIMER_FREQ;
+	boot_tsc = vdso->tick_tsc = rdtsc ();
+}
+
+/* Publishes the new tick count TICKS.  Called by the timer
+   interrupt handler. */
+void
+vdso_tick (int64_t ticks) {
+	uint64_t tsc = rdtsc ();
+
+	vdso->seq++;
+	barrier ();
+	vdso->ticks = ticks;
+	vdso->tick_tsc = tsc;
+	vdso->tsc_per_tick = (tsc - boot_tsc) / ticks;
+	barrier ();
+	vdso->seq++;
+}
+
+/* Publishes that thread T is about to run, as the id of its
+   process.  Called on every context switch. */
+void
+vdso_switch (const struct thread *t) {
+	vdso->tid = t->leader != NULL ? t->leader->tid : t->tid;
+}
+
+/* Maps the shared data page read-only at VDSO_ADDR in PML4.
+   Returns false if memory for page tables is exhausted. */
+bool
+vdso_map (uint64_t *pml4) {
+	return pml4_set_page (pml4, (void *) VDSO_ADDR, vdso, false);
+}
+
+/* Removes the shared data page from PML4, which must be done
+   before destroying PML4, since pml4_destroy() frees every page
+   that is still mapped. */
+void
+vdso_unmap (uint64_t *pml4) {
+	pml4_clear_page (pml4, (void *) VDSO_ADDR);
+}